@@ -0,0 +1,262 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "mconcepts.h"
+#include "rational.h"
+#include "assertm.h"
+
+// Memory of Matrix, MathVector and Polynomial.
+// The containers take an allocator parameter, ResourceAllocator by default: it allocates from
+// the memory resource current on the thread that creates the container, which is the global heap
+// unless a scope installs another one.
+// - BumpArena hands out memory by moving a pointer through chunks taken from the heap,
+//   deallocation does nothing and everything is given back at once by rewind() or release().
+//   Chunks are kept, so the next computation in the same arena allocates nothing.
+// - PoolResource keeps free lists of blocks of 16 << k bytes up to POOL_MAX_BLOCK, larger blocks
+//   go to the heap. It is not synchronized, containers from it must be freed on its thread.
+// - ScopedArena makes the arena of the calling thread current and rewinds it on exit, so
+//   all temporaries of a whole det() or Ker() are freed together.
+//   ScopedMemoryResource makes any resource current, e.g. thread_memory_pool().
+// Worker threads of parallel_for keep their own current resource, the heap by default.
+// Containers created inside a scope must not outlive it. Results are taken out by assigning
+// them to a container created outside: assignment between different resources copies the
+// elements, while move construction would keep the arena memory.
+
+constexpr size_t ARENA_CHUNK = size_t(1) << 16;
+constexpr size_t POOL_MAX_BLOCK = 4096;
+constexpr size_t POOL_CHUNK = size_t(1) << 16;
+
+class BumpArena : public std::pmr::memory_resource {
+public:
+	// position of the arena, everything allocated after it is freed by rewind
+	struct Mark {
+		size_t chunk = 0, offset = 0;
+	};
+
+	explicit BumpArena(size_t chunk_size = ARENA_CHUNK) : chunk_size(std::max<size_t>(chunk_size, 64)) {}
+	BumpArena(const BumpArena&) = delete;
+	BumpArena& operator=(const BumpArena&) = delete;
+	~BumpArena() override {
+		for (auto& c : chunks)
+			::operator delete(c.p, std::align_val_t(alignof(std::max_align_t)));
+	}
+
+	Mark mark() const { return { current, offset }; }
+	void rewind(Mark m) {
+		assertm(m.chunk < current || (m.chunk == current && m.offset <= offset), "BumpArena rewound forward");
+		current = m.chunk;
+		offset = m.offset;
+	}
+	// frees all allocations, the chunks stay for reuse
+	void release() { rewind({}); }
+	// returns the chunks above the current one to the heap
+	void shrink() {
+		while (chunks.size() > current + 1) {
+			::operator delete(chunks.back().p, std::align_val_t(alignof(std::max_align_t)));
+			chunks.pop_back();
+		}
+	}
+
+	size_t used() const {
+		size_t res = offset;
+		for (size_t i = 0; i < current && i < chunks.size(); i++)
+			res += chunks[i].size;
+		return res;
+	}
+	size_t capacity() const {
+		size_t res = 0;
+		for (auto& c : chunks)
+			res += c.size;
+		return res;
+	}
+private:
+	struct Chunk {
+		std::byte* p;
+		size_t size;
+	};
+
+	void* do_allocate(size_t bytes, size_t align) override {
+		while (true) {
+			if (current < chunks.size()) {
+				auto& c = chunks[current];
+				size_t start = (reinterpret_cast<uintptr_t>(c.p) + offset + align - 1) / align * align - reinterpret_cast<uintptr_t>(c.p);
+				if (start + bytes <= c.size) {
+					offset = start + bytes;
+					return c.p + start;
+				}
+				if (current + 1 < chunks.size()) {
+					current++;
+					offset = 0;
+					continue;
+				}
+			}
+			// every new chunk is twice the previous one, so there are O(log) chunks
+			size_t size = std::max(chunks.empty() ? chunk_size : 2 * chunks.back().size, bytes + align);
+			chunks.push_back({ static_cast<std::byte*>(::operator new(size, std::align_val_t(alignof(std::max_align_t)))), size });
+			current = chunks.size() - 1;
+			offset = 0;
+		}
+	}
+	void do_deallocate(void*, size_t, size_t) override {}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+	size_t chunk_size;
+	std::vector<Chunk> chunks;
+	size_t current = 0, offset = 0;
+};
+
+class PoolResource : public std::pmr::memory_resource {
+public:
+	PoolResource() = default;
+	PoolResource(const PoolResource&) = delete;
+	PoolResource& operator=(const PoolResource&) = delete;
+	~PoolResource() override { release(); }
+
+	// frees all blocks, including those still in use
+	void release() {
+		for (void* c : chunks)
+			::operator delete(c, std::align_val_t(alignof(std::max_align_t)));
+		chunks.clear();
+		free.fill(nullptr);
+	}
+private:
+	static constexpr size_t MIN_BLOCK = 16;
+	static constexpr size_t CLASSES = std::countr_zero(POOL_MAX_BLOCK / MIN_BLOCK) + 1;
+
+	struct FreeBlock {
+		FreeBlock* next;
+	};
+
+	static size_t size_class(size_t bytes) {
+		return std::countr_zero(std::bit_ceil(std::max(bytes, MIN_BLOCK)) / MIN_BLOCK);
+	}
+
+	void* do_allocate(size_t bytes, size_t align) override {
+		if (bytes > POOL_MAX_BLOCK || align > alignof(std::max_align_t))
+			return ::operator new(bytes, std::align_val_t(align));
+		size_t k = size_class(bytes);
+		if (!free[k]) {
+			// a fresh chunk is cut into blocks of the class
+			size_t block = MIN_BLOCK << k;
+			auto* p = static_cast<std::byte*>(::operator new(POOL_CHUNK, std::align_val_t(alignof(std::max_align_t))));
+			chunks.push_back(p);
+			for (size_t i = POOL_CHUNK / block; i-- > 0;)
+				free[k] = new (p + i * block) FreeBlock{ free[k] };
+		}
+		FreeBlock* b = free[k];
+		free[k] = b->next;
+		return b;
+	}
+	void do_deallocate(void* p, size_t bytes, size_t align) override {
+		if (bytes > POOL_MAX_BLOCK || align > alignof(std::max_align_t))
+			return ::operator delete(p, bytes, std::align_val_t(align));
+		size_t k = size_class(bytes);
+		free[k] = new (p) FreeBlock{ free[k] };
+	}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+	std::array<FreeBlock*, CLASSES> free{};
+	std::vector<void*> chunks;
+};
+
+namespace detail {
+
+inline std::pmr::memory_resource*& current_resource() {
+	thread_local std::pmr::memory_resource* r = std::pmr::new_delete_resource();
+	return r;
+}
+
+} // namespace detail
+
+inline std::pmr::memory_resource* current_memory_resource() { return detail::current_resource(); }
+
+// per-thread resources, created on first use
+inline BumpArena& thread_arena() {
+	thread_local BumpArena arena;
+	return arena;
+}
+
+inline PoolResource& thread_memory_pool() {
+	thread_local PoolResource pool;
+	return pool;
+}
+
+// r is current on this thread until the end of the scope
+class ScopedMemoryResource {
+public:
+	explicit ScopedMemoryResource(std::pmr::memory_resource& r) : prev(detail::current_resource()) { detail::current_resource() = &r; }
+	ScopedMemoryResource(const ScopedMemoryResource&) = delete;
+	ScopedMemoryResource& operator=(const ScopedMemoryResource&) = delete;
+	~ScopedMemoryResource() { detail::current_resource() = prev; }
+private:
+	std::pmr::memory_resource* prev;
+};
+
+// allocations on this thread go to the arena until the end of the scope, then they are all freed;
+// scopes on the same arena nest
+class ScopedArena {
+public:
+	explicit ScopedArena(BumpArena& arena = thread_arena()) : arena(arena), start(arena.mark()), scope(arena) {}
+	ScopedArena(const ScopedArena&) = delete;
+	ScopedArena& operator=(const ScopedArena&) = delete;
+	~ScopedArena() { arena.rewind(start); }
+private:
+	BumpArena& arena;
+	BumpArena::Mark start;
+	ScopedMemoryResource scope;
+};
+
+// allocates from the resource current when it is constructed
+template<class T>
+class ResourceAllocator {
+public:
+	using value_type = T;
+	// containers keep their memory on assignment, elements are copied between resources
+	using propagate_on_container_copy_assignment = std::false_type;
+	using propagate_on_container_move_assignment = std::false_type;
+	using propagate_on_container_swap = std::true_type;
+	using is_always_equal = std::false_type;
+
+	ResourceAllocator() noexcept : r(current_memory_resource()) {}
+	explicit ResourceAllocator(std::pmr::memory_resource* r) noexcept : r(r) {}
+	template<class U>
+	ResourceAllocator(const ResourceAllocator<U>& other) noexcept : r(other.resource()) {}
+
+	T* allocate(size_t n) {
+		if (n > std::numeric_limits<size_t>::max() / sizeof(T))
+			throw std::bad_array_new_length();
+		return static_cast<T*>(r->allocate(n * sizeof(T), alignof(T)));
+	}
+	void deallocate(T* p, size_t n) noexcept { r->deallocate(p, n * sizeof(T), alignof(T)); }
+
+	// a copy belongs to the scope it is made in
+	ResourceAllocator select_on_container_copy_construction() const { return {}; }
+
+	std::pmr::memory_resource* resource() const noexcept { return r; }
+
+	template<class U>
+	friend bool operator==(const ResourceAllocator& a, const ResourceAllocator<U>& b) noexcept { return *a.r == *b.resource(); }
+private:
+	std::pmr::memory_resource* r;
+};
+
+// the containers are declared here once, so every header sees the same default allocator
+template<class T, class Alloc = ResourceAllocator<T>>
+requires conc_scalar<T>
+class MathVector;
+
+template<class T = Rational<int>, class Alloc = ResourceAllocator<T>>
+class Matrix;
+
+template<class T, class Alloc = ResourceAllocator<T>>
+class Polynomial;
@@ -0,0 +1,377 @@
+#pragma once
+
+#include <algorithm>
+#include <compare>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "matrix.h"
+#include "bigint.h"
+#include "math_vector.h"
+#include "rational.h"
+#include "thread_pool.h"
+#include "instrumentation.h"
+#include "assertm.h"
+
+// Fraction-free (Bareiss) elimination for integer-like matrices.
+// Every entry after step k is a (k+1) x (k+1) minor of the input, so sizes stay bounded by
+// Hadamard's bound, and each update is a*d - b*c followed by one exact division, without gcd.
+// Rational matrices are eliminated over integers after every row is multiplied by the
+// lcm of its denominators, which changes neither rank, kernel nor column space.
+// The elimination runs in long long first, with overflow checks instead of wraparound;
+// if a value leaves its range, the whole computation is repeated in BigInt (bareiss_run).
+
+namespace detail {
+
+// W is the integer type the elimination runs in first, int-sized types are widened so that
+// most inputs never reach the BigInt fallback
+template<class T>
+struct bareiss_traits {
+	static constexpr bool enabled = false;
+};
+
+template<class T>
+requires std::is_integral_v<T>
+struct bareiss_traits<T> {
+	static constexpr bool enabled = true, rational = false;
+	using W = std::conditional_t<(sizeof(T) < sizeof(long long)), long long, T>;
+};
+
+template<>
+struct bareiss_traits<BigInt> {
+	static constexpr bool enabled = true, rational = false;
+	using W = BigInt;
+};
+
+template<class U>
+struct bareiss_traits<Rational<U>> {
+	static constexpr bool enabled = bareiss_traits<U>::enabled, rational = true;
+	using W = typename bareiss_traits<U>::W;
+};
+
+// thrown when a checked operation of a built-in integer type overflows
+struct bareiss_overflow {};
+
+template<class W>
+constexpr bool bareiss_checked = std::is_integral_v<W> && std::is_signed_v<W>;
+
+// x * y, x + y and x - y, throwing bareiss_overflow instead of wrapping around
+template<class W>
+W checked_mul(const W& x, const W& y) {
+	if constexpr (bareiss_checked<W>) {
+		W res;
+#if defined(__GNUC__) || defined(__clang__)
+		if (__builtin_mul_overflow(x, y, &res))
+			throw bareiss_overflow{};
+#else
+		constexpr W lo = std::numeric_limits<W>::min(), hi = std::numeric_limits<W>::max();
+		if (x != 0 && y != 0 && (x > 0 ? (y > 0 ? x > hi / y : y < lo / x) : (y > 0 ? x < lo / y : y < hi / x)))
+			throw bareiss_overflow{};
+		res = x * y;
+#endif
+		return res;
+	} else {
+		return x * y;
+	}
+}
+
+template<class W>
+W checked_add(const W& x, const W& y) {
+	if constexpr (bareiss_checked<W>) {
+		W res;
+#if defined(__GNUC__) || defined(__clang__)
+		if (__builtin_add_overflow(x, y, &res))
+			throw bareiss_overflow{};
+#else
+		if (y > 0 ? x > std::numeric_limits<W>::max() - y : x < std::numeric_limits<W>::min() - y)
+			throw bareiss_overflow{};
+		res = x + y;
+#endif
+		return res;
+	} else {
+		return x + y;
+	}
+}
+
+template<class W>
+W checked_sub(const W& x, const W& y) {
+	if constexpr (bareiss_checked<W>) {
+		W res;
+#if defined(__GNUC__) || defined(__clang__)
+		if (__builtin_sub_overflow(x, y, &res))
+			throw bareiss_overflow{};
+#else
+		if (y < 0 ? x > std::numeric_limits<W>::max() + y : x < std::numeric_limits<W>::min() + y)
+			throw bareiss_overflow{};
+		res = x - y;
+#endif
+		return res;
+	} else {
+		return x - y;
+	}
+}
+
+template<class W>
+W checked_neg(const W& x) { return checked_sub(W(0), x); }
+
+// lcm of l and d > 0
+template<class W>
+W checked_lcm(const W& l, const W& d) { return checked_mul(W(l / my_gcd(l, d)), d); }
+
+// (p * x - q * y) / d for an exact division: the products are formed in 128 bits where the
+// compiler has them, so only a quotient out of the range of W overflows
+template<class W>
+W bareiss_update(const W& p, const W& x, const W& q, const W& y, const W& d) {
+#ifdef __SIZEOF_INT128__
+	if constexpr (bareiss_checked<W> && sizeof(W) <= sizeof(long long)) {
+		__int128 v = ((__int128)p * x - (__int128)q * y) / d;
+		if (v < std::numeric_limits<W>::min() || v > std::numeric_limits<W>::max())
+			throw bareiss_overflow{};
+		return W(v);
+	}
+#endif
+	return checked_sub(checked_mul(p, x), checked_mul(q, y)) / d;
+}
+
+// Built-in integer whose arithmetic throws bareiss_overflow, so algorithms written for any
+// ring, such as Berkowitz, can run in W and fall back like the elimination.
+template<class W>
+struct Checked {
+	W v = W(0);
+
+	Checked() = default;
+	Checked(W v) : v(v) {}
+
+	Checked operator-() const { return checked_neg(v); }
+	Checked& operator+=(const Checked& x) { v = checked_add(v, x.v); return *this; }
+	Checked& operator-=(const Checked& x) { v = checked_sub(v, x.v); return *this; }
+	Checked& operator*=(const Checked& x) { v = checked_mul(v, x.v); return *this; }
+	// only min / -1 overflows
+	Checked& operator/=(const Checked& x) {
+		if (x.v == W(-1))
+			return *this = -*this;
+		v /= x.v;
+		return *this;
+	}
+	friend Checked operator+(Checked x, const Checked& y) { return x += y; }
+	friend Checked operator-(Checked x, const Checked& y) { return x -= y; }
+	friend Checked operator*(Checked x, const Checked& y) { return x *= y; }
+	friend Checked operator/(Checked x, const Checked& y) { return x /= y; }
+	friend auto operator<=>(const Checked& x, const Checked& y) = default;
+	friend std::istream& operator>>(std::istream& in, Checked& x) { return in >> x.v; }
+	friend std::ostream& operator<<(std::ostream& out, const Checked& x) { return out << x.v; }
+};
+
+// W itself when it cannot overflow, Checked<W> otherwise
+template<class W>
+using bareiss_ring = std::conditional_t<bareiss_checked<W>, Checked<W>, W>;
+
+// f.template operator()<W>() with the fast integer type of T, repeated with BigInt when
+// it overflows
+template<class T, class F>
+decltype(auto) bareiss_run(F&& f) {
+	using W = typename bareiss_traits<T>::W;
+	if constexpr (!bareiss_checked<W>) {
+		return f.template operator()<W>();
+	} else {
+		try {
+			return f.template operator()<W>();
+		} catch (const bareiss_overflow&) {
+			LA_PHASE("Bareiss::BigInt fallback");
+			return f.template operator()<BigInt>();
+		}
+	}
+}
+
+} // namespace detail
+
+template<class T>
+concept conc_bareiss = detail::bareiss_traits<T>::enabled;
+
+// Elimination of an integer matrix. Forward mode gives a row echelon form, reduced mode
+// also eliminates above the pivots: then every pivot equals pivot() and row i holds
+// pivot() at pivot_columns()[i].
+template<class W>
+class Bareiss {
+public:
+	Bareiss(Matrix<W> a, bool reduced = false);
+
+	size_t rank() const { return cols.size(); }
+	const std::vector<size_t>& pivot_columns() const { return cols; }
+	const Matrix<W>& echelon() const { return a; }
+	// last pivot, the leading principal minor of the permuted matrix of order rank()
+	const W& pivot() const { return prev; }
+	W det() const;
+private:
+	Matrix<W> a;
+	std::vector<size_t> cols;
+	W prev = W(1);
+	bool odd_swaps = false;
+};
+
+template<class W>
+Bareiss<W>::Bareiss(Matrix<W> mat, bool reduced) : a(std::move(mat)) {
+	LA_PHASE("Bareiss");
+	auto [n, m] = a.size();
+	for (size_t c = 0; c < m && rank() < n; c++) {
+		size_t r = rank();
+		size_t p = r;
+		while (p < n && a[p][c] == W(0))
+			++p;
+		if (p == n)
+			continue;
+		if (p != r) {
+			a[p].swap(a[r]);
+			odd_swaps = !odd_swaps;
+		}
+		cols.push_back(c);
+
+		const W piv = a[r][c];
+		// rows are independent; a row with a zero in column c is still rescaled by piv / prev
+		auto update = [&](size_t i, size_t from) {
+			W x = a[i][c];
+			for (size_t j = from; j < m; j++)
+				a[i][j] = detail::bareiss_update(piv, a[i][j], x, a[r][j], prev);
+			a[i][c] = W(0);
+		};
+		parallel_for(r + 1, n, m - c, [&](size_t lo, size_t hi) {
+			for (size_t i = lo; i < hi; i++)
+				update(i, c + 1);
+		});
+		if (reduced)
+			parallel_for(0, r, m, [&](size_t lo, size_t hi) {
+				for (size_t i = lo; i < hi; i++)
+					update(i, cols[i]);
+			});
+		prev = piv;
+	}
+}
+
+template<class W>
+W Bareiss<W>::det() const {
+	auto [n, m] = a.size();
+	assertm(n == m, "Wrong matrix sizes in det");
+	if (rank() < n)
+		return W(0);
+	return odd_swaps ? detail::checked_neg(prev) : prev;
+}
+
+namespace detail {
+
+template<class W>
+W bareiss_abs(const W& x) { return x < W(0) ? checked_neg(x) : x; }
+
+// integer matrix in W with the same rank, kernel and column space as a,
+// scale[i] is the factor row i was multiplied by
+template<class W, class T>
+Matrix<W> bareiss_input(const Matrix<T>& a, std::vector<W>* scale = nullptr) {
+	auto [n, m] = a.size();
+	Matrix<W> res(n, m);
+	if (scale)
+		scale->assign(n, W(1));
+	for (size_t i = 0; i < n; i++) {
+		if constexpr (!bareiss_traits<T>::rational) {
+			for (size_t j = 0; j < m; j++)
+				res[i][j] = W(a[i][j]);
+		} else {
+			W l = W(1);
+			for (size_t j = 0; j < m; j++)
+				l = checked_lcm(l, W(a[i][j].m));
+			for (size_t j = 0; j < m; j++)
+				res[i][j] = checked_mul(W(a[i][j].n), W(l / W(a[i][j].m)));
+			if (scale)
+				(*scale)[i] = l;
+		}
+	}
+	return res;
+}
+
+// num / den as T, den != 0
+template<class T, class W>
+T bareiss_output(W num, W den) {
+	if constexpr (!bareiss_traits<T>::rational) {
+		return T(num / den);
+	} else {
+		if (den < W(0))
+			num = checked_neg(num), den = checked_neg(den);
+		W g = my_gcd(bareiss_abs(num), den);
+		T res;
+		res.n = decltype(res.n)(num / g);
+		res.m = decltype(res.m)(den / g);
+		return res;
+	}
+}
+
+// num / den = num / prod(scale), reduced factor by factor to keep the numbers small
+template<class N, class W>
+void bareiss_unscale(N& num, N& den, const std::vector<W>& scale) {
+	for (const W& s : scale) {
+		N g = my_gcd(bareiss_abs(num), N(s));
+		num = num / g;
+		den = checked_mul(den, N(N(s) / g));
+	}
+}
+
+template<class T>
+T bareiss_det(const Matrix<T>& a) {
+	return bareiss_run<T>([&]<class W>() {
+		std::vector<W> scale;
+		Bareiss<W> b(bareiss_input<W>(a, &scale));
+		// det(a) = det(b) / prod(scale)
+		W num = b.det(), den = W(1);
+		bareiss_unscale(num, den, scale);
+		return bareiss_output<T>(num, den);
+	});
+}
+
+template<class T>
+size_t bareiss_rank(const Matrix<T>& a) {
+	return bareiss_run<T>([&]<class W>() { return Bareiss<W>(bareiss_input<W>(a)).rank(); });
+}
+
+template<class T>
+std::vector<size_t> bareiss_pivot_columns(const Matrix<T>& a) {
+	return bareiss_run<T>([&]<class W>() { return Bareiss<W>(bareiss_input<W>(a)).pivot_columns(); });
+}
+
+// Kernel basis from the reduced form: the vector of a free column f has
+// pivot() at f and -R[i][f] at the i-th pivot column. Rationals are divided by pivot(),
+// so the free coordinate is 1 as in fse(), integers are divided by the gcd of the entries.
+template<class T>
+ContainerMathVectors<T> bareiss_kernel(const Matrix<T>& a) {
+	return bareiss_run<T>([&]<class W>() {
+		auto [n, m] = a.size();
+		Bareiss<W> b(bareiss_input<W>(a), true);
+		const auto& r = b.echelon();
+		const auto& cols = b.pivot_columns();
+		std::vector<bool> is_main(m, false);
+		for (size_t c : cols)
+			is_main[c] = true;
+
+		ContainerMathVectors<T> res;
+		for (size_t f = 0; f < m; f++) {
+			if (is_main[f])
+				continue;
+			MathVector<T> cur(m);
+			if constexpr (!bareiss_traits<T>::rational) {
+				W g = bareiss_abs(b.pivot());
+				for (size_t i = 0; i < cols.size(); i++)
+					g = my_gcd(g, bareiss_abs(W(r[i][f])));
+				cur[f] = T(W(b.pivot() / g));
+				for (size_t i = 0; i < cols.size(); i++)
+					cur[cols[i]] = T(W(checked_neg(r[i][f]) / g));
+			} else {
+				cur[f] = T(1);
+				for (size_t i = 0; i < cols.size(); i++)
+					cur[cols[i]] = bareiss_output<T>(checked_neg(r[i][f]), b.pivot());
+			}
+			res.push_back(cur);
+		}
+		return res;
+	});
+}
+
+} // namespace detail
@@ -0,0 +1,361 @@
+// Benchmarks of the hot paths, in the spirit of Google Benchmark but without dependencies.
+// Build on Linux:  g++ -std=c++20 -O2 -march=native -pthread benchmark.cpp -o benchmark
+// Run:             ./benchmark [--filter=SUBSTRING] [--min_time=SECONDS] [--out=FILE]
+// Every benchmark is repeated until it has run for min_time seconds (0.2 by default);
+// a table goes to stderr and the results as JSON, {"context": {...}, "benchmarks": [...]},
+// to stdout or FILE, so two runs can be compared field by field.
+// Names are operation<type>/size. Matrix operations run on int, double and Rational<int>
+// where the operation is defined for the type (inverce needs a field), Polynomial is covered
+// by its own arithmetic and by char_poly_slow, which works on polynomial entries.
+// fixed_* and batch_* run on FIXED_COUNT small matrices of size N, one FixedMatrix at a time
+// and as one FixedMatrixBatch.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "matrix.h"
+#include "fixed_matrix.h"
+#include "polynomial.h"
+#include "rational.h"
+#include "thread_pool.h"
+#include "simd.h"
+
+namespace {
+
+// keeps the compiler from dropping a result that is never used
+template<class T>
+void do_not_optimize(const T& x) {
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r,m"(x) : "memory");
+#else
+	static volatile const void* sink;
+	sink = &x;
+#endif
+}
+
+struct BenchResult {
+	std::string name;
+	size_t iterations;
+	double real_ns, cpu_ns;
+};
+
+struct Benchmark {
+	std::string name;
+	// setup is done by the outer function, the returned closure is the timed body
+	std::function<std::function<void()>()> make;
+};
+
+std::vector<Benchmark>& registry() {
+	static std::vector<Benchmark> benchmarks;
+	return benchmarks;
+}
+
+void add(const std::string& name, std::function<std::function<void()>()> make) {
+	registry().push_back({ name, std::move(make) });
+}
+
+BenchResult run(const Benchmark& b, double min_time) {
+	auto body = b.make();
+	size_t iterations = 1;
+	while (true) {
+		auto wall = std::chrono::steady_clock::now();
+		std::clock_t cpu = std::clock();
+		for (size_t i = 0; i < iterations; i++)
+			body();
+		double real = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall).count();
+		double used = double(std::clock() - cpu) / CLOCKS_PER_SEC;
+		if (real >= min_time || iterations >= (size_t(1) << 30))
+			return { b.name, iterations, real * 1e9 / double(iterations), used * 1e9 / double(iterations) };
+		// aim a bit above min_time, at most 10x more iterations per round
+		double grow = real > 0 ? 1.4 * min_time / real : 10;
+		iterations = std::max(iterations + 1, size_t(double(iterations) * std::min(grow, 10.0)));
+	}
+}
+
+std::mt19937 rng(12345);
+
+template<class T>
+T random_scalar() {
+	int x = int(rng() % 19) - 9;
+	if constexpr (std::is_same_v<T, Rational<int>>)
+		return Rational<int>(x, int(rng() % 3) + 1);
+	else if constexpr (std::is_floating_point_v<T>)
+		return T(x) + T(rng() % 1000) / T(1000);
+	else
+		return T(x);
+}
+
+template<class T>
+Matrix<T> random_matrix(size_t n, size_t m) {
+	Matrix<T> a(n, m);
+	for (size_t i = 0; i < n; i++)
+		for (size_t j = 0; j < m; j++)
+			a[i][j] = random_scalar<T>();
+	return a;
+}
+
+template<class T>
+Polynomial<T> random_polynomial(size_t n) {
+	std::vector<T> c(n);
+	for (auto& x : c)
+		x = random_scalar<T>();
+	c.back() = T(1);
+	return c;
+}
+
+template<class T>
+std::string type_name() {
+	if constexpr (std::is_same_v<T, int>)
+		return "int";
+	else if constexpr (std::is_same_v<T, double>)
+		return "double";
+	else
+		return "Rational<int>";
+}
+
+template<class T>
+std::string bench_name(const std::string& op, size_t n) {
+	return op + "<" + type_name<T>() + ">/" + std::to_string(n);
+}
+
+// Rational<int> stays small, its entries grow quickly and int overflows
+template<class T>
+void register_matrix(std::vector<size_t> sizes, std::vector<size_t> exact_sizes) {
+	for (size_t n : std::is_same_v<T, Rational<int>> ? exact_sizes : sizes) {
+		add(bench_name<T>("matrix_mul", n), [n] {
+			auto a = random_matrix<T>(n, n), b = random_matrix<T>(n, n);
+			return [a, b] { Matrix<T> c = a * b; do_not_optimize(c); };
+		});
+		add(bench_name<T>("to_stepped_view", n), [n] {
+			auto a = random_matrix<T>(n, n);
+			return [a] { do_not_optimize(a.to_stepped_view()); };
+		});
+		add(bench_name<T>("det", n), [n] {
+			auto a = random_matrix<T>(n, n);
+			return [a] { do_not_optimize(a.det()); };
+		});
+		if constexpr (!std::is_integral_v<T>) {
+			add(bench_name<T>("inverce", n), [n] {
+				auto a = random_matrix<T>(n, n);
+				return [a] { do_not_optimize(a.inverce()); };
+			});
+		}
+		// rank n / 2, so the kernel and the image are both large
+		add(bench_name<T>("fse", n), [n] {
+			Matrix<T> a = random_matrix<T>(n, n / 2) * random_matrix<T>(n / 2, n);
+			return [a] { do_not_optimize(a.fse()); };
+		});
+		add(bench_name<T>("Im", n), [n] {
+			Matrix<T> a = random_matrix<T>(n, n / 2) * random_matrix<T>(n / 2, n);
+			return [a] { do_not_optimize(a.Im()); };
+		});
+	}
+	// n! terms
+	for (size_t n : { 4, 6 })
+		add(bench_name<T>("char_poly_slow", n), [n] {
+			auto a = random_matrix<T>(n, n);
+			return [a] { do_not_optimize(a.char_poly_slow()); };
+		});
+}
+
+template<class T>
+void register_polynomial(std::vector<size_t> sizes) {
+	for (size_t n : sizes) {
+		add(bench_name<T>("poly_mul", n), [n] {
+			auto p = random_polynomial<T>(n), q = random_polynomial<T>(n);
+			return [p, q] { do_not_optimize(p * q); };
+		});
+		if constexpr (!std::is_integral_v<T>) {
+			add(bench_name<T>("poly_div", n), [n] {
+				auto p = random_polynomial<T>(2 * n), q = random_polynomial<T>(n);
+				return [p, q] { do_not_optimize(p / q); do_not_optimize(p % q); };
+			});
+		}
+	}
+}
+
+constexpr size_t FIXED_COUNT = 4096;
+
+template<class T, size_t N>
+void register_fixed() {
+	auto make = [] {
+		std::vector<FixedMatrix<T, N>> v(FIXED_COUNT);
+		for (auto& a : v)
+			for (size_t i = 0; i < N; i++)
+				for (size_t j = 0; j < N; j++)
+					a[i][j] = random_scalar<T>();
+		return v;
+	};
+	auto make_batch = [make] {
+		auto v = make();
+		FixedMatrixBatch<T, N> b(v.size());
+		for (size_t i = 0; i < v.size(); i++)
+			b.set(i, v[i]);
+		return b;
+	};
+	add(bench_name<T>("fixed_det", N), [make] {
+		auto v = make();
+		return [v] {
+			for (const auto& a : v)
+				do_not_optimize(a.det());
+		};
+	});
+	add(bench_name<T>("batch_det", N), [make_batch] {
+		auto b = make_batch();
+		std::vector<T> d(b.size());
+		return [b, d]() mutable { batch_det(b, d.data()); do_not_optimize(d); };
+	});
+	if constexpr (!std::is_integral_v<T>) {
+		add(bench_name<T>("fixed_inverce", N), [make] {
+			auto v = make();
+			return [v] {
+				for (const auto& a : v)
+					do_not_optimize(a.inverce());
+			};
+		});
+		add(bench_name<T>("batch_inverce", N), [make_batch] {
+			auto b = make_batch();
+			FixedMatrixBatch<T, N> res(b.size());
+			return [b, res]() mutable { do_not_optimize(batch_inverce(b, res)); };
+		});
+	}
+	add(bench_name<T>("batch_multiply", N), [make_batch] {
+		auto b = make_batch();
+		FixedMatrixBatch<T, N> res(b.size());
+		return [b, res]() mutable { batch_multiply(b, b, res); do_not_optimize(res); };
+	});
+}
+
+void register_rational() {
+	for (size_t n : { 1024 }) {
+		auto make = [n] {
+			std::vector<Rational<int>> v(n);
+			for (auto& x : v)
+				x = Rational<int>(int(rng() % 1000) - 500, int(rng() % 1000) + 1);
+			return v;
+		};
+		add("rational_add/" + std::to_string(n), [make] {
+			auto v = make();
+			return [v] {
+				for (size_t i = 0; i + 1 < v.size(); i++)
+					do_not_optimize(v[i] + v[i + 1]);
+			};
+		});
+		add("rational_mul/" + std::to_string(n), [make] {
+			auto v = make();
+			return [v] {
+				for (size_t i = 0; i + 1 < v.size(); i++)
+					do_not_optimize(v[i] * v[i + 1]);
+			};
+		});
+		add("rational_div/" + std::to_string(n), [make] {
+			auto v = make();
+			return [v] {
+				for (size_t i = 0; i + 1 < v.size(); i++)
+					if (v[i + 1] != Rational<int>(0))
+						do_not_optimize(v[i] / v[i + 1]);
+			};
+		});
+		add("rational_compare/" + std::to_string(n), [make] {
+			auto v = make();
+			return [v] {
+				for (size_t i = 0; i + 1 < v.size(); i++)
+					do_not_optimize(v[i] < v[i + 1]);
+			};
+		});
+	}
+}
+
+std::string json_escape(const std::string& s) {
+	std::string res;
+	for (char c : s) {
+		if (c == '"' || c == '\\')
+			res += '\\';
+		res += c;
+	}
+	return res;
+}
+
+void write_json(std::ostream& out, const std::vector<BenchResult>& results) {
+	std::time_t now = std::time(nullptr);
+	char date[32];
+	std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+	const char* simd[] = { "scalar", "avx2", "avx512" };
+	out << "{\n  \"context\": {\n";
+	out << "    \"date\": \"" << date << "\",\n";
+	out << "    \"num_threads\": " << num_threads() << ",\n";
+	out << "    \"simd_level\": \"" << simd[int(simd_level())] << "\",\n";
+#ifdef NDEBUG
+	out << "    \"library_build_type\": \"release\"\n";
+#else
+	out << "    \"library_build_type\": \"debug\"\n";
+#endif
+	out << "  },\n  \"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		const auto& r = results[i];
+		out << "    {\"name\": \"" << json_escape(r.name) << "\", \"iterations\": " << r.iterations
+			<< ", \"real_time\": " << r.real_ns << ", \"cpu_time\": " << r.cpu_ns << ", \"time_unit\": \"ns\"}"
+			<< (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	std::string filter, out_path;
+	double min_time = 0.2;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.rfind("--filter=", 0) == 0)
+			filter = arg.substr(9);
+		else if (arg.rfind("--min_time=", 0) == 0)
+			min_time = std::stod(arg.substr(11));
+		else if (arg.rfind("--out=", 0) == 0)
+			out_path = arg.substr(6);
+		else {
+			std::cerr << "usage: " << argv[0] << " [--filter=SUBSTRING] [--min_time=SECONDS] [--out=FILE]\n";
+			return 1;
+		}
+	}
+
+	register_matrix<int>({ 16, 64, 256 }, {});
+	register_matrix<double>({ 16, 64, 256 }, {});
+	register_matrix<Rational<int>>({}, { 3, 5 });
+	register_polynomial<int>({ 16, 256, 4096 });
+	register_polynomial<double>({ 16, 256, 4096 });
+	register_polynomial<Rational<int>>({ 8, 16 });
+	register_rational();
+	register_fixed<double, 3>();
+	register_fixed<double, 4>();
+	register_fixed<double, 8>();
+	register_fixed<int, 4>();
+
+	std::vector<BenchResult> results;
+	std::fprintf(stderr, "%-40s %14s %14s %12s\n", "Benchmark", "Time (ns)", "CPU (ns)", "Iterations");
+	for (const auto& b : registry()) {
+		if (!filter.empty() && b.name.find(filter) == std::string::npos)
+			continue;
+		results.push_back(run(b, min_time));
+		const auto& r = results.back();
+		std::fprintf(stderr, "%-40s %14.0f %14.0f %12zu\n", r.name.c_str(), r.real_ns, r.cpu_ns, r.iterations);
+	}
+
+	if (out_path.empty()) {
+		write_json(std::cout, results);
+	} else {
+		std::ofstream out(out_path);
+		write_json(out, results);
+	}
+	return 0;
+}
@@ -0,0 +1,576 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <concepts>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "assertm.h"
+#include "instrumentation.h"
+#include "mconcepts.h"
+
+// Arbitrary-precision signed integer, kept as sign and magnitude.
+// The magnitude is an array of 32-bit limbs, least significant first. Values up to 64 bits
+// are stored inside the object without allocation. Products switch from the schoolbook
+// method to Karatsuba above BIGINT_KARATSUBA limbs, my_gcd uses Lehmer's algorithm.
+// Division truncates toward zero like the built-in integers.
+
+constexpr size_t BIGINT_KARATSUBA = 32;
+
+namespace detail {
+
+using limb = uint32_t;
+using dlimb = uint64_t;
+
+// limb array with inline storage for small values, new limbs are zero
+class LimbBuffer {
+public:
+	static constexpr size_t INLINE = 2;
+
+	LimbBuffer() {}
+	LimbBuffer(const LimbBuffer& other) { assign(other.p, other.n); }
+	LimbBuffer(LimbBuffer&& other) noexcept { take(other); }
+	~LimbBuffer() { release(); }
+
+	LimbBuffer& operator=(const LimbBuffer& other) {
+		if (this != &other)
+			assign(other.p, other.n);
+		return *this;
+	}
+	LimbBuffer& operator=(LimbBuffer&& other) noexcept {
+		if (this != &other) {
+			release();
+			take(other);
+		}
+		return *this;
+	}
+
+	size_t size() const { return n; }
+	limb* data() { return p; }
+	const limb* data() const { return p; }
+	limb& operator[](size_t i) { return p[i]; }
+	const limb& operator[](size_t i) const { return p[i]; }
+
+	void reserve(size_t k) {
+		if (k <= cap)
+			return;
+		limb* q = new limb[k];
+		std::copy(p, p + n, q);
+		release();
+		p = q;
+		cap = k;
+	}
+	void resize(size_t k) {
+		reserve(k);
+		if (k > n)
+			std::fill(p + n, p + k, limb(0));
+		n = k;
+	}
+	void assign(const limb* src, size_t k) {
+		n = 0;
+		reserve(k);
+		std::copy(src, src + k, p);
+		n = k;
+	}
+	// drops leading zero limbs, zero is the empty array
+	void trim() {
+		while (n > 0 && p[n - 1] == 0)
+			--n;
+	}
+private:
+	void release() {
+		if (p != local)
+			delete[] p;
+		p = local;
+		cap = INLINE;
+	}
+	void take(LimbBuffer& other) {
+		if (other.p == other.local) {
+			std::copy(other.local, other.local + other.n, local);
+		} else {
+			p = other.p;
+			cap = other.cap;
+			other.p = other.local;
+			other.cap = INLINE;
+		}
+		n = other.n;
+		other.n = 0;
+	}
+
+	limb local[INLINE] = {};
+	limb* p = local;
+	size_t n = 0, cap = INLINE;
+};
+
+// magnitude helpers, the output may alias an input in add and sub
+
+inline int mag_cmp(const limb* a, size_t na, const limb* b, size_t nb) {
+	if (na != nb)
+		return na < nb ? -1 : 1;
+	for (size_t i = na; i-- > 0;)
+		if (a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+	return 0;
+}
+
+// r[0, na) = a + b, na >= nb, returns the carry
+inline limb mag_add(const limb* a, size_t na, const limb* b, size_t nb, limb* r) {
+	dlimb c = 0;
+	for (size_t i = 0; i < na; i++) {
+		c += dlimb(a[i]) + (i < nb ? b[i] : 0);
+		r[i] = limb(c);
+		c >>= 32;
+	}
+	return limb(c);
+}
+
+// r[0, na) = a - b, a >= b
+inline void mag_sub(const limb* a, size_t na, const limb* b, size_t nb, limb* r) {
+	dlimb borrow = 0;
+	for (size_t i = 0; i < na; i++) {
+		dlimb d = dlimb(a[i]) - (i < nb ? b[i] : 0) - borrow;
+		r[i] = limb(d);
+		borrow = d >> 63;
+	}
+}
+
+// adds b to r starting at limb 0 and propagates the carry, r is long enough for the sum
+inline void mag_add_into(limb* r, const limb* b, size_t nb) {
+	dlimb c = 0;
+	size_t i = 0;
+	for (; i < nb; i++) {
+		c += dlimb(r[i]) + b[i];
+		r[i] = limb(c);
+		c >>= 32;
+	}
+	for (; c; i++) {
+		c += r[i];
+		r[i] = limb(c);
+		c >>= 32;
+	}
+}
+
+inline size_t mag_trimmed(const limb* a, size_t n) {
+	while (n > 0 && a[n - 1] == 0)
+		--n;
+	return n;
+}
+
+inline void mag_mul_school(const limb* a, size_t na, const limb* b, size_t nb, limb* r) {
+	std::fill(r, r + na + nb, limb(0));
+	for (size_t i = 0; i < na; i++) {
+		if (a[i] == 0)
+			continue;
+		dlimb c = 0;
+		for (size_t j = 0; j < nb; j++) {
+			c += dlimb(a[i]) * b[j] + r[i + j];
+			r[i + j] = limb(c);
+			c >>= 32;
+		}
+		r[i + nb] = limb(c);
+	}
+}
+
+// r[0, na + nb) = a * b, r must not alias the inputs
+inline void mag_mul(const limb* a, size_t na, const limb* b, size_t nb, limb* r) {
+	if (na < nb) {
+		std::swap(a, b);
+		std::swap(na, nb);
+	}
+	if (nb < BIGINT_KARATSUBA) {
+		mag_mul_school(a, na, b, nb, r);
+		return;
+	}
+	if (na >= 2 * nb) {
+		// unbalanced: b times nb-limb slices of a
+		std::fill(r, r + na + nb, limb(0));
+		std::vector<limb> t(2 * nb);
+		for (size_t i = 0; i < na; i += nb) {
+			size_t k = std::min(nb, na - i);
+			mag_mul(a + i, k, b, nb, t.data());
+			mag_add_into(r + i, t.data(), mag_trimmed(t.data(), k + nb));
+		}
+		return;
+	}
+
+	// a = a1 B^h + a0, b = b1 B^h + b0, a0 b0 and a1 b1 go straight into r,
+	// the middle term is (a0 + a1)(b0 + b1) - a0 b0 - a1 b1
+	size_t h = na / 2;
+	mag_mul(a, h, b, h, r);
+	mag_mul(a + h, na - h, b + h, nb - h, r + 2 * h);
+
+	size_t ns = na - h + 1, nt = std::max(h, nb - h) + 1;
+	std::vector<limb> s(ns), t(nt), z1(ns + nt);
+	s[ns - 1] = mag_add(a + h, na - h, a, h, s.data());
+	if (nb - h >= h)
+		t[nt - 1] = mag_add(b + h, nb - h, b, h, t.data());
+	else
+		t[nt - 1] = mag_add(b, h, b + h, nb - h, t.data());
+	mag_mul(s.data(), ns, t.data(), nt, z1.data());
+
+	size_t nz = mag_trimmed(z1.data(), ns + nt);
+	size_t n0 = mag_trimmed(r, 2 * h), n2 = mag_trimmed(r + 2 * h, na + nb - 2 * h);
+	mag_sub(z1.data(), nz, r, n0, z1.data());
+	mag_sub(z1.data(), nz, r + 2 * h, n2, z1.data());
+	mag_add_into(r + h, z1.data(), mag_trimmed(z1.data(), nz));
+}
+
+// a = a * mul + add
+inline void mag_mul_add_small(LimbBuffer& a, limb mul, limb add) {
+	dlimb c = add;
+	for (size_t i = 0; i < a.size(); i++) {
+		c += dlimb(a[i]) * mul;
+		a[i] = limb(c);
+		c >>= 32;
+	}
+	if (c) {
+		a.resize(a.size() + 1);
+		a[a.size() - 1] = limb(c);
+	}
+}
+
+// a = a / d, returns a % d
+inline limb mag_div_small(LimbBuffer& a, limb d) {
+	dlimb rem = 0;
+	for (size_t i = a.size(); i-- > 0;) {
+		dlimb cur = (rem << 32) | a[i];
+		a[i] = limb(cur / d);
+		rem = cur % d;
+	}
+	a.trim();
+	return limb(rem);
+}
+
+// q = a / b, r = a % b, b is trimmed and nonzero (Knuth, algorithm D)
+inline void mag_divmod(const limb* a, size_t na, const limb* b, size_t nb, LimbBuffer& q, LimbBuffer& r) {
+	if (mag_cmp(a, na, b, nb) < 0) {
+		r.assign(a, na);
+		q.resize(0);
+		return;
+	}
+	if (nb == 1) {
+		q.assign(a, na);
+		limb rem = mag_div_small(q, b[0]);
+		r.resize(1);
+		r[0] = rem;
+		r.trim();
+		return;
+	}
+
+	// normalize so that the top bit of the divisor is set
+	int s = std::countl_zero(b[nb - 1]);
+	std::vector<limb> u(na + 1), v(nb);
+	for (size_t i = nb; i-- > 0;)
+		v[i] = limb((b[i] << s) | (s && i ? b[i - 1] >> (32 - s) : 0));
+	u[na] = s ? a[na - 1] >> (32 - s) : 0;
+	for (size_t i = na; i-- > 0;)
+		u[i] = limb((a[i] << s) | (s && i ? a[i - 1] >> (32 - s) : 0));
+
+	q.resize(na - nb + 1);
+	for (size_t j = na - nb + 1; j-- > 0;) {
+		dlimb num = (dlimb(u[j + nb]) << 32) | u[j + nb - 1];
+		dlimb qhat = num / v[nb - 1], rhat = num % v[nb - 1];
+		while (qhat > 0xFFFFFFFFull || qhat * v[nb - 2] > ((rhat << 32) | u[j + nb - 2])) {
+			--qhat;
+			rhat += v[nb - 1];
+			if (rhat > 0xFFFFFFFFull)
+				break;
+		}
+
+		// u[j, j + nb] -= qhat * v
+		int64_t borrow = 0;
+		dlimb carry = 0;
+		for (size_t i = 0; i < nb; i++) {
+			dlimb prod = qhat * v[i] + carry;
+			carry = prod >> 32;
+			int64_t t = int64_t(u[i + j]) - borrow - int64_t(prod & 0xFFFFFFFFull);
+			u[i + j] = limb(t);
+			borrow = t < 0;
+		}
+		int64_t t = int64_t(u[j + nb]) - borrow - int64_t(carry);
+		u[j + nb] = limb(t);
+
+		// qhat was one too large, add v back
+		if (t < 0) {
+			--qhat;
+			dlimb c = 0;
+			for (size_t i = 0; i < nb; i++) {
+				c += dlimb(u[i + j]) + v[i];
+				u[i + j] = limb(c);
+				c >>= 32;
+			}
+			u[j + nb] += limb(c);
+		}
+		q[j] = limb(qhat);
+	}
+	q.trim();
+
+	r.resize(nb);
+	for (size_t i = 0; i < nb; i++)
+		r[i] = limb((u[i] >> s) | (s ? dlimb(u[i + 1]) << (32 - s) : 0));
+	r.trim();
+}
+
+} // namespace detail
+
+class BigInt {
+public:
+	BigInt() {}
+	template<std::integral I>
+	BigInt(I x) {
+		unsigned long long u;
+		if constexpr (std::is_signed_v<I>) {
+			neg = x < 0;
+			u = (unsigned long long)(long long)x;
+			if (neg)
+				u = 0ull - u;
+		} else {
+			u = x;
+		}
+		set_u64(u);
+	}
+	explicit BigInt(std::string_view s) {
+		size_t i = 0;
+		bool minus = false;
+		if (i < s.size() && (s[i] == '-' || s[i] == '+'))
+			minus = s[i++] == '-';
+		assertm(i < s.size(), "Wrong BigInt format");
+		while (i < s.size()) {
+			detail::limb chunk = 0, mul = 1;
+			for (size_t k = 0; k < 9 && i < s.size(); k++, i++) {
+				assertm(std::isdigit((unsigned char)s[i]), "Wrong BigInt format");
+				chunk = chunk * 10 + detail::limb(s[i] - '0');
+				mul *= 10;
+			}
+			detail::mag_mul_add_small(mag, mul, chunk);
+		}
+		mag.trim();
+		neg = minus && !is_zero();
+	}
+
+	// low bits in two's complement, as a cast between built-in integers
+	template<std::integral I>
+	explicit operator I() const {
+		unsigned long long u = to_u64();
+		return I(neg ? 0ull - u : u);
+	}
+
+	bool is_zero() const { return mag.size() == 0; }
+	int sign() const { return is_zero() ? 0 : neg ? -1 : 1; }
+	size_t bit_length() const { return is_zero() ? 0 : 32 * mag.size() - std::countl_zero(mag[mag.size() - 1]); }
+
+	// magnitude limbs, least significant first, for serialization
+	size_t limb_count() const { return mag.size(); }
+	const detail::limb* limbs() const { return mag.data(); }
+	static BigInt from_limbs(const detail::limb* p, size_t k, bool negative) {
+		BigInt res;
+		res.mag.assign(p, k);
+		res.mag.trim();
+		res.neg = negative && !res.is_zero();
+		return res;
+	}
+
+	// residue modulo d in [0, d)
+	detail::limb mod_small(detail::limb d) const {
+		assertm(d != 0, "Division by 0");
+		detail::dlimb rem = 0;
+		for (size_t i = mag.size(); i-- > 0;)
+			rem = ((rem << 32) | mag[i]) % d;
+		return detail::limb(neg && rem ? d - rem : rem);
+	}
+
+	std::string to_string() const {
+		if (is_zero())
+			return "0";
+		// base 10^9 digits, least significant first
+		detail::LimbBuffer x = mag;
+		std::vector<detail::limb> chunks;
+		while (x.size())
+			chunks.push_back(detail::mag_div_small(x, 1000000000));
+		std::string res = neg ? "-" : "";
+		res += std::to_string(chunks.back());
+		for (size_t i = chunks.size() - 1; i-- > 0;) {
+			std::string part = std::to_string(chunks[i]);
+			res.append(9 - part.size(), '0');
+			res += part;
+		}
+		return res;
+	}
+
+	BigInt operator-() const {
+		BigInt res(*this);
+		res.neg = !neg && !is_zero();
+		return res;
+	}
+
+	BigInt& operator+=(const BigInt& other) { add(other, other.neg); return *this; }
+	BigInt& operator-=(const BigInt& other) { add(other, !other.neg); return *this; }
+	BigInt& operator*=(const BigInt& other) { return *this = *this * other; }
+	BigInt& operator/=(const BigInt& other) { return *this = *this / other; }
+	BigInt& operator%=(const BigInt& other) { return *this = *this % other; }
+
+	friend BigInt operator+(BigInt a, const BigInt& b) { return a += b; }
+	friend BigInt operator-(BigInt a, const BigInt& b) { return a -= b; }
+	friend BigInt operator*(const BigInt& a, const BigInt& b) {
+		LA_COUNT_MUL(BigInt, 1);
+		BigInt res;
+		if (a.is_zero() || b.is_zero())
+			return res;
+		res.mag.resize(a.mag.size() + b.mag.size());
+		detail::mag_mul(a.mag.data(), a.mag.size(), b.mag.data(), b.mag.size(), res.mag.data());
+		res.mag.trim();
+		res.neg = a.neg != b.neg;
+		return res;
+	}
+	friend BigInt operator/(const BigInt& a, const BigInt& b) {
+		BigInt q, r;
+		divmod(a, b, q, r);
+		return q;
+	}
+	friend BigInt operator%(const BigInt& a, const BigInt& b) {
+		BigInt q, r;
+		divmod(a, b, q, r);
+		return r;
+	}
+
+	friend bool operator==(const BigInt& a, const BigInt& b) { return compare(a, b) == 0; }
+	friend bool operator!=(const BigInt& a, const BigInt& b) { return compare(a, b) != 0; }
+	friend bool operator<(const BigInt& a, const BigInt& b) { return compare(a, b) < 0; }
+	friend bool operator>(const BigInt& a, const BigInt& b) { return compare(a, b) > 0; }
+	friend bool operator<=(const BigInt& a, const BigInt& b) { return compare(a, b) <= 0; }
+	friend bool operator>=(const BigInt& a, const BigInt& b) { return compare(a, b) >= 0; }
+
+	friend std::ostream& operator<<(std::ostream& out, const BigInt& a) { return out << a.to_string(); }
+	friend std::istream& operator>>(std::istream& in, BigInt& a) {
+		std::string s;
+		in >> std::ws;
+		if (in.peek() == '-' || in.peek() == '+')
+			s += char(in.get());
+		while (std::isdigit(in.peek()))
+			s += char(in.get());
+		if (s.empty() || !std::isdigit((unsigned char)s.back())) {
+			in.setstate(std::ios::failbit);
+			return in;
+		}
+		a = BigInt(s);
+		return in;
+	}
+
+	// Lehmer's algorithm: the leading 32 bits of both numbers give several Euclid steps
+	// at once as a 2x2 matrix of cofactors, which is then applied to the full numbers
+	friend BigInt my_gcd(BigInt a, BigInt b) {
+		a.neg = b.neg = false;
+		if (a < b)
+			std::swap(a, b);
+		while (b.mag.size() > 2) {
+			size_t n = a.mag.size();
+			int s = std::countl_zero(a.mag[n - 1]);
+			// bits [32(n - 1) - s, 32n - s) of x, b has at least s leading zeros there as b <= a
+			auto top = [&](const detail::LimbBuffer& x) {
+				detail::dlimb hi = n - 1 < x.size() ? x[n - 1] : 0;
+				detail::dlimb lo = n - 2 < x.size() ? x[n - 2] : 0;
+				return int64_t((((hi << 32) | lo) << s) >> 32);
+			};
+			int64_t ah = top(a.mag), bh = top(b.mag);
+			int64_t A = 1, B = 0, C = 0, D = 1;
+			while (bh + C != 0 && bh + D != 0) {
+				int64_t q = (ah + A) / (bh + C);
+				if (q != (ah + B) / (bh + D))
+					break;
+				int64_t t = A - q * C;
+				A = C, C = t;
+				t = B - q * D;
+				B = D, D = t;
+				t = ah - q * bh;
+				ah = bh, bh = t;
+			}
+			if (B == 0) {
+				BigInt r = a % b;
+				a = std::move(b);
+				b = std::move(r);
+			} else {
+				BigInt x = a * BigInt(A) + b * BigInt(B);
+				BigInt y = a * BigInt(C) + b * BigInt(D);
+				a = std::move(x);
+				b = std::move(y);
+			}
+		}
+		if (b.is_zero())
+			return a;
+		a = a % b;
+		return BigInt(std::gcd(a.to_u64(), b.to_u64()));
+	}
+private:
+	void set_u64(unsigned long long u) {
+		mag.resize(2);
+		mag[0] = detail::limb(u);
+		mag[1] = detail::limb(u >> 32);
+		mag.trim();
+	}
+	// magnitude of a value below 2^64
+	unsigned long long to_u64() const {
+		unsigned long long u = 0;
+		for (size_t i = std::min<size_t>(mag.size(), 2); i-- > 0;)
+			u = (u << 32) | mag[i];
+		return u;
+	}
+
+	static int compare(const BigInt& a, const BigInt& b) {
+		if (a.neg != b.neg)
+			return a.neg ? -1 : 1;
+		int c = detail::mag_cmp(a.mag.data(), a.mag.size(), b.mag.data(), b.mag.size());
+		return a.neg ? -c : c;
+	}
+
+	// *this += (-1)^other_neg |other|, other may be *this
+	void add(const BigInt& other, bool other_neg) {
+		if (neg == other_neg || is_zero()) {
+			neg = other_neg;
+			size_t nb = other.mag.size(), k = std::max(mag.size(), nb);
+			mag.resize(k + 1);
+			mag[k] = detail::mag_add(mag.data(), k, other.mag.data(), nb, mag.data());
+			mag.trim();
+			neg = neg && !is_zero();
+			return;
+		}
+		int c = detail::mag_cmp(mag.data(), mag.size(), other.mag.data(), other.mag.size());
+		if (c == 0) {
+			mag.resize(0);
+			neg = false;
+		} else if (c > 0) {
+			detail::mag_sub(mag.data(), mag.size(), other.mag.data(), other.mag.size(), mag.data());
+			mag.trim();
+		} else {
+			size_t na = mag.size();
+			mag.resize(other.mag.size());
+			detail::mag_sub(other.mag.data(), other.mag.size(), mag.data(), na, mag.data());
+			mag.trim();
+			neg = other_neg;
+		}
+	}
+
+	static void divmod(const BigInt& a, const BigInt& b, BigInt& q, BigInt& r) {
+		LA_COUNT_DIV(BigInt, 1);
+		assertm(!b.is_zero(), "Division by 0");
+		detail::mag_divmod(a.mag.data(), a.mag.size(), b.mag.data(), b.mag.size(), q.mag, r.mag);
+		q.neg = a.neg != b.neg && !q.is_zero();
+		r.neg = a.neg && !r.is_zero();
+	}
+
+	detail::LimbBuffer mag;
+	bool neg = false;
+};
+
+template<>
+struct is_field<BigInt> : std::false_type {};
+
+template<>
+struct instrument_counts_ops<BigInt> : std::true_type {};
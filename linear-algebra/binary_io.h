@@ -0,0 +1,548 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "matrix.h"
+#include "container_math_vectors.h"
+#include "math_vector.h"
+#include "bigint.h"
+#include "modint.h"
+#include "polynomial.h"
+#include "rational.h"
+#include "assertm.h"
+
+// Binary storage of Matrix, ContainerMathVectors and Polynomial.
+// A file is a 128-byte BinaryHeader (magic "LAMX", version, byte order, shape, layout and
+// the element type as text, e.g. "f64" or "rational<bigint>") followed by the rows.
+// Fixed-size elements (built-in numbers, ModInt in its internal form) are stored raw,
+// row-major, right after the header, so a file can be mapped and used in place by
+// MappedMatrix. Other elements (BigInt, Rational, Polynomial) are encoded into frames of
+// about BINARY_IO_CHUNK bytes, each preceded by its length, and no element spans two frames.
+// BinaryWriter and BinaryReader move rows in any portions, so neither side needs the whole
+// matrix in memory; errors on reading set failbit on the stream, as operator>> does.
+
+constexpr size_t BINARY_IO_CHUNK = size_t(1) << 20;
+constexpr uint16_t BINARY_IO_VERSION = 1;
+
+// tiled files belong to TiledMatrix (out_of_core.h), the readers here reject them
+enum class BinaryLayout : uint8_t { dense = 0, vectors = 1, polynomial = 2, tiled = 3 };
+
+struct BinaryHeader {
+	char magic[4] = { 'L', 'A', 'M', 'X' };
+	uint16_t version = BINARY_IO_VERSION;
+	uint8_t layout = 0;
+	uint8_t reserved0 = 0;
+	// written as 0x01020304 in the byte order of the writer
+	uint32_t byte_order = 0x01020304;
+	// bytes per element, 0 for framed variable-size elements
+	uint32_t elem_size = 0;
+	uint64_t rows = 0, cols = 0;
+	char dtype[64] = {};
+	// side of the square tiles of a tiled file, 0 otherwise
+	uint32_t tile = 0;
+	char reserved[28] = {};
+
+	std::string dtype_name() const { return std::string(dtype, std::find(dtype, dtype + sizeof(dtype), '\0')); }
+	bool valid() const {
+		return std::memcmp(magic, "LAMX", 4) == 0 && version == BINARY_IO_VERSION && byte_order == 0x01020304;
+	}
+};
+static_assert(sizeof(BinaryHeader) == 128 && std::is_trivially_copyable_v<BinaryHeader>);
+
+// element encodings: name() goes into the header, fixed types are copied byte for byte,
+// the others append to / parse from a byte buffer
+template<class T>
+struct binary_codec {
+	static constexpr bool enabled = false;
+};
+
+namespace detail {
+
+template<class T>
+struct binary_raw_codec {
+	static constexpr bool enabled = true, fixed = true;
+	static void write(std::vector<char>& buf, const T& x) {
+		const char* p = reinterpret_cast<const char*>(&x);
+		buf.insert(buf.end(), p, p + sizeof(T));
+	}
+	static const char* read(const char* p, const char* end, T& x) {
+		if (size_t(end - p) < sizeof(T))
+			return nullptr;
+		std::memcpy(&x, p, sizeof(T));
+		return p + sizeof(T);
+	}
+};
+
+} // namespace detail
+
+template<class T>
+requires std::is_arithmetic_v<T> && (!std::is_same_v<T, bool>)
+struct binary_codec<T> : detail::binary_raw_codec<T> {
+	static std::string name() {
+		std::string kind = std::is_floating_point_v<T> ? "f" : std::is_signed_v<T> ? "i" : "u";
+		return kind + std::to_string(8 * sizeof(T));
+	}
+};
+
+template<uint32_t P>
+struct binary_codec<ModInt<P>> : detail::binary_raw_codec<ModInt<P>> {
+	static_assert(std::is_trivially_copyable_v<ModInt<P>> && sizeof(ModInt<P>) == sizeof(uint32_t));
+	static std::string name() { return "modint<" + std::to_string(P) + ">"; }
+};
+
+// sign byte, limb count, limbs
+template<>
+struct binary_codec<BigInt> {
+	static constexpr bool enabled = true, fixed = false;
+	static std::string name() { return "bigint"; }
+	static void write(std::vector<char>& buf, const BigInt& x) {
+		buf.push_back(char(x.sign() < 0));
+		uint32_t k = uint32_t(x.limb_count());
+		const char* p = reinterpret_cast<const char*>(&k);
+		buf.insert(buf.end(), p, p + sizeof(k));
+		p = reinterpret_cast<const char*>(x.limbs());
+		buf.insert(buf.end(), p, p + k * sizeof(detail::limb));
+	}
+	static const char* read(const char* p, const char* end, BigInt& x) {
+		uint32_t k;
+		if (size_t(end - p) < 1 + sizeof(k))
+			return nullptr;
+		bool neg = p[0] != 0;
+		std::memcpy(&k, p + 1, sizeof(k));
+		p += 1 + sizeof(k);
+		if (size_t(end - p) / sizeof(detail::limb) < k)
+			return nullptr;
+		std::vector<detail::limb> mag(k);
+		std::memcpy(mag.data(), p, k * sizeof(detail::limb));
+		x = BigInt::from_limbs(mag.data(), k, neg);
+		return p + k * sizeof(detail::limb);
+	}
+};
+
+// numerator and denominator, already reduced
+template<class U>
+requires binary_codec<U>::enabled
+struct binary_codec<Rational<U>> {
+	static constexpr bool enabled = true, fixed = false;
+	static std::string name() { return "rational<" + binary_codec<U>::name() + ">"; }
+	static void write(std::vector<char>& buf, const Rational<U>& x) {
+		binary_codec<U>::write(buf, x.n);
+		binary_codec<U>::write(buf, x.m);
+	}
+	static const char* read(const char* p, const char* end, Rational<U>& x) {
+		if (p = binary_codec<U>::read(p, end, x.n); !p)
+			return nullptr;
+		return binary_codec<U>::read(p, end, x.m);
+	}
+};
+
+// coefficient count, coefficients from the lowest power
+template<class U>
+requires binary_codec<U>::enabled
+struct binary_codec<Polynomial<U>> {
+	static constexpr bool enabled = true, fixed = false;
+	static std::string name() { return "poly<" + binary_codec<U>::name() + ">"; }
+	static void write(std::vector<char>& buf, const Polynomial<U>& x) {
+		uint64_t k = x.size();
+		const char* p = reinterpret_cast<const char*>(&k);
+		buf.insert(buf.end(), p, p + sizeof(k));
+		for (const U& c : x)
+			binary_codec<U>::write(buf, c);
+	}
+	static const char* read(const char* p, const char* end, Polynomial<U>& x) {
+		uint64_t k;
+		if (size_t(end - p) < sizeof(k))
+			return nullptr;
+		std::memcpy(&k, p, sizeof(k));
+		p += sizeof(k);
+		std::vector<U> c;
+		for (uint64_t i = 0; i < k && p; i++)
+			p = binary_codec<U>::read(p, end, c.emplace_back());
+		if (p)
+			x = Polynomial<U>(c);
+		return p;
+	}
+};
+
+template<class T>
+concept conc_binary = binary_codec<T>::enabled;
+
+template<conc_binary T>
+class BinaryWriter {
+public:
+	BinaryWriter(std::ostream& out, size_t rows, size_t cols, BinaryLayout layout = BinaryLayout::dense) : out(out), rows(rows), cols(cols) {
+		BinaryHeader h;
+		h.layout = uint8_t(layout);
+		h.elem_size = binary_codec<T>::fixed ? uint32_t(sizeof(T)) : 0;
+		h.rows = rows;
+		h.cols = cols;
+		std::string name = binary_codec<T>::name();
+		assertm(name.size() < sizeof(h.dtype), "Too long element type name in BinaryWriter");
+		std::copy(name.begin(), name.end(), h.dtype);
+		out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+	}
+	~BinaryWriter() { finish(); }
+	BinaryWriter(const BinaryWriter&) = delete;
+	BinaryWriter& operator=(const BinaryWriter&) = delete;
+
+	// appends the next src.rows() rows
+	BinaryWriter& write_rows(MatrixView<const T> src) {
+		assertm(src.cols() == cols && written + src.rows() <= rows, "Wrong block size in BinaryWriter::write_rows");
+		written += src.rows();
+		if constexpr (binary_codec<T>::fixed) {
+			// straight from the source buffer
+			if (src.is_contiguous())
+				out.write(reinterpret_cast<const char*>(src.data()), std::streamsize(src.rows() * cols * sizeof(T)));
+			else
+				for (size_t i = 0; i < src.rows(); i++)
+					out.write(reinterpret_cast<const char*>(src.row(i).data()), std::streamsize(cols * sizeof(T)));
+		} else {
+			for (size_t i = 0; i < src.rows(); i++)
+				for (size_t j = 0; j < cols; j++) {
+					binary_codec<T>::write(frame, src(i, j));
+					if (frame.size() >= BINARY_IO_CHUNK)
+						flush_frame();
+				}
+		}
+		return *this;
+	}
+
+	// writes the last frame, called by the destructor too
+	void finish() {
+		if (finished)
+			return;
+		finished = true;
+		assertm(written == rows, "Not all rows were written by BinaryWriter");
+		flush_frame();
+		out.flush();
+	}
+
+private:
+	void flush_frame() {
+		if (frame.empty())
+			return;
+		uint64_t len = frame.size();
+		out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+		out.write(frame.data(), std::streamsize(len));
+		frame.clear();
+	}
+
+	std::ostream& out;
+	size_t rows, cols, written = 0;
+	std::vector<char> frame;
+	bool finished = false;
+};
+
+template<conc_binary T>
+class BinaryReader {
+public:
+	// reads and checks the header, a wrong header or element type sets failbit
+	explicit BinaryReader(std::istream& in) : in(in) {
+		in.read(reinterpret_cast<char*>(&h), sizeof(h));
+		bool ok = in && h.valid() && h.tile == 0 && h.dtype_name() == binary_codec<T>::name()
+			&& h.elem_size == (binary_codec<T>::fixed ? sizeof(T) : 0) && shape_fits();
+		if (!ok)
+			fail();
+	}
+
+	bool good() const { return !failed; }
+	size_t rows() const { return h.rows; }
+	size_t cols() const { return h.cols; }
+	BinaryLayout layout() const { return BinaryLayout(h.layout); }
+
+	// reads the next dst.rows() rows into dst, false if the stream is short or damaged
+	bool read_rows(MatrixView<T> dst) {
+		assertm(dst.cols() == h.cols, "Wrong block size in BinaryReader::read_rows");
+		if (failed || read + dst.rows() > h.rows)
+			return fail();
+		read += dst.rows();
+		if constexpr (binary_codec<T>::fixed) {
+			// straight into the destination buffer
+			if (dst.is_contiguous())
+				in.read(reinterpret_cast<char*>(dst.data()), std::streamsize(dst.rows() * h.cols * sizeof(T)));
+			else
+				for (size_t i = 0; i < dst.rows() && in; i++)
+					in.read(reinterpret_cast<char*>(dst.row(i).data()), std::streamsize(h.cols * sizeof(T)));
+			if (!in)
+				return fail();
+		} else {
+			for (size_t i = 0; i < dst.rows(); i++)
+				for (size_t j = 0; j < h.cols; j++) {
+					if (pos == frame.size() && !next_frame())
+						return fail();
+					const char* p = binary_codec<T>::read(frame.data() + pos, frame.data() + frame.size(), dst(i, j));
+					if (!p)
+						return fail();
+					pos = p - frame.data();
+				}
+		}
+		return true;
+	}
+
+private:
+	// every element takes at least one byte (sizeof(T) if fixed), so a shape larger than the
+	// rest of a seekable stream is a damaged header and fails before anything is allocated
+	bool shape_fits() {
+		if (h.cols && h.rows > UINT64_MAX / h.cols)
+			return false;
+		uint64_t count = h.rows * h.cols;
+		if (count > SIZE_MAX / sizeof(T))
+			return false;
+		uint64_t need = count * (binary_codec<T>::fixed ? sizeof(T) : 1);
+		std::streampos cur = in.tellg();
+		if (cur == std::streampos(-1))
+			return true;
+		in.seekg(0, std::ios::end);
+		std::streampos end = in.tellg();
+		in.seekg(cur);
+		if (!in || end == std::streampos(-1)) {
+			in.clear();
+			return bool(in.seekg(cur));
+		}
+		return need <= uint64_t(end - cur);
+	}
+	// a frame is below BINARY_IO_CHUNK plus one element, the element can be any size; the
+	// buffer grows with the bytes actually read, so a damaged length fails at the end of
+	// the stream instead of allocating it
+	bool next_frame() {
+		uint64_t len = 0;
+		if (!in.read(reinterpret_cast<char*>(&len), sizeof(len)) || len == 0)
+			return false;
+		frame.clear();
+		pos = 0;
+		for (uint64_t done = 0; done < len;) {
+			size_t part = size_t(std::min<uint64_t>(len - done, BINARY_IO_CHUNK));
+			frame.resize(frame.size() + part);
+			if (!in.read(frame.data() + done, std::streamsize(part)))
+				return false;
+			done += part;
+		}
+		return true;
+	}
+	bool fail() {
+		failed = true;
+		in.setstate(std::ios::failbit);
+		return false;
+	}
+
+	std::istream& in;
+	BinaryHeader h;
+	size_t read = 0, pos = 0;
+	std::vector<char> frame;
+	bool failed = false;
+};
+
+// whole objects, through BinaryWriter and BinaryReader
+
+template<conc_binary T>
+std::ostream& write_binary(std::ostream& out, const Matrix<T>& a) {
+	auto [n, m] = a.size();
+	BinaryWriter<T>(out, n, m).write_rows(a.view());
+	return out;
+}
+
+template<conc_binary T>
+std::istream& read_binary(std::istream& in, Matrix<T>& a) {
+	BinaryReader<T> r(in);
+	if (r.good()) {
+		a.resize(r.rows(), r.cols());
+		r.read_rows(a.view());
+	}
+	return in;
+}
+
+// every vector is a row, all of the same size
+template<conc_binary T>
+std::ostream& write_binary(std::ostream& out, const ContainerMathVectors<T>& v) {
+	auto [k, n] = v.size();
+	BinaryWriter<T> w(out, k, n, BinaryLayout::vectors);
+	for (const auto& x : v)
+		w.write_rows(MatrixView<const T>(x.data(), 1, n));
+	return out;
+}
+
+template<conc_binary T>
+std::istream& read_binary(std::istream& in, ContainerMathVectors<T>& v) {
+	BinaryReader<T> r(in);
+	if (!r.good())
+		return in;
+	v = ContainerMathVectors<T>();
+	for (size_t i = 0; i < r.rows(); i++) {
+		MathVector<T> x(r.cols());
+		if (!r.read_rows(MatrixView<T>(x.data(), 1, r.cols())))
+			break;
+		v.push_back(x);
+	}
+	return in;
+}
+
+// coefficients from the lowest power as one row
+template<conc_binary T>
+std::ostream& write_binary(std::ostream& out, const Polynomial<T>& p) {
+	std::vector<T> c(p.begin(), p.end());
+	BinaryWriter<T>(out, 1, c.size(), BinaryLayout::polynomial).write_rows(MatrixView<const T>(c.data(), 1, c.size()));
+	return out;
+}
+
+template<conc_binary T>
+std::istream& read_binary(std::istream& in, Polynomial<T>& p) {
+	BinaryReader<T> r(in);
+	if (!r.good() || r.rows() != 1) {
+		in.setstate(std::ios::failbit);
+		return in;
+	}
+	std::vector<T> c(r.cols());
+	if (r.read_rows(MatrixView<T>(c.data(), 1, c.size())))
+		p = Polynomial<T>(c);
+	return in;
+}
+
+template<class A>
+bool save_binary(const std::string& path, const A& a) {
+	std::ofstream out(path, std::ios::binary);
+	return bool(write_binary(out, a));
+}
+
+template<class A>
+bool load_binary(const std::string& path, A& a) {
+	std::ifstream in(path, std::ios::binary);
+	return bool(read_binary(in, a));
+}
+
+namespace detail {
+
+// read-only mapping of a whole file
+class FileMapping {
+public:
+	FileMapping() {}
+	~FileMapping() { close(); }
+	FileMapping(const FileMapping&) = delete;
+	FileMapping& operator=(const FileMapping&) = delete;
+
+	bool open(const std::string& path) {
+		close();
+#if defined(_WIN32)
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+			return close(), false;
+		len = size_t(size.QuadPart);
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+			return close(), false;
+		p = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0)
+			return close(), false;
+		len = size_t(st.st_size);
+		p = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+		if (p == MAP_FAILED)
+			p = nullptr;
+#endif
+		if (!p)
+			return close(), false;
+		return true;
+	}
+
+	void close() {
+#if defined(_WIN32)
+		if (p)
+			UnmapViewOfFile(p);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (p)
+			munmap(p, len);
+		if (fd >= 0)
+			::close(fd);
+		fd = -1;
+#endif
+		p = nullptr;
+		len = 0;
+	}
+
+	const char* data() const { return static_cast<const char*>(p); }
+	size_t size() const { return len; }
+
+private:
+	void* p = nullptr;
+	size_t len = 0;
+#if defined(_WIN32)
+	HANDLE file = INVALID_HANDLE_VALUE, mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
+
+} // namespace detail
+
+// a file of fixed-size elements used in place: rows are read from the page cache on first
+// touch and nothing is copied, view() works with gemm and the other view algorithms
+template<conc_binary T>
+requires binary_codec<T>::fixed
+class MappedMatrix {
+public:
+	MappedMatrix() {}
+	explicit MappedMatrix(const std::string& path) { open(path); }
+
+	// false if the file is missing, is not a binary matrix of T or is cut short
+	bool open(const std::string& path) {
+		close();
+		if (!file.open(path) || file.size() < sizeof(BinaryHeader))
+			return close(), false;
+		BinaryHeader h;
+		std::memcpy(&h, file.data(), sizeof(h));
+		if (!h.valid() || h.tile != 0 || h.elem_size != sizeof(T) || h.dtype_name() != binary_codec<T>::name()
+			|| (h.cols != 0 && (file.size() - sizeof(h)) / sizeof(T) / h.cols < h.rows))
+			return close(), false;
+		n = h.rows;
+		m = h.cols;
+		return true;
+	}
+	void close() {
+		file.close();
+		n = m = 0;
+	}
+	bool is_open() const { return file.data() != nullptr; }
+
+	std::pair<size_t, size_t> size() const { return { n, m }; }
+	const T* data() const { return reinterpret_cast<const T*>(file.data() + sizeof(BinaryHeader)); }
+	MatrixView<const T> view() const { return { data(), n, m }; }
+	VectorView<const T> operator[](size_t i) const { return view().row(i); }
+
+	Matrix<T> to_matrix() const { return Matrix<T>(view()); }
+
+private:
+	detail::FileMapping file;
+	size_t n = 0, m = 0;
+};
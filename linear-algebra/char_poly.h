@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cmath>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "matrix.h"
+#include "polynomial.h"
+#include "bareiss.h"
+#include "thread_pool.h"
+#include "instrumentation.h"
+#include "assertm.h"
+
+// Characteristic polynomial det(xE - A) in O(n^3) or O(n^4) instead of n!.
+// Floating types: similarity reduction to upper Hessenberg form, then a recurrence
+// over its leading minors, O(n^3).
+// Everything else: Berkowitz algorithm, no divisions at all, so it works over any
+// commutative ring, O(n^4) with a small constant. Integer and Rational matrices run it over
+// integers (Rational after clearing one common denominator), without any gcd inside.
+
+// types that take the Hessenberg path, they must be fields
+template<class T>
+constexpr bool char_poly_hessenberg = std::is_floating_point_v<T>;
+
+namespace detail {
+
+// coefficients of det(xE - A) from the highest power down
+template<class T>
+std::vector<T> berkowitz(const Matrix<T>& a) {
+	LA_PHASE("char_poly::berkowitz");
+	auto [n, m] = a.size();
+	std::vector<T> p{ T(1) }, next, c, v, av;
+	for (size_t r = 0; r < n; r++) {
+		// A_{r+1} = (A_r S; R a_rr), the first column of the Toeplitz factor is
+		// 1, -a_rr, -R S, -R A_r S, ..., -R A_r^(r-1) S
+		c.assign(r + 2, T(0));
+		c[0] = T(1);
+		c[1] = -a[r][r];
+		v.resize(r);
+		av.resize(r);
+		for (size_t i = 0; i < r; i++)
+			v[i] = a[i][r];
+		for (size_t j = 0; j < r; j++) {
+			T rv = T(0);
+			for (size_t i = 0; i < r; i++)
+				rv += a[r][i] * v[i];
+			c[j + 2] = -rv;
+			if (j + 1 == r)
+				break;
+			parallel_for(0, r, r, [&](size_t lo, size_t hi) {
+				for (size_t i = lo; i < hi; i++) {
+					T s = T(0);
+					for (size_t k = 0; k < r; k++)
+						s += a[i][k] * v[k];
+					av[i] = s;
+				}
+			});
+			std::swap(v, av);
+		}
+
+		next.assign(r + 2, T(0));
+		for (size_t i = 0; i < r + 2; i++)
+			for (size_t k = 0; k <= r && k <= i; k++)
+				next[i] += c[i - k] * p[k];
+		std::swap(p, next);
+	}
+	return p;
+}
+
+template<class T>
+Polynomial<T> char_poly_berkowitz(const Matrix<T>& a) {
+	auto desc = berkowitz(a);
+	return Polynomial<T>(std::vector<T>(desc.rbegin(), desc.rend()));
+}
+
+// integer Berkowitz on L * A, where L is the lcm of all denominators,
+// then the coefficient of x^k is divided by L^(n - k); long long arithmetic is checked
+// and the computation is repeated in BigInt when it overflows, as in bareiss.h
+template<class T>
+Polynomial<T> char_poly_exact(const Matrix<T>& a) {
+	LA_PHASE("char_poly::exact");
+	return bareiss_run<T>([&]<class W>() {
+		using R = bareiss_ring<W>;
+		auto [n, m] = a.size();
+		Matrix<R> b(n, m);
+		W l = W(1);
+		if constexpr (bareiss_traits<T>::rational)
+			for (size_t k = 0; k < n * m; k++)
+				l = checked_lcm(l, W(a.data()[k].m));
+		for (size_t k = 0; k < n * m; k++) {
+			if constexpr (!bareiss_traits<T>::rational)
+				b.data()[k] = R(W(a.data()[k]));
+			else
+				b.data()[k] = R(checked_mul(W(a.data()[k].n), W(l / W(a.data()[k].m))));
+		}
+
+		auto desc = berkowitz(b);
+		std::vector<T> res(n + 1);
+		for (size_t k = 0; k <= n; k++) {
+			W num, den = W(1);
+			if constexpr (bareiss_checked<W>)
+				num = desc[n - k].v;
+			else
+				num = desc[n - k];
+			for (size_t t = k; t < n; t++) {
+				W g = my_gcd(bareiss_abs(num), l);
+				num = num / g;
+				den = checked_mul(den, W(l / g));
+			}
+			res[k] = bareiss_output<T>(num, den);
+		}
+		return Polynomial<T>(res);
+	});
+}
+
+template<class T>
+Polynomial<T> char_poly_hessenberg(const Matrix<T>& a) {
+	LA_PHASE("char_poly::hessenberg");
+	auto [n, m] = a.size();
+	Matrix<T> h = a;
+	// H = P^-1 A P, column k is cleared below the subdiagonal with row operations
+	// and the inverse column operations keep the similarity
+	for (size_t k = 0; k + 2 < n; k++) {
+		size_t p = k + 1;
+		for (size_t i = k + 2; i < n; i++)
+			if (std::abs(h[i][k]) > std::abs(h[p][k]))
+				p = i;
+		if (h[p][k] == T(0))
+			continue;
+		if (p != k + 1) {
+			h[p].swap(h[k + 1]);
+			h.col(p).swap(h.col(k + 1));
+		}
+		const T pivot = h[k + 1][k];
+		std::vector<T> mult(n, T(0));
+		for (size_t i = k + 2; i < n; i++)
+			mult[i] = h[i][k] / pivot;
+		parallel_for(k + 2, n, n - k, [&](size_t lo, size_t hi) {
+			for (size_t i = lo; i < hi; i++)
+				if (mult[i] != T(0))
+					vec_axpy(T(-mult[i]), h[k + 1].data() + k, h[i].data() + k, n - k);
+		});
+		parallel_for(0, n, n - k, [&](size_t lo, size_t hi) {
+			for (size_t r = lo; r < hi; r++) {
+				T s = T(0);
+				for (size_t i = k + 2; i < n; i++)
+					s += mult[i] * h[r][i];
+				h[r][k + 1] += s;
+			}
+		});
+	}
+
+	// p_{k+1} = (x - h_kk) p_k - sum_{i<k} h_ik h_{i+1,i} ... h_{k,k-1} p_i
+	std::vector<std::vector<T>> p(n + 1);
+	p[0] = { T(1) };
+	for (size_t k = 0; k < n; k++) {
+		auto& cur = p[k + 1];
+		cur.assign(k + 2, T(0));
+		for (size_t d = 0; d <= k; d++) {
+			cur[d + 1] += p[k][d];
+			cur[d] -= h[k][k] * p[k][d];
+		}
+		T beta = T(1);
+		for (size_t i = k; i-- > 0;) {
+			beta *= h[i + 1][i];
+			if (beta == T(0))
+				break;
+			T coef = h[i][k] * beta;
+			for (size_t d = 0; d <= i; d++)
+				cur[d] -= coef * p[i][d];
+		}
+	}
+	return Polynomial<T>(p[n]);
+}
+
+} // namespace detail
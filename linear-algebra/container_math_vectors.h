@@ -3,6 +3,7 @@
 #include <iostream>
 #include <vector>
 
+#include "allocator.h"
 #include "math_vector.h"
 #include "rational.h"
 
@@ -11,10 +12,8 @@
 // add sum
 // add solve
 
-template<class T> class Matrix;
-
 template<class T = Rational<int>>
-requires conc_num<T>
+requires conc_scalar<T>
 class ContainerMathVectors {
 private:
 	std::vector<MathVector<T>> v;
@@ -38,8 +37,8 @@ public:
 	typename std::vector<MathVector<T>>::const_iterator begin() const;
 	typename std::vector<MathVector<T>>::const_iterator end() const;
 
-	template<class T>
-	friend std::ostream& operator<<(std::ostream& out, const ContainerMathVectors& cont);
+	template<class U>
+	friend std::ostream& operator<<(std::ostream& out, const ContainerMathVectors<U>& cont);
 };
 
 #include "matrix.h"
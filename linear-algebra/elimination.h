@@ -0,0 +1,241 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "matrix_view.h"
+#include "mconcepts.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "instrumentation.h"
+#include "assertm.h"
+
+// Elimination on caller-owned storage.
+// The functions reduce a MatrixView in place and record the row permutation and the pivots
+// in an Elimination. Its vectors keep their capacity, so a batch that reuses one matrix buffer
+// and one Elimination for many matrices of the same size allocates nothing after the first.
+// Matrix::to_stepped_view and to_improved_stepped_view copy the matrix and call these,
+// LUDecomposition chooses its pivots the way lu_inplace does.
+
+struct Elimination {
+	// row i of the result is row perm[i] of the input
+	std::vector<size_t> perm;
+	// columns of the pivots, ascending
+	std::vector<size_t> pivot_cols;
+	// det of the input is sign times the product of the pivots,
+	// after to_stepped_view_inplace or lu_inplace
+	int sign = 1;
+
+	size_t rank() const { return pivot_cols.size(); }
+
+	void reset(size_t n, size_t m) {
+		perm.resize(n);
+		for (size_t i = 0; i < n; i++)
+			perm[i] = i;
+		pivot_cols.clear();
+		pivot_cols.reserve(std::min(n, m));
+		sign = 1;
+	}
+	void swap_rows(size_t i, size_t j) {
+		std::swap(perm[i], perm[j]);
+		sign = -sign;
+	}
+};
+
+// Row echelon form: row i holds the pivot of column info.pivot_cols[i], the row index
+// advances only when a column has a pivot, as in lu_inplace.
+template<class T>
+void to_stepped_view_inplace(MatrixView<T> res, Elimination& info) {
+	auto [n, m] = res.size();
+	info.reset(n, m);
+	for (size_t c = 0; c < m && info.rank() < n; c++) {
+		size_t i = info.rank();
+		for (size_t j = i; j < n; j++)
+			if (res[j][c] != 0 && (res[i][c] == 0 || abs(res[j][c]) < abs(res[i][c]))) {
+				res[j].swap(res[i]);
+				info.swap_rows(i, j);
+			}
+
+		if (res[i][c] == 0)
+			continue;
+		info.pivot_cols.push_back(c);
+		if (res[i][c] < 0) {
+			for (size_t j = c; j < m; j++)
+				res[i][j] *= -1;
+			info.sign = -info.sign;
+		}
+
+		// rows below the pivot are updated independently
+		parallel_for(i + 1, n, m - c, [&](size_t lo, size_t hi) {
+			for (size_t j = lo; j < hi; j++) {
+				T coef = -res[j][c] / res[i][c];
+				for (size_t k = c; k < m; k++)
+					res[j][k] += coef * res[i][k];
+			}
+		});
+	}
+}
+
+// the same, the pivots become 1 and the entries above them 0; info.sign is not kept
+template<class T>
+void to_improved_stepped_view_inplace(MatrixView<T> res, Elimination& info) {
+	size_t m = res.cols();
+	to_stepped_view_inplace(res, info);
+	for (size_t i = info.rank(); i-- > 0;) {
+		size_t c = info.pivot_cols[i];
+		T coef = res[i][c];
+		for (size_t j = c; j < m; j++)
+			res[i][j] /= coef;
+
+		for (size_t j = 0; j < i; j++) {
+			coef = -res[j][c];
+			for (size_t k = c; k < m; k++)
+				res[j][k] += coef * res[i][k];
+		}
+	}
+}
+
+// without metadata, the Elimination of the thread is reused
+template<class T>
+void to_stepped_view_inplace(MatrixView<T> res) {
+	thread_local Elimination info;
+	to_stepped_view_inplace(res, info);
+}
+
+template<class T>
+void to_improved_stepped_view_inplace(MatrixView<T> res) {
+	thread_local Elimination info;
+	to_improved_stepped_view_inplace(res, info);
+}
+
+namespace detail {
+
+// elements of a floating matrix at most this large in magnitude count as zero
+template<class T>
+T lu_tolerance(MatrixView<T> a) {
+	if constexpr (std::is_floating_point_v<T>) {
+		auto [n, m] = a.size();
+		T max_abs = T(0);
+		for (size_t i = 0; i < n; i++)
+			for (size_t j = 0; j < m; j++)
+				max_abs = std::max(max_abs, std::abs(a[i][j]));
+		return max_abs * T(std::max(n, m)) * std::numeric_limits<T>::epsilon();
+	} else {
+		return T(0);
+	}
+}
+
+// row of the pivot of column c among rows [r, n), n if there is none:
+// the largest element is the stable choice for floating types,
+// any nonzero one is exact and cheapest for the others
+template<class T>
+size_t lu_pivot(MatrixView<T> a, size_t r, size_t c, const T& tolerance) {
+	size_t n = a.rows(), p = n;
+	for (size_t i = r; i < n; i++) {
+		if constexpr (std::is_floating_point_v<T>) {
+			if (std::abs(a[i][c]) > tolerance && (p == n || std::abs(a[i][c]) > std::abs(a[p][c])))
+				p = i;
+		} else if (a[i][c] != T(0)) {
+			return i;
+		}
+	}
+	return p;
+}
+
+// unblocked elimination restricted to columns [c0, c1), the multipliers are stored below the
+// pivots; the next pivot is searched in rows [info.rank(), n)
+template<class T>
+void lu_eliminate(MatrixView<T> lu, Elimination& info, size_t c0, size_t c1, const T& tolerance) {
+	size_t n = lu.rows();
+	for (size_t c = c0; c < c1 && info.rank() < n; c++) {
+		size_t r = info.rank();
+		size_t p = lu_pivot(lu, r, c, tolerance);
+		if (p == n)
+			continue;
+		if (p != r) {
+			lu[p].swap(lu[r]);
+			info.swap_rows(p, r);
+		}
+		info.pivot_cols.push_back(c);
+
+		const T pivot = lu[r][c];
+		parallel_for(r + 1, n, c1 - c, [&](size_t lo, size_t hi) {
+			for (size_t i = lo; i < hi; i++) {
+				if (lu[i][c] == T(0))
+					continue;
+				T l = lu[i][c] / pivot;
+				lu[i][c] = l;
+				vec_axpy(T(-l), lu[r].data() + c + 1, lu[i].data() + c + 1, c1 - c - 1);
+			}
+		});
+	}
+}
+
+} // namespace detail
+
+// PA = LU in place, with L (unit) below the pivots and U in the pivot rows, as
+// LUDecomposition::factors(). Unblocked, meant for the small matrices of batch jobs,
+// LUDecomposition is faster on large ones.
+template<class T>
+requires is_field<T>::value
+void lu_inplace(MatrixView<T> a, Elimination& info) {
+	LA_PHASE("lu_inplace");
+	auto [n, m] = a.size();
+	info.reset(n, m);
+	detail::lu_eliminate(a, info, 0, m, detail::lu_tolerance(a));
+}
+
+// Im without building vectors: a is destroyed, and the columns of the input at the returned
+// indices are the basis Matrix::Im returns
+template<class T>
+requires is_field<T>::value
+const std::vector<size_t>& Im_inplace(MatrixView<T> a, Elimination& info) {
+	lu_inplace(a, info);
+	return info.pivot_cols;
+}
+
+// Gauss-Jordan without the augmented matrix: a is reduced to E, the same row operations turn
+// res from E into the inverse. Returns false if a is singular, res is unspecified then.
+template<class T>
+requires is_field<T>::value
+bool inverce_inplace(MatrixView<T> a, MatrixView<T> res, Elimination& info) {
+	auto [n, m] = a.size();
+	assertm(n == m && res.size() == a.size(), "Wrong matrix sizes in inverce_inplace");
+	LA_PHASE("inverce_inplace");
+	info.reset(n, m);
+	T tolerance = detail::lu_tolerance(a);
+	for (size_t i = 0; i < n; i++)
+		for (size_t j = 0; j < n; j++)
+			res[i][j] = i == j ? T(1) : T(0);
+
+	for (size_t c = 0; c < n; c++) {
+		size_t p = detail::lu_pivot(a, c, c, tolerance);
+		if (p == n)
+			return false;
+		if (p != c) {
+			a[p].swap(a[c]);
+			res[p].swap(res[c]);
+			info.swap_rows(p, c);
+		}
+		info.pivot_cols.push_back(c);
+
+		T inv = T(1) / a[c][c];
+		vec_scale(a[c].data() + c, inv, a[c].data() + c, n - c);
+		vec_scale(res[c].data(), inv, res[c].data(), n);
+		parallel_for(0, n, 2 * n - c, [&](size_t lo, size_t hi) {
+			for (size_t i = lo; i < hi; i++) {
+				if (i == c || a[i][c] == T(0))
+					continue;
+				T f = a[i][c];
+				vec_axpy(T(-f), a[c].data() + c, a[i].data() + c, n - c);
+				vec_axpy(T(-f), res[c].data(), res[i].data(), n);
+			}
+		});
+	}
+	return true;
+}
@@ -0,0 +1,695 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "matrix.h"
+#include "polynomial.h"
+#include "mconcepts.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "instrumentation.h"
+#include "assertm.h"
+
+// Small matrices with sizes known at compile time, for workloads of millions of 2x2..8x8 matrices.
+// FixedMatrix<T, N, M> keeps its entries in a std::array, so it needs no allocation and no size
+// checks, and its kernels are unrolled completely: det, inverce, product and char_poly.
+// FixedMatrixBatch<T, N, M> stores many matrices of the same size structure of arrays: entry (i, j)
+// of all matrices is contiguous. The batch_* functions run one kernel on blocks of lanes of them,
+// one matrix per lane, in AVX-512 or AVX2 registers chosen at runtime for floating types and
+// 32- and 64-bit integers; other types and compilers without vector extensions take the lanes
+// one at a time.
+// The kernels are written once over a lane type: a scalar for FixedMatrix, a block of lanes
+// for the batch. Pivoting is done by compare and swap, so every lane follows its own row order
+// without branches, and a zero pivot is replaced by 1 and remembered instead of stopping; for
+// floating types pivots up to N eps max|a| count as zero, as in LUDecomposition.
+// det and char_poly need no division below 5x5 and for integer types (Bareiss, Faddeev-LeVerrier
+// divide exactly), inverce needs a field.
+// FixedMatrix converts from Matrix<T> (sizes must match) and to it by to_matrix().
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LA_FLATTEN __attribute__((flatten))
+#define LA_INLINE __attribute__((always_inline)) inline
+#ifdef LA_SIMD_X86
+#define LA_FIXED_SIMD
+#endif
+#else
+#define LA_FLATTEN
+#define LA_INLINE inline
+#endif
+
+namespace detail {
+
+// f(std::integral_constant<size_t, I>) for I in [B, E), unrolled at compile time
+template<size_t B, size_t E, class F>
+constexpr void unroll(F&& f) {
+	if constexpr (B < E)
+		[&]<size_t... I>(std::index_sequence<I...>) {
+			(f(std::integral_constant<size_t, B + I>{}), ...);
+		}(std::make_index_sequence<E - B>{});
+}
+
+// Operations of the kernels on one lane type: a scalar here, a register of lanes below.
+// Comparisons give a mask of lanes, select takes x where it is set.
+template<class T>
+struct ScalarLanes {
+	using scalar = T;
+	using mask = bool;
+	static constexpr size_t width = 1;
+
+	static constexpr bool is_zero(const T& x) { return x == T(0); }
+	static constexpr T abs(const T& x) { return x < T(0) ? -x : x; }
+	// |x| <= t for floating types, x == 0 for the others
+	static constexpr bool negligible(const T& x, const T& t) {
+		if constexpr (std::is_floating_point_v<T>)
+			return abs(x) <= t;
+		else
+			return x == T(0);
+	}
+	// x is a better pivot than p: the larger one for floating types, any nonzero one for the others
+	static constexpr bool better_pivot(const T& x, const T& p) {
+		if constexpr (std::is_floating_point_v<T>)
+			return (x < T(0) ? -x : x) > (p < T(0) ? -p : p);
+		else
+			return p == T(0) && x != T(0);
+	}
+	static constexpr T select(bool m, const T& x, const T& y) { return m ? x : y; }
+	static constexpr bool merge(bool m, bool k) { return m || k; }
+	static constexpr bool any(bool m) { return m; }
+	static T load(const T* p) { return *p; }
+	static void store(T* p, const T& x) { *p = x; }
+};
+
+#ifdef LA_FIXED_SIMD
+// registers and lane masks of the vector extensions, one per element type and size
+template<class T, size_t Bytes> struct SimdVec {};
+#define LA_SIMD_VEC_BYTES(T, I, BYTES) \
+template<> struct SimdVec<T, BYTES> { \
+	typedef T reg __attribute__((vector_size(BYTES))); \
+	typedef I mask __attribute__((vector_size(BYTES))); \
+};
+#define LA_SIMD_VEC(T, I) LA_SIMD_VEC_BYTES(T, I, 16) LA_SIMD_VEC_BYTES(T, I, 32) LA_SIMD_VEC_BYTES(T, I, 64)
+LA_SIMD_VEC(double, long long)
+LA_SIMD_VEC(float, int)
+LA_SIMD_VEC(long long, long long)
+LA_SIMD_VEC(unsigned long long, long long)
+LA_SIMD_VEC(long, long)
+LA_SIMD_VEC(unsigned long, long)
+LA_SIMD_VEC(int, int)
+LA_SIMD_VEC(unsigned, int)
+#undef LA_SIMD_VEC
+#undef LA_SIMD_VEC_BYTES
+
+// element types with lanes, the others run the batch one matrix at a time
+template<class T>
+constexpr bool simd_lanes_supported = requires { typename SimdVec<T, 64>::reg; };
+
+// Bytes lanes of a register: vector extensions of the compiler, without target attributes, so
+// the kernels inline into the runners below and are compiled for their instruction set.
+// Registers are wrapped in structs and passed by reference, vectors by value would change
+// the ABI between instruction sets. Pivots are chosen as by ScalarLanes.
+template<class T, size_t Bytes>
+struct SimdLanes {
+	using scalar = T;
+	using reg = typename SimdVec<T, Bytes>::reg;
+	struct mask {
+		typename SimdVec<T, Bytes>::mask m;
+	};
+	static constexpr size_t width = Bytes / sizeof(T);
+
+	reg r;
+	SimdLanes() = default;
+	LA_INLINE SimdLanes(const reg& r) : r(r) {}
+	LA_INLINE SimdLanes(T x) : r(reg{} + x) {}
+	LA_INLINE friend SimdLanes operator+(const SimdLanes& x, const SimdLanes& y) { return x.r + y.r; }
+	LA_INLINE friend SimdLanes operator-(const SimdLanes& x, const SimdLanes& y) { return x.r - y.r; }
+	LA_INLINE friend SimdLanes operator*(const SimdLanes& x, const SimdLanes& y) { return x.r * y.r; }
+	LA_INLINE friend SimdLanes operator/(const SimdLanes& x, const SimdLanes& y) { return x.r / y.r; }
+	LA_INLINE SimdLanes operator-() const { return -r; }
+	LA_INLINE SimdLanes& operator+=(const SimdLanes& x) { r += x.r; return *this; }
+	LA_INLINE SimdLanes& operator-=(const SimdLanes& x) { r -= x.r; return *this; }
+	LA_INLINE SimdLanes& operator*=(const SimdLanes& x) { r *= x.r; return *this; }
+
+	LA_INLINE static mask is_zero(const SimdLanes& x) { return { x.r == T(0) }; }
+	LA_INLINE static SimdLanes abs(const SimdLanes& x) { return x.r < T(0) ? -x.r : x.r; }
+	LA_INLINE static mask negligible(const SimdLanes& x, const SimdLanes& t) {
+		if constexpr (std::is_floating_point_v<T>)
+			return { (x.r < T(0) ? -x.r : x.r) <= t.r };
+		else
+			return { x.r == T(0) };
+	}
+	LA_INLINE static mask better_pivot(const SimdLanes& x, const SimdLanes& p) {
+		if constexpr (std::is_floating_point_v<T>)
+			return { (x.r < T(0) ? -x.r : x.r) > (p.r < T(0) ? -p.r : p.r) };
+		else
+			return { (p.r == T(0)) & (x.r != T(0)) };
+	}
+	LA_INLINE static SimdLanes select(const mask& k, const SimdLanes& x, const SimdLanes& y) { return k.m ? x.r : y.r; }
+	LA_INLINE static mask merge(const mask& k, const mask& l) { return { k.m | l.m }; }
+	// halves are or-ed down to 16 bytes, which is cheaper than reading the lanes one by one
+	LA_INLINE static bool any(const mask& k) {
+		if constexpr (Bytes > 16) {
+			using H = SimdLanes<T, Bytes / 2>;
+			typename H::mask lo, hi;
+			std::memcpy(&lo, &k, Bytes / 2);
+			std::memcpy(&hi, reinterpret_cast<const char*>(&k) + Bytes / 2, Bytes / 2);
+			return H::any(H::merge(lo, hi));
+		} else {
+			unsigned long long w[2];
+			std::memcpy(w, &k, 16);
+			return (w[0] | w[1]) != 0;
+		}
+	}
+	LA_INLINE static SimdLanes load(const T* p) {
+		SimdLanes res;
+		std::memcpy(&res.r, p, Bytes);
+		return res;
+	}
+	LA_INLINE static void store(T* p, const SimdLanes& x) { std::memcpy(p, &x.r, Bytes); }
+};
+#endif
+
+// the operations of lane type V: its own for registers, ScalarLanes for scalars
+template<class V> struct lane_ops_of { using type = ScalarLanes<V>; };
+#ifdef LA_FIXED_SIMD
+template<class T, size_t Bytes> struct lane_ops_of<SimdLanes<T, Bytes>> { using type = SimdLanes<T, Bytes>; };
+#endif
+template<class V>
+using lane_ops = typename lane_ops_of<V>::type;
+
+// kernels on row-major arrays of lanes
+
+template<size_t N, size_t M, size_t K, class V>
+constexpr std::array<V, N * K> fixed_mul(const std::array<V, N * M>& a, const std::array<V, M * K>& b) {
+	std::array<V, N * K> res;
+	unroll<0, N>([&](auto i) {
+		unroll<0, K>([&](auto k) {
+			V s = a[i * M] * b[k];
+			unroll<1, M>([&](auto j) { s += a[i * M + j] * b[j * K + k]; });
+			res[i * K + k] = s;
+		});
+	});
+	return res;
+}
+
+// N eps max|a| over the first N columns of the N x W array a for floating types, 0 for the
+// others: pivots up to it are rounding errors of a singular matrix, as in lu_tolerance.
+// With Det the bound is for a determinant, N eps max|a|^N.
+template<size_t N, size_t W, bool Det = false, class V>
+constexpr V fixed_tolerance(const std::array<V, N * W>& a) {
+	using L = lane_ops<V>;
+	using S = typename L::scalar;
+	if constexpr (std::is_floating_point_v<S>) {
+		V mx = V(0);
+		unroll<0, N>([&](auto i) {
+			unroll<0, N>([&](auto j) { mx = L::select(L::better_pivot(a[i * W + j], mx), L::abs(a[i * W + j]), mx); });
+		});
+		V t = mx * V(S(N) * std::numeric_limits<S>::epsilon());
+		if constexpr (Det)
+			unroll<1, N>([&](auto) { t *= mx; });
+		return t;
+	} else {
+		return V(0);
+	}
+}
+
+// Gaussian elimination of the N x W array a with pivots in its first N columns.
+// Returns the product of the pivots with the sign of the row swaps and the lanes with a zero
+// pivot, see fixed_tolerance. With Jordan the pivot rows are divided by the pivots and the entries above them are
+// eliminated too, so [A | E] becomes [E | A^-1].
+template<size_t N, size_t W, bool Jordan, class V>
+constexpr std::pair<V, typename lane_ops<V>::mask> fixed_eliminate(std::array<V, N * W>& a) {
+	using L = lane_ops<V>;
+	using mask = typename L::mask;
+	V det = V(1), tolerance = fixed_tolerance<N, W>(a);
+	mask singular{};
+	unroll<0, N>([&](auto c) {
+		constexpr size_t C = decltype(c)::value;
+		unroll<C + 1, N>([&](auto r) {
+			mask m = L::better_pivot(a[r * W + C], a[C * W + C]);
+			if (!L::any(m))
+				return;
+			unroll<C, W>([&](auto j) {
+				V x = a[C * W + j];
+				a[C * W + j] = L::select(m, a[r * W + j], x);
+				a[r * W + j] = L::select(m, x, a[r * W + j]);
+			});
+			det = L::select(m, V(-det), det);
+		});
+
+		auto z = L::negligible(a[C * W + C], tolerance);
+		singular = L::merge(singular, z);
+		V p = L::select(z, V(1), a[C * W + C]);
+		det *= p;
+		// the multipliers are divided as in lu_eliminate, not multiplied by 1 / p: a row equal
+		// to the pivot row then cancels exactly and leaves no pivot of rounding error
+		if constexpr (Jordan) {
+			unroll<0, N>([&](auto r) {
+				if constexpr (decltype(r)::value != C) {
+					V f = a[r * W + C] / p;
+					unroll<C, W>([&](auto j) { a[r * W + j] -= f * a[C * W + j]; });
+				}
+			});
+			V inv = V(1) / p;
+			unroll<C, W>([&](auto j) { a[C * W + j] *= inv; });
+		} else {
+			unroll<C + 1, N>([&](auto r) {
+				V f = a[r * W + C] / p;
+				unroll<C + 1, W>([&](auto j) { a[r * W + j] -= f * a[C * W + j]; });
+			});
+		}
+	});
+	return { det, singular };
+}
+
+// fraction-free elimination for rings, every division is exact
+template<size_t N, class V>
+constexpr V fixed_bareiss_det(const std::array<V, N * N>& x) {
+	using L = lane_ops<V>;
+	std::array<V, N * N> a = x;
+	using mask = typename L::mask;
+	V sign = V(1), prev = V(1);
+	mask singular{};
+	unroll<0, N>([&](auto c) {
+		constexpr size_t C = decltype(c)::value;
+		unroll<C + 1, N>([&](auto r) {
+			mask m = L::better_pivot(a[r * N + C], a[C * N + C]);
+			if (!L::any(m))
+				return;
+			unroll<C, N>([&](auto j) {
+				V x = a[C * N + j];
+				a[C * N + j] = L::select(m, a[r * N + j], x);
+				a[r * N + j] = L::select(m, x, a[r * N + j]);
+			});
+			sign = L::select(m, V(-sign), sign);
+		});
+
+		auto z = L::is_zero(a[C * N + C]);
+		singular = L::merge(singular, z);
+		V p = L::select(z, V(1), a[C * N + C]);
+		unroll<C + 1, N>([&](auto r) {
+			unroll<C + 1, N>([&](auto j) { a[r * N + j] = (a[r * N + j] * p - a[r * N + C] * a[C * N + j]) / prev; });
+		});
+		prev = p;
+	});
+	return L::select(singular, V(0), V(sign * a[N * N - 1]));
+}
+
+template<size_t N, class V>
+constexpr V fixed_det(const std::array<V, N * N>& a) {
+	if constexpr (N == 1) {
+		return a[0];
+	} else if constexpr (N == 2) {
+		return a[0] * a[3] - a[1] * a[2];
+	} else if constexpr (N == 3) {
+		return a[0] * (a[4] * a[8] - a[5] * a[7]) - a[1] * (a[3] * a[8] - a[5] * a[6]) + a[2] * (a[3] * a[7] - a[4] * a[6]);
+	} else if constexpr (N == 4) {
+		// Laplace expansion by the first two rows: 2x2 minors of rows 0, 1 and of rows 2, 3
+		V s01 = a[0] * a[5] - a[1] * a[4], s02 = a[0] * a[6] - a[2] * a[4], s03 = a[0] * a[7] - a[3] * a[4];
+		V s12 = a[1] * a[6] - a[2] * a[5], s13 = a[1] * a[7] - a[3] * a[5], s23 = a[2] * a[7] - a[3] * a[6];
+		V c01 = a[8] * a[13] - a[9] * a[12], c02 = a[8] * a[14] - a[10] * a[12], c03 = a[8] * a[15] - a[11] * a[12];
+		V c12 = a[9] * a[14] - a[10] * a[13], c13 = a[9] * a[15] - a[11] * a[13], c23 = a[10] * a[15] - a[11] * a[14];
+		return s01 * c23 - s02 * c13 + s03 * c12 + s12 * c03 - s13 * c02 + s23 * c01;
+	} else if constexpr (is_field<typename lane_ops<V>::scalar>::value) {
+		std::array<V, N * N> u = a;
+		auto [det, singular] = fixed_eliminate<N, N, false>(u);
+		return lane_ops<V>::select(singular, V(0), det);
+	} else {
+		return fixed_bareiss_det<N>(a);
+	}
+}
+
+// a := a^-1, returns whether some lane is singular, its result is unspecified then
+template<size_t N, class V>
+constexpr bool fixed_inverse(std::array<V, N * N>& a) {
+	using L = lane_ops<V>;
+	if constexpr (N <= 3) {
+		// adjugate over det
+		V det = fixed_det<N>(a);
+		auto z = L::negligible(det, fixed_tolerance<N, N, true>(a));
+		V inv = V(1) / L::select(z, V(1), det);
+		if constexpr (N == 1) {
+			a[0] = inv;
+		} else if constexpr (N == 2) {
+			a = { a[3] * inv, V(-a[1]) * inv, V(-a[2]) * inv, a[0] * inv };
+		} else {
+			a = {
+				(a[4] * a[8] - a[5] * a[7]) * inv, (a[2] * a[7] - a[1] * a[8]) * inv, (a[1] * a[5] - a[2] * a[4]) * inv,
+				(a[5] * a[6] - a[3] * a[8]) * inv, (a[0] * a[8] - a[2] * a[6]) * inv, (a[2] * a[3] - a[0] * a[5]) * inv,
+				(a[3] * a[7] - a[4] * a[6]) * inv, (a[1] * a[6] - a[0] * a[7]) * inv, (a[0] * a[4] - a[1] * a[3]) * inv
+			};
+		}
+		return L::any(z);
+	} else {
+		std::array<V, N * 2 * N> ae;
+		unroll<0, N>([&](auto i) {
+			unroll<0, N>([&](auto j) {
+				ae[i * 2 * N + j] = a[i * N + j];
+				ae[i * 2 * N + N + j] = V(i == j ? 1 : 0);
+			});
+		});
+		auto singular = fixed_eliminate<N, 2 * N, true>(ae).second;
+		unroll<0, N>([&](auto i) {
+			unroll<0, N>([&](auto j) { a[i * N + j] = ae[i * 2 * N + N + j]; });
+		});
+		return L::any(singular);
+	}
+}
+
+// lanes whose matrix is singular, decided as fixed_inverse decides it
+template<size_t N, class V>
+constexpr typename lane_ops<V>::mask fixed_singular(const std::array<V, N * N>& a) {
+	using L = lane_ops<V>;
+	if constexpr (N <= 3 || !is_field<typename L::scalar>::value) {
+		return L::negligible(fixed_det<N>(a), fixed_tolerance<N, N, true>(a));
+	} else {
+		std::array<V, N * N> u = a;
+		return fixed_eliminate<N, N, false>(u).second;
+	}
+}
+
+// det(xE - A) by Faddeev-LeVerrier, coefficients from x^0 up:
+// M_k = A M_{k-1} + c_{N-k+1} E, c_{N-k} = -tr(A M_k) / k; the division is exact for integers
+template<size_t N, class V>
+constexpr std::array<V, N + 1> fixed_char_poly(const std::array<V, N * N>& a) {
+	using S = typename lane_ops<V>::scalar;
+	std::array<V, N + 1> c;
+	c[N] = V(1);
+	std::array<V, N * N> am = a;
+	// the steps are a loop, only the products inside are unrolled
+	for (size_t k = 1; k <= N; k++) {
+		if (k > 1) {
+			std::array<V, N * N> mk = am;
+			unroll<0, N>([&](auto i) { mk[i * N + i] += c[N - k + 1]; });
+			am = fixed_mul<N, N, N>(a, mk);
+		}
+		V tr = am[0];
+		unroll<1, N>([&](auto i) { tr += am[i * N + i]; });
+		c[N - k] = V(-tr) / V(S(k));
+	}
+	return c;
+}
+
+} // namespace detail
+
+template<class T, size_t N, size_t M = N>
+class FixedMatrix {
+public:
+	using value_type = T;
+
+	constexpr FixedMatrix() : a{} {
+		a.fill(T(0));
+	}
+	constexpr FixedMatrix(std::initializer_list<std::initializer_list<T>> l) : FixedMatrix() {
+		assertm(l.size() == N, "Wrong number of rows in FixedMatrix");
+		size_t i = 0;
+		for (auto& row : l) {
+			assertm(row.size() == M, "Wrong number of columns in FixedMatrix");
+			std::copy(row.begin(), row.end(), a.begin() + i++ * M);
+		}
+	}
+	template<class A>
+	explicit FixedMatrix(const Matrix<T, A>& other) {
+		assertm(other.size() == size(), "Wrong matrix sizes in FixedMatrix");
+		for (size_t i = 0; i < N; i++)
+			std::copy(other[i].begin(), other[i].end(), a.begin() + i * M);
+	}
+
+	static constexpr FixedMatrix identity() requires (N == M) {
+		FixedMatrix res;
+		for (size_t i = 0; i < N; i++)
+			res.a[i * M + i] = T(1);
+		return res;
+	}
+
+	Matrix<T> to_matrix() const { return Matrix<T>(view()); }
+
+	static constexpr std::pair<size_t, size_t> size() { return { N, M }; }
+
+	constexpr T* operator[](size_t i) { return a.data() + i * M; }
+	constexpr const T* operator[](size_t i) const { return a.data() + i * M; }
+	constexpr T* data() { return a.data(); }
+	constexpr const T* data() const { return a.data(); }
+
+	// for the view algorithms, e.g. to_stepped_view_inplace(f.view())
+	MatrixView<T> view() { return { a.data(), N, M }; }
+	MatrixView<const T> view() const { return { a.data(), N, M }; }
+
+	constexpr bool operator==(const FixedMatrix& other) const { return a == other.a; }
+	constexpr bool operator!=(const FixedMatrix& other) const { return !(*this == other); }
+
+	constexpr FixedMatrix operator+(const FixedMatrix& other) const {
+		FixedMatrix res;
+		detail::unroll<0, N * M>([&](auto k) { res.a[k] = a[k] + other.a[k]; });
+		return res;
+	}
+	constexpr FixedMatrix operator-(const FixedMatrix& other) const {
+		FixedMatrix res;
+		detail::unroll<0, N * M>([&](auto k) { res.a[k] = a[k] - other.a[k]; });
+		return res;
+	}
+	constexpr FixedMatrix operator-() const {
+		FixedMatrix res;
+		detail::unroll<0, N * M>([&](auto k) { res.a[k] = -a[k]; });
+		return res;
+	}
+	constexpr FixedMatrix operator*(const T& coef) const {
+		FixedMatrix res;
+		detail::unroll<0, N * M>([&](auto k) { res.a[k] = a[k] * coef; });
+		return res;
+	}
+	template<size_t K>
+	constexpr FixedMatrix<T, N, K> operator*(const FixedMatrix<T, M, K>& other) const {
+		FixedMatrix<T, N, K> res;
+		res.a = detail::fixed_mul<N, M, K>(a, other.a);
+		return res;
+	}
+
+	constexpr FixedMatrix& operator+=(const FixedMatrix& other) { return *this = *this + other; }
+	constexpr FixedMatrix& operator-=(const FixedMatrix& other) { return *this = *this - other; }
+	constexpr FixedMatrix& operator*=(const FixedMatrix& other) requires (N == M) { return *this = *this * other; }
+
+	constexpr FixedMatrix<T, M, N> transpose() const {
+		FixedMatrix<T, M, N> res;
+		for (size_t i = 0; i < N; i++)
+			for (size_t j = 0; j < M; j++)
+				res[j][i] = a[i * M + j];
+		return res;
+	}
+
+	constexpr T det() const requires (N == M) { return detail::fixed_det<N>(a); }
+
+	constexpr bool have_inverce() const requires (N == M) { return !detail::fixed_singular<N>(a); }
+	constexpr FixedMatrix inverce() const requires (N == M && is_field<T>::value) {
+		FixedMatrix res = *this;
+		bool singular = detail::fixed_inverse<N>(res.a);
+		assertm(!singular, "Matrix hasn't inverce");
+		(void)singular;
+		return res;
+	}
+
+	// coefficients of det(xE - A) from x^0 up
+	constexpr std::array<T, N + 1> char_poly_coefficients() const requires (N == M) { return detail::fixed_char_poly<N>(a); }
+	Polynomial<T> char_poly() const requires (N == M) {
+		auto c = char_poly_coefficients();
+		return Polynomial<T>(std::vector<T>(c.begin(), c.end()));
+	}
+
+	friend std::ostream& operator<<(std::ostream& out, const FixedMatrix& x) {
+		for (size_t i = 0; i < N; i++) {
+			for (size_t j = 0; j < M; j++)
+				out << x[i][j] << '\t';
+			out << '\n';
+		}
+		return out;
+	}
+private:
+	template<class U, size_t N1, size_t M1>
+	friend class FixedMatrix;
+
+	std::array<T, N * M> a;
+};
+
+template<class T, size_t N, size_t M>
+constexpr FixedMatrix<T, N, M> operator*(const T& coef, const FixedMatrix<T, N, M>& x) { return x * coef; }
+
+namespace detail {
+
+// matrices per block of a batch: one cache line of every entry, a whole number of registers
+template<class T>
+constexpr size_t fixed_batch_lanes = std::max<size_t>(64 / sizeof(T), 1);
+
+// entries of the matrices of lanes [j, j + width) of a batch with the given stride
+template<class V, size_t K, class T>
+std::array<V, K> fixed_load(const T* p, size_t st, size_t j) {
+	std::array<V, K> res;
+	unroll<0, K>([&](auto e) { res[e] = lane_ops<V>::load(p + e * st + j); });
+	return res;
+}
+template<class V, size_t K, class T>
+void fixed_store(T* p, size_t st, size_t j, const std::array<V, K>& x) {
+	unroll<0, K>([&](auto e) { lane_ops<V>::store(p + e * st + j, x[e]); });
+}
+
+// f.template operator()<V>(j) for the registers of lanes from j in [lo, hi), compiled for the
+// instruction set: flatten inlines the kernels and the operations of V into the target function
+template<class V, class F> LA_FLATTEN
+void fixed_batch_run_scalar(size_t lo, size_t hi, F& f) {
+	for (size_t j = lo; j < hi; j++)
+		f.template operator()<V>(j);
+}
+#ifdef LA_FIXED_SIMD
+template<class V, class F> LA_TARGET("avx2,fma") LA_FLATTEN
+void fixed_batch_run_avx2(size_t lo, size_t hi, F& f) {
+	for (size_t j = lo; j < hi; j += V::width)
+		f.template operator()<V>(j);
+}
+template<class V, class F> LA_TARGET("avx512f") LA_FLATTEN
+void fixed_batch_run_avx512(size_t lo, size_t hi, F& f) {
+	for (size_t j = lo; j < hi; j += V::width)
+		f.template operator()<V>(j);
+}
+#endif
+
+// runs f over lanes [0, stride) in blocks of fixed_batch_lanes<T>, on registers of lanes
+// when T has them and Lanes is set
+template<class T, bool Lanes = true, class F>
+void fixed_batch_for(size_t stride, size_t cost, F f) {
+	constexpr size_t B = fixed_batch_lanes<T>;
+	parallel_for(0, stride / B, cost * B, [&](size_t lo, size_t hi) {
+#ifdef LA_FIXED_SIMD
+		if constexpr (Lanes && simd_lanes_supported<T>) {
+			switch (simd_level()) {
+			case SimdLevel::avx512: return fixed_batch_run_avx512<SimdLanes<T, 64>>(lo * B, hi * B, f);
+			case SimdLevel::avx2: return fixed_batch_run_avx2<SimdLanes<T, 32>>(lo * B, hi * B, f);
+			default: break;
+			}
+		}
+#endif
+		fixed_batch_run_scalar<T>(lo * B, hi * B, f);
+	});
+}
+
+} // namespace detail
+
+// Matrices of one size stored structure of arrays: entry (i, j) of matrix b is entry(i, j)[b].
+// New matrices are zero. The count is padded to whole blocks with matrices that have ones on
+// the diagonal, so padding never looks singular.
+template<class T, size_t N, size_t M = N>
+requires std::is_arithmetic_v<T>
+class FixedMatrixBatch {
+public:
+	FixedMatrixBatch() = default;
+	explicit FixedMatrixBatch(size_t count) { resize(count); }
+
+	size_t size() const { return count; }
+	// distance between two entries of one matrix, a multiple of the block
+	size_t stride() const { return st; }
+
+	void resize(size_t new_count) {
+		constexpr size_t B = detail::fixed_batch_lanes<T>;
+		size_t new_st = (new_count + B - 1) / B * B;
+		std::vector<T> b(N * M * new_st, T(0));
+		for (size_t e = 0; e < N * M; e++)
+			std::copy(a.begin() + e * st, a.begin() + e * st + std::min(count, new_count), b.begin() + e * new_st);
+		for (size_t i = 0; i < N && i < M; i++)
+			std::fill(b.begin() + (i * M + i) * new_st + new_count, b.begin() + (i * M + i + 1) * new_st, T(1));
+		a = std::move(b);
+		count = new_count;
+		st = new_st;
+	}
+
+	T* data() { return a.data(); }
+	const T* data() const { return a.data(); }
+	T* entry(size_t i, size_t j) { return a.data() + (i * M + j) * st; }
+	const T* entry(size_t i, size_t j) const { return a.data() + (i * M + j) * st; }
+
+	FixedMatrix<T, N, M> get(size_t b) const {
+		assertm(b < count, "Wrong index in FixedMatrixBatch");
+		FixedMatrix<T, N, M> res;
+		for (size_t e = 0; e < N * M; e++)
+			res.data()[e] = a[e * st + b];
+		return res;
+	}
+	void set(size_t b, const FixedMatrix<T, N, M>& x) {
+		assertm(b < count, "Wrong index in FixedMatrixBatch");
+		for (size_t e = 0; e < N * M; e++)
+			a[e * st + b] = x.data()[e];
+	}
+private:
+	std::vector<T> a;
+	size_t count = 0, st = 0;
+};
+
+// res[b] = a[b] * c[b]
+template<class T, size_t N, size_t M, size_t K>
+void batch_multiply(const FixedMatrixBatch<T, N, M>& a, const FixedMatrixBatch<T, M, K>& c, FixedMatrixBatch<T, N, K>& res) {
+	assertm(a.size() == c.size(), "Wrong batch sizes in batch_multiply");
+	LA_PHASE("FixedMatrixBatch::multiply");
+	if (res.size() != a.size())
+		res = FixedMatrixBatch<T, N, K>(a.size());
+	size_t st = a.stride();
+	detail::fixed_batch_for<T>(st, N * M * K, [&]<class V>(size_t j) {
+		auto p = detail::fixed_mul<N, M, K>(detail::fixed_load<V, N * M>(a.data(), st, j), detail::fixed_load<V, M * K>(c.data(), st, j));
+		detail::fixed_store(res.data(), st, j, p);
+	});
+}
+
+// out[b] = det(a[b]), out has a.size() elements
+template<class T, size_t N>
+void batch_det(const FixedMatrixBatch<T, N, N>& a, T* out) {
+	LA_PHASE("FixedMatrixBatch::det");
+	size_t st = a.stride(), n = a.size();
+	// integer division has no vector instruction, and Bareiss divides in every step
+	constexpr bool lanes = !std::is_integral_v<T> || N <= 4;
+	detail::fixed_batch_for<T, lanes>(st, N * N * N, [&]<class V>(size_t j) {
+		using L = detail::lane_ops<V>;
+		V d = detail::fixed_det<N>(detail::fixed_load<V, N * N>(a.data(), st, j));
+		if (j + L::width <= n) {
+			L::store(out + j, d);
+		} else if (j < n) {
+			T tmp[L::width];
+			L::store(tmp, d);
+			std::copy(tmp, tmp + (n - j), out + j);
+		}
+	});
+}
+
+// res[b] = a[b]^-1; false if some matrix is singular, its result is unspecified then
+template<class T, size_t N>
+requires is_field<T>::value
+bool batch_inverce(const FixedMatrixBatch<T, N, N>& a, FixedMatrixBatch<T, N, N>& res) {
+	LA_PHASE("FixedMatrixBatch::inverce");
+	if (res.size() != a.size())
+		res = FixedMatrixBatch<T, N, N>(a.size());
+	size_t st = a.stride();
+	std::atomic<bool> singular = false;
+	detail::fixed_batch_for<T>(st, 2 * N * N * N, [&]<class V>(size_t j) {
+		auto x = detail::fixed_load<V, N * N>(a.data(), st, j);
+		if (detail::fixed_inverse<N>(x))
+			singular = true;
+		detail::fixed_store(res.data(), st, j, x);
+	});
+	return !singular;
+}
+
+// row b of res holds the coefficients of det(xE - a[b]) from x^0 up
+template<class T, size_t N>
+void batch_char_poly(const FixedMatrixBatch<T, N, N>& a, FixedMatrixBatch<T, 1, N + 1>& res) {
+	LA_PHASE("FixedMatrixBatch::char_poly");
+	if (res.size() != a.size())
+		res = FixedMatrixBatch<T, 1, N + 1>(a.size());
+	size_t st = a.stride();
+	detail::fixed_batch_for<T>(st, N * N * N * N, [&]<class V>(size_t j) {
+		detail::fixed_store(res.data(), st, j, detail::fixed_char_poly<N>(detail::fixed_load<V, N * N>(a.data(), st, j)));
+	});
+}
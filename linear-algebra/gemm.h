@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "instrumentation.h"
+#include "matrix_view.h"
+#include "thread_pool.h"
+#include "assertm.h"
+
+// General matrix multiply C += alpha * A * B on views.
+// float and double go through packed panels and a register-tiled micro-kernel,
+// other types (Rational, Polynomial, ...) through a cache-tiled loop.
+
+// Block sizes of the packed path.
+// MR x NR is the register tile, a KC x NR panel of B stays in L1,
+// an MC x KC block of A stays in L2, a KC x NC block of B stays in L3.
+// Products whose three dimensions are all at least STRASSEN go through Strassen-Winograd
+// (strassen.h). Exact types pay much more for a product than the packed kernel does,
+// so they switch over earlier.
+template<class T>
+struct GemmTraits {
+	static constexpr size_t MR = 4, NR = 8;
+	static constexpr size_t MC = 96, KC = 256, NC = 4096;
+	static constexpr size_t STRASSEN = 64;
+};
+
+template<>
+struct GemmTraits<double> {
+	static constexpr size_t MR = 4, NR = 8;
+	static constexpr size_t MC = 96, KC = 256, NC = 4096;
+	static constexpr size_t STRASSEN = 1024;
+};
+
+template<>
+struct GemmTraits<float> {
+	static constexpr size_t MR = 4, NR = 16;
+	static constexpr size_t MC = 192, KC = 256, NC = 4096;
+	static constexpr size_t STRASSEN = 1024;
+};
+
+// tile of the generic path, works for any T with + and *
+constexpr size_t GEMM_GENERIC_TILE = 64;
+
+namespace detail {
+
+// packs rows [0, mc) x cols [0, kc) of a into MR-row panels, k-major inside a panel
+template<class T>
+void gemm_pack_a(MatrixView<const T> a, T* buf) {
+	constexpr size_t MR = GemmTraits<T>::MR;
+	auto [mc, kc] = a.size();
+	for (size_t i0 = 0; i0 < mc; i0 += MR) {
+		size_t mr = std::min(MR, mc - i0);
+		for (size_t k = 0; k < kc; k++) {
+			for (size_t i = 0; i < mr; i++)
+				buf[i] = a(i0 + i, k);
+			for (size_t i = mr; i < MR; i++)
+				buf[i] = T(0);
+			buf += MR;
+		}
+	}
+}
+
+// packs rows [0, kc) x cols [0, nc) of b into NR-column panels, k-major inside a panel
+template<class T>
+void gemm_pack_b(MatrixView<const T> b, T* buf) {
+	constexpr size_t NR = GemmTraits<T>::NR;
+	auto [kc, nc] = b.size();
+	for (size_t j0 = 0; j0 < nc; j0 += NR) {
+		size_t nr = std::min(NR, nc - j0);
+		for (size_t k = 0; k < kc; k++) {
+			const T* src = b.data() + k * b.ld() + j0;
+			for (size_t j = 0; j < nr; j++)
+				buf[j] = src[j];
+			for (size_t j = nr; j < NR; j++)
+				buf[j] = T(0);
+			buf += NR;
+		}
+	}
+}
+
+// MR x NR tile of C += alpha * (packed A panel) * (packed B panel)
+template<class T>
+void gemm_micro_kernel(size_t kc, const T* ap, const T* bp, T* c, size_t ldc, size_t mr, size_t nr, T alpha) {
+	constexpr size_t MR = GemmTraits<T>::MR, NR = GemmTraits<T>::NR;
+	T acc[MR][NR] = {};
+	for (size_t k = 0; k < kc; k++, ap += MR, bp += NR)
+		for (size_t i = 0; i < MR; i++)
+			for (size_t j = 0; j < NR; j++)
+				acc[i][j] += ap[i] * bp[j];
+
+	for (size_t i = 0; i < mr; i++)
+		for (size_t j = 0; j < nr; j++)
+			c[i * ldc + j] += alpha * acc[i][j];
+}
+
+template<class T>
+void gemm_packed(MatrixView<const T> a, MatrixView<const T> b, MatrixView<T> c, T alpha) {
+	using Tr = GemmTraits<T>;
+	auto [n, k] = a.size();
+	size_t m = b.cols();
+
+	size_t pa_size = ((std::min(n, Tr::MC) + Tr::MR - 1) / Tr::MR) * Tr::MR * std::min(k, Tr::KC);
+	std::vector<T> pb(((std::min(m, Tr::NC) + Tr::NR - 1) / Tr::NR) * Tr::NR * std::min(k, Tr::KC));
+
+	for (size_t jc = 0; jc < m; jc += Tr::NC) {
+		size_t nc = std::min(Tr::NC, m - jc);
+		for (size_t pc = 0; pc < k; pc += Tr::KC) {
+			size_t kc = std::min(Tr::KC, k - pc);
+			gemm_pack_b(b.block(pc, jc, kc, nc), pb.data());
+			// blocks of rows of C are independent, every thread packs its own block of A
+			parallel_for(0, (n + Tr::MC - 1) / Tr::MC, Tr::MC * kc * nc, [&](size_t lo, size_t hi) {
+				thread_local std::vector<T> pa;
+				pa.resize(pa_size);
+				for (size_t ic = lo * Tr::MC; ic < std::min(n, hi * Tr::MC); ic += Tr::MC) {
+					size_t mc = std::min(Tr::MC, n - ic);
+					gemm_pack_a(a.block(ic, pc, mc, kc), pa.data());
+					for (size_t jr = 0; jr < nc; jr += Tr::NR)
+						for (size_t ir = 0; ir < mc; ir += Tr::MR)
+							gemm_micro_kernel(kc, pa.data() + ir * kc, pb.data() + jr * kc,
+								&c(ic + ir, jc + jr), c.ld(),
+								std::min(Tr::MR, mc - ir), std::min(Tr::NR, nc - jr), alpha);
+				}
+			});
+		}
+	}
+}
+
+template<class T>
+void gemm_generic(MatrixView<const T> a, MatrixView<const T> b, MatrixView<T> c, const T& alpha) {
+	constexpr size_t TILE = GEMM_GENERIC_TILE;
+	auto [n, k] = a.size();
+	size_t m = b.cols();
+	bool scaled = alpha != T(1);
+	parallel_for(0, (n + TILE - 1) / TILE, TILE * k * m, [&](size_t lo, size_t hi) {
+		for (size_t i0 = lo * TILE; i0 < std::min(n, hi * TILE); i0 += TILE)
+			for (size_t t0 = 0; t0 < k; t0 += TILE)
+				for (size_t j0 = 0; j0 < m; j0 += TILE)
+					for (size_t i = i0; i < std::min(n, i0 + TILE); i++)
+						for (size_t t = t0; t < std::min(k, t0 + TILE); t++) {
+							// exact types pay a normalization per product, zeros are skipped for free
+							if (a(i, t) == T(0))
+								continue;
+							T x = scaled ? alpha * a(i, t) : a(i, t);
+							for (size_t j = j0; j < std::min(m, j0 + TILE); j++)
+								c(i, j) += x * b(t, j);
+						}
+	});
+}
+
+// C += alpha * A * B with the classic O(n^3) kernels
+template<class T>
+void gemm_base(MatrixView<const T> a, MatrixView<const T> b, MatrixView<T> c, const T& alpha) {
+	if (a.rows() == 0 || b.cols() == 0 || a.cols() == 0)
+		return;
+	if constexpr (!instrument_counts_ops<T>::value)
+		LA_COUNT_MUL(T, a.rows() * a.cols() * b.cols());
+	if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>)
+		gemm_packed(a, b, c, alpha);
+	else
+		gemm_generic(a, b, c, alpha);
+}
+
+} // namespace detail
+
+#include "strassen.h"
+
+template<class T>
+void gemm(MatrixView<const T> a, MatrixView<const T> b, MatrixView<T> c, const T& alpha = T(1)) {
+	auto [n, k] = a.size();
+	auto [k1, m] = b.size();
+	assertm(k == k1 && c.rows() == n && c.cols() == m, "Wrong matrix sizes in gemm");
+	detail::gemm_strassen(a, b, c, alpha);
+}
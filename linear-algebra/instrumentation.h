@@ -0,0 +1,338 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <typeinfo>
+#include <vector>
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+
+// Instrumentation of the hot paths, compiled in with -DLA_INSTRUMENT=1.
+// By default it is off and every hook below is an empty statement, the API still compiles
+// and reports nothing.
+// - scalar operations per type: multiplications, divisions and my_gcd calls. Rational and
+//   BigInt count their own operations (a gcd per Rational::normalize), types without hooks
+//   (built-in, ModInt) are counted in bulk by gemm, n * k * m products per call.
+// - heap allocations: counted by a replacement of the global operator new, which is defined
+//   in the one translation unit that defines LA_INSTRUMENT_NEW before including the library.
+// - phases: LA_PHASE("name") times the rest of the enclosing scope and records the allocations
+//   made meanwhile (by any thread). Public operations of Matrix and Polynomial and the steps
+//   of the algorithms behind them are marked. Nested phases are inclusive.
+// instrument_stats() takes a snapshot, reset_instrument_stats() starts over. With
+// set_instrument_tracing(true) every phase is also logged as an event, dump_instrument_trace
+// writes them in the Chrome trace format (chrome://tracing, ui.perfetto.dev).
+
+#ifndef LA_INSTRUMENT
+#define LA_INSTRUMENT 0
+#endif
+
+constexpr bool instrumented = LA_INSTRUMENT;
+
+// trace events kept at most, later ones are dropped
+constexpr size_t INSTRUMENT_TRACE_EVENTS = size_t(1) << 20;
+
+// true for types that count their own operations, gemm does not count them again
+template<class T>
+struct instrument_counts_ops : std::false_type {};
+
+struct OpStats {
+	std::string type;
+	uint64_t muls = 0, divs = 0, gcds = 0;
+};
+
+struct PhaseStats {
+	std::string name;
+	uint64_t calls = 0;
+	double seconds = 0;
+	uint64_t allocations = 0, bytes = 0;
+};
+
+struct InstrumentStats {
+	std::vector<OpStats> ops;
+	std::vector<PhaseStats> phases;
+	// all allocations since the last reset, zero without LA_INSTRUMENT_NEW
+	uint64_t allocations = 0, bytes = 0;
+
+	// zeros for a type or a phase that was not seen
+	OpStats op(std::string_view type) const {
+		auto it = std::find_if(ops.begin(), ops.end(), [&](const OpStats& s) { return s.type == type; });
+		return it == ops.end() ? OpStats{ std::string(type) } : *it;
+	}
+	PhaseStats phase(std::string_view name) const {
+		auto it = std::find_if(phases.begin(), phases.end(), [&](const PhaseStats& s) { return s.name == name; });
+		return it == phases.end() ? PhaseStats{ std::string(name) } : *it;
+	}
+
+	friend std::ostream& operator<<(std::ostream& out, const InstrumentStats& s) {
+		out << "allocations " << s.allocations << ", bytes " << s.bytes << '\n';
+		for (const auto& o : s.ops)
+			out << o.type << ": muls " << o.muls << ", divs " << o.divs << ", gcds " << o.gcds << '\n';
+		for (const auto& p : s.phases)
+			out << p.name << ": calls " << p.calls << ", " << std::fixed << std::setprecision(6) << p.seconds
+				<< std::defaultfloat << " s, allocations " << p.allocations << ", bytes " << p.bytes << '\n';
+		return out;
+	}
+};
+
+namespace detail {
+
+template<class T>
+std::string instrument_type_name() {
+	const char* name = typeid(T).name();
+#if defined(__GNUG__)
+	int status = 0;
+	std::unique_ptr<char, void (*)(void*)> demangled(abi::__cxa_demangle(name, nullptr, nullptr, &status), std::free);
+	if (status == 0)
+		return demangled.get();
+#endif
+	return name;
+}
+
+// constant-initialized, operator new may run before any other static is constructed
+inline std::atomic<uint64_t> instrument_allocations{ 0 }, instrument_bytes{ 0 };
+
+// every thread has its own block per type, a counter has a single writer and needs no lock
+struct OpCounters {
+	std::atomic<uint64_t> muls{ 0 }, divs{ 0 }, gcds{ 0 };
+};
+
+inline void instrument_add(std::atomic<uint64_t>& c, uint64_t k) {
+	c.store(c.load(std::memory_order_relaxed) + k, std::memory_order_relaxed);
+}
+
+struct PhaseCounters {
+	std::atomic<uint64_t> calls{ 0 }, nanoseconds{ 0 }, allocations{ 0 }, bytes{ 0 };
+};
+
+struct TraceEvent {
+	const std::string* name;
+	size_t thread;
+	int64_t start, duration; // nanoseconds
+};
+
+// small numbers for the trace, in the order threads first finish a phase
+inline size_t instrument_thread_index() {
+	static std::atomic<size_t> next{ 0 };
+	thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed);
+	return index;
+}
+
+struct InstrumentRegistry {
+	std::mutex mutex;
+	std::map<std::string, std::vector<std::unique_ptr<OpCounters>>> ops;
+	std::map<std::string, std::unique_ptr<PhaseCounters>, std::less<>> phases;
+	std::atomic<bool> tracing{ false };
+	std::vector<TraceEvent> trace;
+	uint64_t dropped = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+// never destroyed, worker threads may still count while statics are torn down
+inline InstrumentRegistry& instrument_registry() {
+	static InstrumentRegistry* r = new InstrumentRegistry;
+	return *r;
+}
+
+inline OpCounters* instrument_register_ops(std::string type) {
+	auto& r = instrument_registry();
+	std::lock_guard lock(r.mutex);
+	auto& blocks = r.ops[std::move(type)];
+	blocks.push_back(std::make_unique<OpCounters>());
+	return blocks.back().get();
+}
+
+template<class T>
+OpCounters& op_counters() {
+	thread_local OpCounters* c = instrument_register_ops(instrument_type_name<T>());
+	return *c;
+}
+
+inline std::pair<const std::string*, PhaseCounters*> phase_counters(const char* name) {
+	auto& r = instrument_registry();
+	std::lock_guard lock(r.mutex);
+	auto it = r.phases.find(std::string_view(name));
+	if (it == r.phases.end())
+		it = r.phases.emplace(name, std::make_unique<PhaseCounters>()).first;
+	return { &it->first, it->second.get() };
+}
+
+class PhaseScope {
+public:
+	explicit PhaseScope(std::pair<const std::string*, PhaseCounters*> phase) :
+		name(phase.first), c(*phase.second),
+		allocations(instrument_allocations.load(std::memory_order_relaxed)),
+		bytes(instrument_bytes.load(std::memory_order_relaxed)),
+		start(std::chrono::steady_clock::now()) {}
+	PhaseScope(const PhaseScope&) = delete;
+	PhaseScope& operator=(const PhaseScope&) = delete;
+
+	~PhaseScope() {
+		auto end = std::chrono::steady_clock::now();
+		int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+		c.calls.fetch_add(1, std::memory_order_relaxed);
+		c.nanoseconds.fetch_add(uint64_t(ns), std::memory_order_relaxed);
+		c.allocations.fetch_add(since(instrument_allocations, allocations), std::memory_order_relaxed);
+		c.bytes.fetch_add(since(instrument_bytes, bytes), std::memory_order_relaxed);
+		auto& r = instrument_registry();
+		if (r.tracing.load(std::memory_order_relaxed)) {
+			std::lock_guard lock(r.mutex);
+			if (r.trace.size() < INSTRUMENT_TRACE_EVENTS)
+				r.trace.push_back({ name, instrument_thread_index(),
+					std::chrono::duration_cast<std::chrono::nanoseconds>(start - r.start).count(), ns });
+			else
+				r.dropped++;
+		}
+	}
+private:
+	// a reset inside the phase restarts the count from zero
+	static uint64_t since(const std::atomic<uint64_t>& counter, uint64_t start) {
+		uint64_t now = counter.load(std::memory_order_relaxed);
+		return now >= start ? now - start : now;
+	}
+
+	const std::string* name;
+	PhaseCounters& c;
+	uint64_t allocations, bytes;
+	std::chrono::steady_clock::time_point start;
+};
+
+} // namespace detail
+
+#define LA_CONCAT_IMPL(a, b) a##b
+#define LA_CONCAT(a, b) LA_CONCAT_IMPL(a, b)
+
+#if LA_INSTRUMENT
+#define LA_COUNT_MUL(T, k) ::detail::instrument_add(::detail::op_counters<T>().muls, uint64_t(k))
+#define LA_COUNT_DIV(T, k) ::detail::instrument_add(::detail::op_counters<T>().divs, uint64_t(k))
+#define LA_COUNT_GCD(T, k) ::detail::instrument_add(::detail::op_counters<T>().gcds, uint64_t(k))
+// the counters of a call site are looked up once
+#define LA_PHASE(name) \
+	static const auto LA_CONCAT(la_phase_, __LINE__) = ::detail::phase_counters(name); \
+	::detail::PhaseScope LA_CONCAT(la_phase_scope_, __LINE__)(LA_CONCAT(la_phase_, __LINE__))
+#else
+#define LA_COUNT_MUL(T, k) ((void)0)
+#define LA_COUNT_DIV(T, k) ((void)0)
+#define LA_COUNT_GCD(T, k) ((void)0)
+#define LA_PHASE(name) ((void)0)
+#endif
+
+inline InstrumentStats instrument_stats() {
+	InstrumentStats s;
+	s.allocations = detail::instrument_allocations.load(std::memory_order_relaxed);
+	s.bytes = detail::instrument_bytes.load(std::memory_order_relaxed);
+	auto& r = detail::instrument_registry();
+	std::lock_guard lock(r.mutex);
+	for (const auto& [type, blocks] : r.ops) {
+		OpStats o{ type };
+		for (const auto& b : blocks) {
+			o.muls += b->muls.load(std::memory_order_relaxed);
+			o.divs += b->divs.load(std::memory_order_relaxed);
+			o.gcds += b->gcds.load(std::memory_order_relaxed);
+		}
+		s.ops.push_back(std::move(o));
+	}
+	for (const auto& [name, c] : r.phases)
+		s.phases.push_back({ name, c->calls.load(std::memory_order_relaxed), double(c->nanoseconds.load(std::memory_order_relaxed)) * 1e-9,
+			c->allocations.load(std::memory_order_relaxed), c->bytes.load(std::memory_order_relaxed) });
+	return s;
+}
+
+template<class T>
+OpStats op_stats() {
+	return instrument_stats().op(detail::instrument_type_name<T>());
+}
+
+// counts made by other threads at the same time may survive the reset
+inline void reset_instrument_stats() {
+	detail::instrument_allocations.store(0, std::memory_order_relaxed);
+	detail::instrument_bytes.store(0, std::memory_order_relaxed);
+	auto& r = detail::instrument_registry();
+	std::lock_guard lock(r.mutex);
+	for (auto& [type, blocks] : r.ops)
+		for (auto& b : blocks)
+			b->muls = b->divs = b->gcds = 0;
+	for (auto& [name, c] : r.phases)
+		c->calls = c->nanoseconds = c->allocations = c->bytes = 0;
+	r.trace.clear();
+	r.dropped = 0;
+	r.start = std::chrono::steady_clock::now();
+}
+
+inline void set_instrument_tracing(bool on) {
+	detail::instrument_registry().tracing = on;
+}
+
+// {"traceEvents": [...]} with one complete event per phase call, times in microseconds
+inline void dump_instrument_trace(std::ostream& out) {
+	auto& r = detail::instrument_registry();
+	std::lock_guard lock(r.mutex);
+	out << "{\"traceEvents\": [";
+	for (size_t i = 0; i < r.trace.size(); i++) {
+		const auto& e = r.trace[i];
+		out << (i ? ",\n" : "\n") << "{\"name\": \"" << *e.name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << e.thread
+			<< ", \"ts\": " << double(e.start) * 1e-3 << ", \"dur\": " << double(e.duration) * 1e-3 << "}";
+	}
+	out << "\n], \"droppedEvents\": " << r.dropped << "}\n";
+}
+
+#if LA_INSTRUMENT && defined(LA_INSTRUMENT_NEW)
+// replaceable allocation functions, must not be inline: defined in one translation unit only
+
+namespace detail {
+
+inline void* instrument_alloc(size_t size, size_t align) {
+	instrument_allocations.fetch_add(1, std::memory_order_relaxed);
+	instrument_bytes.fetch_add(size, std::memory_order_relaxed);
+	if (size == 0)
+		size = 1;
+	void* p;
+#if defined(_MSC_VER)
+	p = align > alignof(std::max_align_t) ? _aligned_malloc(size, align) : std::malloc(size);
+#else
+	p = align > alignof(std::max_align_t) ? std::aligned_alloc(align, (size + align - 1) / align * align) : std::malloc(size);
+#endif
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+inline void instrument_free(void* p, size_t align) {
+#if defined(_MSC_VER)
+	if (align > alignof(std::max_align_t)) {
+		_aligned_free(p);
+		return;
+	}
+#endif
+	(void)align;
+	std::free(p);
+}
+
+} // namespace detail
+
+void* operator new(size_t size) { return detail::instrument_alloc(size, 0); }
+void* operator new[](size_t size) { return detail::instrument_alloc(size, 0); }
+void* operator new(size_t size, std::align_val_t align) { return detail::instrument_alloc(size, size_t(align)); }
+void* operator new[](size_t size, std::align_val_t align) { return detail::instrument_alloc(size, size_t(align)); }
+void operator delete(void* p) noexcept { detail::instrument_free(p, 0); }
+void operator delete[](void* p) noexcept { detail::instrument_free(p, 0); }
+void operator delete(void* p, size_t) noexcept { detail::instrument_free(p, 0); }
+void operator delete[](void* p, size_t) noexcept { detail::instrument_free(p, 0); }
+void operator delete(void* p, std::align_val_t align) noexcept { detail::instrument_free(p, size_t(align)); }
+void operator delete[](void* p, std::align_val_t align) noexcept { detail::instrument_free(p, size_t(align)); }
+void operator delete(void* p, size_t, std::align_val_t align) noexcept { detail::instrument_free(p, size_t(align)); }
+void operator delete[](void* p, size_t, std::align_val_t align) noexcept { detail::instrument_free(p, size_t(align)); }
+#endif
@@ -0,0 +1,374 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "matrix.h"
+#include "math_vector.h"
+#include "sparse_matrix.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "instrumentation.h"
+#include "assertm.h"
+
+// Iterative solvers for A x = b over floating types: CG for symmetric positive definite A,
+// GMRES(m) and BiCGSTAB for general A. Memory is a few vectors (m + 2 of them for GMRES),
+// time is a number of products A x, so A only has to be a LinearOperator: a Matrix,
+// a SparseMatrix or any function computing y = A x.
+// Preconditioners approximate A^-1: CG applies them to the residual, GMRES and BiCGSTAB
+// from the right, so the residual they test is always the one of the original system.
+// A solver stops when ||b - A x|| <= tolerance * ||b|| or after max_iterations products.
+
+template<std::floating_point T>
+class LinearOperator {
+public:
+	// y = A x, y already has the right size
+	using Apply = std::function<void(const MathVector<T>& x, MathVector<T>& y)>;
+
+	LinearOperator(size_t n, Apply f) : n(n), f(std::move(f)) {}
+	// matrices are held by reference and must outlive the operator
+	LinearOperator(const Matrix<T>& a);
+	LinearOperator(const SparseMatrix<T>& a);
+
+	size_t size() const { return n; }
+	void apply(const MathVector<T>& x, MathVector<T>& y) const {
+		assertm(x.size() == n && y.size() == n, "Wrong sizes in LinearOperator::apply");
+		f(x, y);
+	}
+	MathVector<T> operator*(const MathVector<T>& x) const {
+		MathVector<T> y(n);
+		apply(x, y);
+		return y;
+	}
+private:
+	size_t n;
+	Apply f;
+};
+
+template<std::floating_point T>
+LinearOperator<T>::LinearOperator(const Matrix<T>& a) : n(a.size().first) {
+	assertm(a.size().first == a.size().second, "Wrong matrix sizes in LinearOperator");
+	f = [&a](const MathVector<T>& x, MathVector<T>& y) {
+		size_t n = x.size();
+		parallel_for(0, n, n, [&](size_t lo, size_t hi) {
+			for (size_t i = lo; i < hi; i++)
+				y[i] = vec_dot(a[i].data(), x.data(), n);
+		});
+	};
+}
+
+template<std::floating_point T>
+LinearOperator<T>::LinearOperator(const SparseMatrix<T>& a) : n(a.size().first) {
+	assertm(a.size().first == a.size().second, "Wrong matrix sizes in LinearOperator");
+	f = [&a](const MathVector<T>& x, MathVector<T>& y) { y = a * x; };
+}
+
+// preconditioners
+
+template<std::floating_point T>
+class Preconditioner {
+public:
+	virtual ~Preconditioner() = default;
+	// z = M^-1 r
+	virtual void apply(const MathVector<T>& r, MathVector<T>& z) const = 0;
+};
+
+template<std::floating_point T>
+class IdentityPreconditioner : public Preconditioner<T> {
+public:
+	void apply(const MathVector<T>& r, MathVector<T>& z) const override { z = r; }
+};
+
+// M = diag(A)
+template<std::floating_point T>
+class JacobiPreconditioner : public Preconditioner<T> {
+public:
+	explicit JacobiPreconditioner(const MathVector<T>& diag) : inv(diag.size()) {
+		for (size_t i = 0; i < diag.size(); i++) {
+			assertm(diag[i] != T(0), "Zero diagonal in JacobiPreconditioner");
+			inv[i] = T(1) / diag[i];
+		}
+	}
+	explicit JacobiPreconditioner(const Matrix<T>& a) : JacobiPreconditioner(diagonal(a)) {}
+	explicit JacobiPreconditioner(const SparseMatrix<T>& a) : JacobiPreconditioner(diagonal(a)) {}
+
+	void apply(const MathVector<T>& r, MathVector<T>& z) const override {
+		z = MathVector<T>(r.size());
+		for (size_t i = 0; i < r.size(); i++)
+			z[i] = r[i] * inv[i];
+	}
+private:
+	static MathVector<T> diagonal(const SparseMatrix<T>& a) {
+		size_t n = a.size().first;
+		assertm(n == a.size().second, "Wrong matrix sizes in JacobiPreconditioner");
+		MathVector<T> d(n);
+		for (size_t i = 0; i < n; i++)
+			d[i] = a(i, i);
+		return d;
+	}
+	static MathVector<T> diagonal(const Matrix<T>& a) {
+		size_t n = a.size().first;
+		assertm(n == a.size().second, "Wrong matrix sizes in JacobiPreconditioner");
+		MathVector<T> d(n);
+		for (size_t i = 0; i < n; i++)
+			d[i] = a[i][i];
+		return d;
+	}
+
+	MathVector<T> inv;
+};
+
+// M = LU, where L and U are the incomplete factors of A restricted to its own nonzero pattern
+template<std::floating_point T>
+class Ilu0Preconditioner : public Preconditioner<T> {
+public:
+	explicit Ilu0Preconditioner(const SparseMatrix<T>& a);
+	explicit Ilu0Preconditioner(const Matrix<T>& a) : Ilu0Preconditioner(SparseMatrix<T>(a)) {}
+
+	void apply(const MathVector<T>& r, MathVector<T>& z) const override;
+private:
+	size_t n;
+	std::vector<size_t> ptr, idx, diag;
+	std::vector<T> val;
+};
+
+template<std::floating_point T>
+Ilu0Preconditioner<T>::Ilu0Preconditioner(const SparseMatrix<T>& a) :
+	n(a.size().first), ptr(a.row_ptr()), idx(a.col_idx()), diag(n), val(a.values()) {
+	assertm(n == a.size().second, "Wrong matrix sizes in Ilu0Preconditioner");
+	for (size_t i = 0; i < n; i++) {
+		auto it = std::lower_bound(idx.begin() + ptr[i], idx.begin() + ptr[i + 1], i);
+		assertm(it != idx.begin() + ptr[i + 1] && *it == i, "Zero diagonal in Ilu0Preconditioner");
+		diag[i] = it - idx.begin();
+	}
+	// IKJ elimination, updates outside the pattern are dropped
+	const size_t none = size_t(-1);
+	std::vector<size_t> pos(n, none);
+	for (size_t i = 0; i < n; i++) {
+		for (size_t k = ptr[i]; k < ptr[i + 1]; k++)
+			pos[idx[k]] = k;
+		for (size_t k = ptr[i]; k < diag[i]; k++) {
+			size_t c = idx[k];
+			assertm(val[diag[c]] != T(0), "Zero pivot in Ilu0Preconditioner");
+			T l = val[k] /= val[diag[c]];
+			for (size_t t = diag[c] + 1; t < ptr[c + 1]; t++)
+				if (pos[idx[t]] != none)
+					val[pos[idx[t]]] -= l * val[t];
+		}
+		for (size_t k = ptr[i]; k < ptr[i + 1]; k++)
+			pos[idx[k]] = none;
+	}
+}
+
+template<std::floating_point T>
+void Ilu0Preconditioner<T>::apply(const MathVector<T>& r, MathVector<T>& z) const {
+	z = r;
+	for (size_t i = 0; i < n; i++)
+		for (size_t k = ptr[i]; k < diag[i]; k++)
+			z[i] -= val[k] * z[idx[k]];
+	for (size_t i = n; i-- > 0;) {
+		for (size_t k = diag[i] + 1; k < ptr[i + 1]; k++)
+			z[i] -= val[k] * z[idx[k]];
+		z[i] /= val[diag[i]];
+	}
+}
+
+// solvers
+
+template<std::floating_point T>
+struct SolverOptions {
+	T tolerance = T(1e-10);
+	size_t max_iterations = 1000;
+	// Krylov basis size of GMRES before a restart
+	size_t restart = 30;
+};
+
+template<std::floating_point T>
+struct SolverResult {
+	MathVector<T> x;
+	// products A x spent
+	size_t iterations = 0;
+	// ||b - A x|| / ||b|| of the returned x
+	T residual = T(0);
+	bool converged = false;
+};
+
+namespace detail {
+
+template<class T>
+void finish_solve(const LinearOperator<T>& a, const MathVector<T>& b, SolverResult<T>& res, const SolverOptions<T>& options) {
+	T bn = b.norm();
+	res.residual = bn == T(0) ? T(0) : (b - a * res.x).norm() / bn;
+	res.converged = res.residual <= options.tolerance;
+}
+
+} // namespace detail
+
+// preconditioned conjugate gradients, A and M must be symmetric positive definite
+template<std::floating_point T>
+SolverResult<T> cg(const std::type_identity_t<LinearOperator<T>>& a, const MathVector<T>& b,
+	const Preconditioner<T>& m = IdentityPreconditioner<T>(), const SolverOptions<T>& options = {}) {
+	size_t n = a.size();
+	assertm(b.size() == n, "Wrong sizes in cg");
+	LA_PHASE("cg");
+	SolverResult<T> res;
+	res.x = MathVector<T>(n);
+	T limit = options.tolerance * b.norm();
+	MathVector<T> r = b, z(n), p(n), ap(n);
+	m.apply(r, z);
+	p = z;
+	T rz = r * z;
+	while (r.norm() > limit && res.iterations < options.max_iterations) {
+		a.apply(p, ap);
+		++res.iterations;
+		T pap = p * ap;
+		if (pap == T(0))
+			break;
+		T alpha = rz / pap;
+		res.x.axpy(alpha, p);
+		r.axpy(-alpha, ap);
+		m.apply(r, z);
+		T rz_next = r * z;
+		T beta = rz_next / rz;
+		rz = rz_next;
+		// p = z + beta p
+		p *= beta;
+		p += z;
+	}
+	detail::finish_solve(a, b, res, options);
+	return res;
+}
+
+// stabilized biconjugate gradients, preconditioned from the right
+template<std::floating_point T>
+SolverResult<T> bicgstab(const std::type_identity_t<LinearOperator<T>>& a, const MathVector<T>& b,
+	const Preconditioner<T>& m = IdentityPreconditioner<T>(), const SolverOptions<T>& options = {}) {
+	size_t n = a.size();
+	assertm(b.size() == n, "Wrong sizes in bicgstab");
+	LA_PHASE("bicgstab");
+	SolverResult<T> res;
+	res.x = MathVector<T>(n);
+	T limit = options.tolerance * b.norm();
+	MathVector<T> r = b, r0 = b, p(n), v(n), s(n), t(n), ph(n), sh(n);
+	T rho = T(1), alpha = T(1), omega = T(1);
+	while (r.norm() > limit && res.iterations + 2 <= options.max_iterations) {
+		T rho_next = r0 * r;
+		if (rho_next == T(0))
+			break;
+		T beta = rho_next / rho * (alpha / omega);
+		rho = rho_next;
+		// p = r + beta (p - omega v)
+		p.axpy(-omega, v);
+		p *= beta;
+		p += r;
+		m.apply(p, ph);
+		a.apply(ph, v);
+		++res.iterations;
+		T r0v = r0 * v;
+		if (r0v == T(0))
+			break;
+		alpha = rho / r0v;
+		s = r;
+		s.axpy(-alpha, v);
+		res.x.axpy(alpha, ph);
+		if (s.norm() <= limit) {
+			r = s;
+			break;
+		}
+		m.apply(s, sh);
+		a.apply(sh, t);
+		++res.iterations;
+		T tt = t * t;
+		omega = tt == T(0) ? T(0) : (t * s) / tt;
+		res.x.axpy(omega, sh);
+		r = s;
+		r.axpy(-omega, t);
+		if (omega == T(0))
+			break;
+	}
+	detail::finish_solve(a, b, res, options);
+	return res;
+}
+
+// restarted GMRES(options.restart), preconditioned from the right
+template<std::floating_point T>
+SolverResult<T> gmres(const std::type_identity_t<LinearOperator<T>>& a, const MathVector<T>& b,
+	const Preconditioner<T>& m = IdentityPreconditioner<T>(), const SolverOptions<T>& options = {}) {
+	size_t n = a.size();
+	assertm(b.size() == n, "Wrong sizes in gmres");
+	LA_PHASE("gmres");
+	SolverResult<T> res;
+	res.x = MathVector<T>(n);
+	T limit = options.tolerance * b.norm();
+	size_t k_max = std::max<size_t>(std::min(options.restart, n), 1);
+
+	std::vector<MathVector<T>> v(k_max + 1, MathVector<T>(n));
+	// Hessenberg matrix of the Arnoldi process, kept triangular by Givens rotations
+	Matrix<T> h(k_max + 1, k_max);
+	std::vector<T> cs(k_max), sn(k_max), g(k_max + 1);
+	MathVector<T> w(n), z(n), r(n);
+	while (res.iterations < options.max_iterations) {
+		a.apply(res.x, r);
+		r = b - r;
+		T beta = r.norm();
+		if (beta <= limit)
+			break;
+		v[0] = r * (T(1) / beta);
+		std::fill(g.begin(), g.end(), T(0));
+		g[0] = beta;
+
+		size_t k = 0;
+		while (k < k_max && res.iterations < options.max_iterations) {
+			m.apply(v[k], z);
+			a.apply(z, w);
+			++res.iterations;
+			// modified Gram-Schmidt
+			for (size_t i = 0; i <= k; i++) {
+				h[i][k] = w * v[i];
+				w.axpy(-h[i][k], v[i]);
+			}
+			h[k + 1][k] = w.norm();
+			for (size_t i = 0; i < k; i++) {
+				T x = h[i][k], y = h[i + 1][k];
+				h[i][k] = cs[i] * x + sn[i] * y;
+				h[i + 1][k] = -sn[i] * x + cs[i] * y;
+			}
+			T d = std::hypot(h[k][k], h[k + 1][k]);
+			bool breakdown = h[k + 1][k] == T(0);
+			if (!breakdown)
+				v[k + 1] = w * (T(1) / h[k + 1][k]);
+			cs[k] = d == T(0) ? T(1) : h[k][k] / d;
+			sn[k] = d == T(0) ? T(0) : h[k + 1][k] / d;
+			h[k][k] = d;
+			h[k + 1][k] = T(0);
+			g[k + 1] = -sn[k] * g[k];
+			g[k] = cs[k] * g[k];
+			++k;
+			if (breakdown || std::abs(g[k]) <= limit)
+				break;
+		}
+
+		// x += M^-1 V y, where H y = g
+		std::vector<T> y(k);
+		for (size_t i = k; i-- > 0;) {
+			T s = g[i];
+			for (size_t j = i + 1; j < k; j++)
+				s -= h[i][j] * y[j];
+			y[i] = h[i][i] == T(0) ? T(0) : s / h[i][i];
+		}
+		w = MathVector<T>(n);
+		for (size_t i = 0; i < k; i++)
+			w.axpy(y[i], v[i]);
+		m.apply(w, z);
+		res.x += z;
+		if (std::abs(g[k]) <= limit)
+			break;
+	}
+	detail::finish_solve(a, b, res, options);
+	return res;
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "matrix.h"
+#include "elimination.h"
+#include "math_vector.h"
+#include "gemm.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "instrumentation.h"
+#include "assertm.h"
+
+// PA = LU with partial pivoting, computed once and reused for det, rank, inverse and solves.
+// Works for any n x m matrix: columns without a pivot are skipped, so U is a row echelon form
+// and rank is exact for exact types.
+// Factorization is blocked right-looking: a panel of LU_BLOCK columns is eliminated,
+// then the rest of the pivot rows is solved with L11 and the trailing matrix is
+// updated with one gemm.
+// T must be a field: integer division would truncate the multipliers
+template<class T = Rational<int>>
+requires is_field<T>::value
+class LUDecomposition {
+public:
+	static constexpr size_t LU_BLOCK = 64;
+
+	LUDecomposition(const Matrix<T>& a);
+
+	std::pair<size_t, size_t> size() const { return lu.size(); }
+	size_t rank() const { return info.rank(); }
+	bool is_invertible() const { return lu.size().first == lu.size().second && rank() == lu.size().first; }
+
+	T det() const;
+	MathVector<T> solve(const MathVector<T>& b) const;
+	Matrix<T> solve(const Matrix<T>& b) const;
+	Matrix<T> inverse() const;
+
+	// L (unit, below the pivots) and U (pivot rows) packed in one matrix
+	const Matrix<T>& factors() const { return lu; }
+	// row i of PA is row permutation()[i] of A
+	const std::vector<size_t>& permutation() const { return info.perm; }
+	// column of the i-th pivot
+	const std::vector<size_t>& pivot_columns() const { return info.pivot_cols; }
+private:
+	void factor_panel(size_t c0, size_t c1);
+	void update_trailing(size_t r0, size_t c1);
+	void solve_permuted(Matrix<T>& pb) const;
+
+	Matrix<T> lu;
+	Elimination info;
+	T tolerance = T(0);
+};
+
+template<class T>
+requires is_field<T>::value
+LUDecomposition<T>::LUDecomposition(const Matrix<T>& a) : lu(a) {
+	LA_PHASE("LUDecomposition");
+	auto [n, m] = lu.size();
+	info.reset(n, m);
+	tolerance = detail::lu_tolerance(lu.view());
+
+	for (size_t c0 = 0; c0 < m && rank() < n; c0 += LU_BLOCK) {
+		size_t c1 = std::min(m, c0 + LU_BLOCK);
+		size_t r0 = rank();
+		factor_panel(c0, c1);
+		if (rank() > r0 && c1 < m)
+			update_trailing(r0, c1);
+	}
+}
+
+// unblocked elimination restricted to columns [c0, c1), see lu_inplace
+template<class T>
+requires is_field<T>::value
+void LUDecomposition<T>::factor_panel(size_t c0, size_t c1) {
+	LA_PHASE("LUDecomposition::factor_panel");
+	detail::lu_eliminate(lu.view(), info, c0, c1, tolerance);
+}
+
+// pivot rows [r0, rank()) were found in the panel ending at column c1
+template<class T>
+requires is_field<T>::value
+void LUDecomposition<T>::update_trailing(size_t r0, size_t c1) {
+	LA_PHASE("LUDecomposition::update_trailing");
+	auto [n, m] = lu.size();
+	size_t r1 = rank(), k = r1 - r0, w = m - c1;
+
+	// U12 = L11^-1 * A12
+	for (size_t t = r0 + 1; t < r1; t++)
+		for (size_t s = r0; s < t; s++) {
+			const T& l = lu[t][info.pivot_cols[s]];
+			if (l != T(0))
+				vec_axpy(T(-l), lu[s].data() + c1, lu[t].data() + c1, w);
+		}
+
+	// A22 -= L21 * U12, L21 is gathered because skipped columns may separate its columns
+	if (r1 == n)
+		return;
+	Matrix<T> l21(n - r1, k);
+	for (size_t i = r1; i < n; i++)
+		for (size_t s = 0; s < k; s++)
+			l21[i - r1][s] = lu[i][info.pivot_cols[r0 + s]];
+	gemm<T>(l21.view(), lu.block(r0, c1, k, w), lu.block(r1, c1, n - r1, w), T(-1));
+}
+
+template<class T>
+requires is_field<T>::value
+T LUDecomposition<T>::det() const {
+	auto [n, m] = lu.size();
+	assertm(n == m, "Wrong matrix sizes in det");
+	if (rank() < n)
+		return T(0);
+	T res = T(info.sign);
+	for (size_t i = 0; i < n; i++)
+		res *= lu[i][i];
+	return res;
+}
+
+// pb := (LU)^-1 pb for pb = P b, one row operation per nonzero of L and U
+template<class T>
+requires is_field<T>::value
+void LUDecomposition<T>::solve_permuted(Matrix<T>& pb) const {
+	auto [n, k] = pb.size();
+	for (size_t i = 1; i < n; i++)
+		for (size_t j = 0; j < i; j++)
+			if (lu[i][j] != T(0))
+				vec_axpy(T(-lu[i][j]), pb[j].data(), pb[i].data(), k);
+
+	for (size_t i = n; i-- > 0;) {
+		for (size_t j = i + 1; j < n; j++)
+			if (lu[i][j] != T(0))
+				vec_axpy(T(-lu[i][j]), pb[j].data(), pb[i].data(), k);
+		T inv = T(1) / lu[i][i];
+		vec_scale(pb[i].data(), inv, pb[i].data(), k);
+	}
+}
+
+template<class T>
+requires is_field<T>::value
+Matrix<T> LUDecomposition<T>::solve(const Matrix<T>& b) const {
+	assertm(is_invertible(), "Matrix hasn't inverce");
+	assertm(b.size().first == lu.size().first, "Wrong matrix sizes in solve");
+	auto [n, k] = b.size();
+	Matrix<T> res(n, k);
+	for (size_t i = 0; i < n; i++)
+		std::copy(b[info.perm[i]].begin(), b[info.perm[i]].end(), res[i].begin());
+	solve_permuted(res);
+	return res;
+}
+
+template<class T>
+requires is_field<T>::value
+MathVector<T> LUDecomposition<T>::solve(const MathVector<T>& b) const {
+	assertm(is_invertible(), "Matrix hasn't inverce");
+	assertm(b.size() == lu.size().first, "Wrong matrix sizes in solve");
+	Matrix<T> res(b.size(), 1);
+	for (size_t i = 0; i < b.size(); i++)
+		res[i][0] = b[info.perm[i]];
+	solve_permuted(res);
+	return MathVector<T>(res.col(0).to_vector());
+}
+
+template<class T>
+requires is_field<T>::value
+Matrix<T> LUDecomposition<T>::inverse() const {
+	LA_PHASE("LUDecomposition::inverse");
+	assertm(is_invertible(), "Matrix hasn't inverce");
+	// P E is built directly instead of permuting a copy of E
+	auto [n, m] = lu.size();
+	Matrix<T> res(n, m);
+	for (size_t i = 0; i < n; i++)
+		res[i][info.perm[i]] = T(1);
+	solve_permuted(res);
+	return res;
+}
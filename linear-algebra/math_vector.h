@@ -3,68 +3,100 @@
 #include <iostream>
 #include <initializer_list>
 #include <vector>
+#include "allocator.h"
 #include "assertm.h"
+#include "instrumentation.h"
+#include "mconcepts.h"
+#include "simd.h"
 
-template<class T>
-requires conc_num<T>
+// storage comes from Alloc, see allocator.h
+template<class T, class Alloc>
+requires conc_scalar<T>
 class MathVector {
 public:
 	MathVector(size_t n = 0): a(n) {}
 	MathVector(std::initializer_list<T> l): a(l) {}
-	MathVector(std::vector<T> a): a(a) {}
+	MathVector(std::vector<T, Alloc>&& a): a(std::move(a)) {}
+	template<class A>
+	MathVector(const std::vector<T, A>& a): a(a.begin(), a.end()) {}
+	// between allocators the elements are copied
+	template<class A>
+	requires (!std::is_same_v<A, Alloc>)
+	MathVector(const MathVector<T, A>& other): a(other.begin(), other.end()) {}
 
 	size_t size() const { return a.size(); }
 
 	T& operator[](size_t i) { return a[i]; }
 	T operator[](size_t i) const { return a[i]; }
 
-	MathVector operator+(const MathVector& other) {
+	T* data() { return a.data(); }
+	const T* data() const { return a.data(); }
+
+	MathVector operator+(const MathVector& other) const {
 		assertm(size() == other.size(), "Wrong MathVector sizes in operator+");
-		MathVector res = *this;
-		for (size_t i = 0; i < size(); i++)
-			res[i] = res[i] + other[i];
+		LA_PHASE("MathVector::operator+");
+		MathVector res(size());
+		vec_add(data(), other.data(), res.data(), size());
 		return res;
 	}
 
-	MathVector operator-(const MathVector& other) {
+	MathVector operator-(const MathVector& other) const {
 		assertm(size() == other.size(), "Wrong MathVector sizes in operator-");
-		MathVector res = *this;
-		for (size_t i = 0; i < size(); i++)
-			res[i] = res[i] - other[i];
+		LA_PHASE("MathVector::operator-");
+		MathVector res(size());
+		vec_sub(data(), other.data(), res.data(), size());
 		return res;
 	}
 
-	MathVector operator*(const T& coef) {
-		MathVector res = *this;
-		for (size_t i = 0; i < size(); i++)
-			res = res * coef;
+	MathVector operator*(const T& coef) const {
+		LA_PHASE("MathVector::operator*");
+		MathVector res(size());
+		vec_scale(data(), coef, res.data(), size());
 		return res;
 	}
 
-	T operator*(const MathVector& other) {
+	T operator*(const MathVector& other) const {
 		assertm(size() == other.size(), "Wrong MathVector sizes in operaor*");
-		T res = T(0);
-		for (size_t i = 0; i < size(); i++)
-			res = res + a[i] * other[i];
-		return res;
+		return vec_dot(data(), other.data(), size());
 	}
 
-	MathVector operator-() {
+	MathVector operator-() const {
+		LA_PHASE("MathVector::negate");
 		MathVector res(size());
 		for (size_t i = 0; i < size(); i++)
 			res[i] = -a[i];
 		return res;
 	}
 
+	// this += alpha * x
+	MathVector& axpy(const T& alpha, const MathVector& x) {
+		assertm(size() == x.size(), "Wrong MathVector sizes in axpy");
+		vec_axpy(alpha, x.data(), data(), size());
+		return *this;
+	}
+
+	T norm() const requires std::floating_point<T> { return vec_norm(data(), size()); }
+
 	friend MathVector operator*(const T& coef, const MathVector& other) { return other * coef; }
-	MathVector& operator+=(const MathVector& other) { return *this = *this + other; }
-	MathVector& operator-=(const MathVector& other) { return *this = *this + other; }
-	MathVector& operator*=(const T &coef) { return *this = *this + coef; }
+	MathVector& operator+=(const MathVector& other) {
+		assertm(size() == other.size(), "Wrong MathVector sizes in operator+=");
+		vec_add(data(), other.data(), data(), size());
+		return *this;
+	}
+	MathVector& operator-=(const MathVector& other) {
+		assertm(size() == other.size(), "Wrong MathVector sizes in operator-=");
+		vec_sub(data(), other.data(), data(), size());
+		return *this;
+	}
+	MathVector& operator*=(const T &coef) {
+		vec_scale(data(), coef, data(), size());
+		return *this;
+	}
 	
-	typename std::vector<T>::iterator begin() { return a.begin(); }
-	typename std::vector<T>::iterator end() { return a.end(); }
-	typename std::vector<T>::const_iterator begin() const { return a.begin(); }
-	typename std::vector<T>::const_iterator end() const { return a.end(); }
+	typename std::vector<T, Alloc>::iterator begin() { return a.begin(); }
+	typename std::vector<T, Alloc>::iterator end() { return a.end(); }
+	typename std::vector<T, Alloc>::const_iterator begin() const { return a.begin(); }
+	typename std::vector<T, Alloc>::const_iterator end() const { return a.end(); }
 
 	friend std::istream& operator>>(std::istream& in, MathVector& v) {
 		for (auto& x : v)
@@ -80,5 +112,5 @@ public:
 	}
 
 private:
-	std::vector<T> a;
+	std::vector<T, Alloc> a;
 };
@@ -7,21 +7,43 @@
 #include <numeric>
 #include <vector>
 
+#include "allocator.h"
+#include "elimination.h"
+#include "gemm.h"
 #include "permutation.h"
 #include "polynomial.h"
+#include "simd.h"
+#include "thread_pool.h"
 #include "rational.h"
 #include "math_vector.h"
+#include "matrix_expr.h"
+#include "matrix_view.h"
+#include "instrumentation.h"
 #include "assertm.h"
 
 // TO-DO list:
 // make beauty print
-// add fast characterestyc poly
 
-template<class T> class ContainerMathVectors;
+template<class T>
+requires conc_scalar<T>
+class ContainerMathVectors;
+
+template<class T>
+Matrix<T> get_e_matrix(std::pair<size_t, size_t> sz);
+template<class T>
+Matrix<T> get_e_matrix(size_t n, size_t m);
 
-template<class T = Rational<int>>
-class Matrix {
+// Matrix is stored row-major in one contiguous buffer, element (i, j) is a[i * m + j].
+// operator[] returns a view of a row, so a[i][j] works as before.
+// +, -, * of matrices build expressions (matrix_expr.h) evaluated on assignment.
+// The buffer comes from Alloc, see allocator.h; the algorithms work on Matrix<T> with the
+// default allocator, other matrices convert to it by copying.
+template<class T, class Alloc>
+class Matrix : public MatrixExpr<Matrix<T, Alloc>> {
 public:
+	using value_type = T;
+	using allocator_type = Alloc;
+
 	// constructions 
 	Matrix();
 	Matrix(size_t n, size_t m);
@@ -29,54 +51,66 @@ public:
 	Matrix(const std::vector<std::vector<T>>& a);
 	Matrix(const std::initializer_list<std::vector<T>>& l);
 	Matrix(const ContainerMathVectors<T>& v);
-	Matrix(const Matrix<T>& other);
+	Matrix(const Matrix& other);
+	template<class A>
+	requires (!std::is_same_v<A, Alloc>)
+	Matrix(const Matrix<T, A>& other);
+	explicit Matrix(MatrixView<const T> v);
+	template<class E>
+	Matrix(const MatrixExpr<E>& e);
 
 	Matrix(Matrix&& other) noexcept;
 
 	// base operations
-	Matrix operator=(Matrix&& other);
+	Matrix& operator=(const Matrix& other);
+	Matrix& operator=(Matrix&& other) noexcept;
+	template<class E>
+	Matrix& operator=(const MatrixExpr<E>& e);
 
 	void resize(size_t n, size_t m);
 	void resize(std::pair<size_t, size_t> sz);
 
-	std::vector<T>& operator[](size_t i);
-	const std::vector<T>& operator[](size_t i) const;
+	VectorView<T> operator[](size_t i);
+	VectorView<const T> operator[](size_t i) const;
 
 	std::pair<size_t, size_t> size() const;
 
+	// views, no copying
+	T* data();
+	const T* data() const;
+	size_t ld() const;
+
+	MatrixView<T> view();
+	MatrixView<const T> view() const;
+	operator MatrixView<T>();
+	operator MatrixView<const T>() const;
+
+	VectorView<T> row(size_t i);
+	VectorView<const T> row(size_t i) const;
+	VectorView<T> col(size_t j);
+	VectorView<const T> col(size_t j) const;
+	MatrixView<T> block(size_t i, size_t j, size_t rows, size_t cols);
+	MatrixView<const T> block(size_t i, size_t j, size_t rows, size_t cols) const;
+
 	// pro base operations
 	Matrix operator|(const Matrix& other) const;
 	Matrix transpose() const;
 
 	// math operations
-
-	Matrix operator+(const Matrix& other) const;
-	Matrix operator-(const Matrix& other) const;
-	Matrix operator*(const Matrix& other) const;
-	Matrix operator*(const T coef) const;
-	Matrix operator-();
+	// A + B, A - B, A * B, -A, A * coef are expressions, see matrix_expr.h
 
 	Matrix operator+(const T& coef) const;
 	Matrix operator-(const T& coef) const;
 
-	template<class T>
-	friend Matrix operator+(const T& coef, const Matrix<T>& other);
-	template<class T>
-	friend Matrix operator-(const T& coef, const Matrix<T>& other);
-	template<class T>
-	friend Matrix operator*(const T& coef, const Matrix<T>& other);
-	
-	Matrix& operator+=(const Matrix& other);
-	Matrix& operator-=(const Matrix& other);
+	template<class E>
+	Matrix& operator+=(const MatrixExpr<E>& e);
+	template<class E>
+	Matrix& operator-=(const MatrixExpr<E>& e);
 	Matrix& operator*=(const Matrix& other);
 	Matrix& operator+=(const T& coef);
 	Matrix& operator-=(const T& coef);
 	Matrix& operator*=(const T& coef);
 
-	// equality operations
-	bool operator==(const Matrix& other) const;
-	bool operator!=(const Matrix& other) const;
-
 	// pro-math operations
 	Matrix to_stepped_view() const;
 	Matrix to_improved_stepped_view() const;
@@ -86,9 +120,11 @@ public:
 
 	T det() const;
 	T det_slow() const;
+	size_t rank() const;
 
 	ContainerMathVectors<T> fse() const;
 
+	Polynomial<T> char_poly() const;
 	Polynomial<T> char_poly_slow() const;
 
 	// matrix is a leaner operator
@@ -98,298 +134,319 @@ public:
 	// read and write
 	//friend std::istream& operator>>(std::istream& in, Matrix<T>& a);
 	//friend std::ostream& operator<<(std::ostream& out, const Matrix<T>& a);
-
-	// matrix E
-	template<class T>
-	friend Matrix<T> get_e_matrix(std::pair<size_t, size_t> sz);
-	template<class T>
-	friend Matrix<T> get_e_matrix(size_t n, size_t m);
-
-	// binary pow
-	template<class T>
-	friend Matrix pow(Matrix a, size_t deg);
 private:
-	std::vector<std::vector<T>> a;
+	std::vector<T, Alloc> a;
+	size_t n = 0, m = 0;
 };
 
 #include "container_math_vectors.h"
-
-template<class T>
-class ContainerMathVectors;
+#include "lu.h"
+#include "bareiss.h"
+#include "char_poly.h"
+#include "multimod.h"
+#include "matrix_poly.h"
+#include "matrix_pow.h"
 
 //constructions 
-template<class T>
-Matrix<T>::Matrix() {}
+template<class T, class Alloc>
+Matrix<T, Alloc>::Matrix() {}
 
-template<class T>
-Matrix<T>::Matrix(size_t n, size_t m) : a(n, vector<T>(m)) {}
+template<class T, class Alloc>
+Matrix<T, Alloc>::Matrix(size_t n, size_t m) : a(n * m), n(n), m(m) {}
 
-template<class T>
-Matrix<T>::Matrix(std::pair<size_t, size_t> sz) : a(sz.first, vector<T>(sz.second)) {}
+template<class T, class Alloc>
+Matrix<T, Alloc>::Matrix(std::pair<size_t, size_t> sz) : Matrix(sz.first, sz.second) {}
 
-template<class T>
-Matrix<T>::Matrix(const std::vector<std::vector<T>>& a) : a(a) {}
+template<class T, class Alloc>
+Matrix<T, Alloc>::Matrix(const std::vector<std::vector<T>>& rows) : Matrix(rows.size(), rows.empty() ? 0 : rows[0].size()) {
+	for (size_t i = 0; i < n; i++) {
+		assertm(rows[i].size() == m, "Rows of different lengths in Matrix constructor");
+		std::copy(rows[i].begin(), rows[i].end(), a.begin() + i * m);
+	}
+}
 
-template<class T>
-Matrix<T>::Matrix(const std::initializer_list<std::vector<T>>& l) : a(l) {}
+template<class T, class Alloc>
+Matrix<T, Alloc>::Matrix(const std::initializer_list<std::vector<T>>& l) : Matrix(std::vector<std::vector<T>>(l)) {}
 
-template<class T>
-Matrix<T>::Matrix(const ContainerMathVectors<T>& v) {
+template<class T, class Alloc>
+Matrix<T, Alloc>::Matrix(const ContainerMathVectors<T>& v) {
 	auto [m, n] = v.size();
 	resize(n, m);
 	for (size_t i = 0; i < n; i++)
 		for (size_t j = 0; j < m; j++)
-			a[i][j] = v[j][i];
+			(*this)[i][j] = v[j][i];
 }
 
-template<class T>
-Matrix<T>::Matrix(Matrix&& other) noexcept { a.swap(other.a), other.a.clear(); }
+template<class T, class Alloc>
+Matrix<T, Alloc>::Matrix(Matrix&& other) noexcept : a(std::move(other.a)), n(other.n), m(other.m) {
+	other.a.clear();
+	other.n = other.m = 0;
+}
 
-template<class T>
-Matrix<T>::Matrix(const Matrix<T>& other) : a(other.a) {}
+template<class T, class Alloc>
+Matrix<T, Alloc>::Matrix(const Matrix<T, Alloc>& other) : a(other.a), n(other.n), m(other.m) {}
+
+template<class T, class Alloc>
+template<class A>
+requires (!std::is_same_v<A, Alloc>)
+Matrix<T, Alloc>::Matrix(const Matrix<T, A>& other) : a(other.data(), other.data() + other.size().first * other.size().second),
+	n(other.size().first), m(other.size().second) {}
+
+template<class T, class Alloc>
+Matrix<T, Alloc>::Matrix(MatrixView<const T> v) : Matrix(v.size()) { copy_view(v, view()); }
+
+template<class T, class Alloc>
+template<class E>
+Matrix<T, Alloc>::Matrix(const MatrixExpr<E>& e) { detail::expr_eval_to(e.self(), *this); }
 
 //base operators
 
-template<class T>
-Matrix<T> Matrix<T>::operator=(Matrix&& other) {
-	a.swap(other.a);
+template<class T, class Alloc>
+Matrix<T, Alloc>& Matrix<T, Alloc>::operator=(const Matrix& other) {
+	a = other.a;
+	n = other.n, m = other.m;
+	return *this;
+}
+
+template<class T, class Alloc>
+Matrix<T, Alloc>& Matrix<T, Alloc>::operator=(Matrix&& other) noexcept {
+	// steals the buffer when both use the same memory, copies otherwise
+	a = std::move(other.a);
+	n = other.n, m = other.m;
 	other.a.clear();
+	other.n = other.m = 0;
+	return *this;
 }
 
-template<class T>
-void Matrix<T>::resize(size_t n, size_t m) {
-	a.resize(n);
-	for (size_t i = 0; i < n; i++)
-		a[i].resize(m);
+template<class T, class Alloc>
+template<class E>
+Matrix<T, Alloc>& Matrix<T, Alloc>::operator=(const MatrixExpr<E>& e) {
+	// products must not write into a matrix they read, and a reshaped *this loses its old elements
+	bool refers = detail::expr_refers_to(e.self(), this);
+	if (refers && (!detail::expr_elementwise<E> || size() != e.self().size()))
+		return *this = Matrix(e);
+	detail::expr_eval_to(e.self(), *this);
+	return *this;
 }
 
-template<class T>
-void Matrix<T>::resize(std::pair<size_t, size_t> sz) { resize(sz.first, sz.second); }
+template<class T, class Alloc>
+void Matrix<T, Alloc>::resize(size_t n1, size_t m1) {
+	if (m1 == m) {
+		a.resize(n1 * m1);
+	} else {
+		std::vector<T, Alloc> b(n1 * m1, a.get_allocator());
+		for (size_t i = 0; i < n && i < n1; i++)
+			std::copy(a.begin() + i * m, a.begin() + i * m + std::min(m, m1), b.begin() + i * m1);
+		a.swap(b);
+	}
+	n = n1, m = m1;
+}
 
-template<class T>
-std::vector<T>& Matrix<T>::operator[](size_t i) { return a[i]; }
+template<class T, class Alloc>
+void Matrix<T, Alloc>::resize(std::pair<size_t, size_t> sz) { resize(sz.first, sz.second); }
 
-template<class T>
-const std::vector<T>& Matrix<T>::operator[](size_t i) const { return a[i]; }
+template<class T, class Alloc>
+VectorView<T> Matrix<T, Alloc>::operator[](size_t i) { return row(i); }
 
-template<class T>
-std::pair<size_t, size_t> Matrix<T>::size() const {
-	return { a.size(), a[0].size() };
+template<class T, class Alloc>
+VectorView<const T> Matrix<T, Alloc>::operator[](size_t i) const { return row(i); }
+
+template<class T, class Alloc>
+std::pair<size_t, size_t> Matrix<T, Alloc>::size() const {
+	return { n, m };
 }
 
+// views
+template<class T, class Alloc>
+T* Matrix<T, Alloc>::data() { return a.data(); }
+template<class T, class Alloc>
+const T* Matrix<T, Alloc>::data() const { return a.data(); }
+template<class T, class Alloc>
+size_t Matrix<T, Alloc>::ld() const { return m; }
+
+template<class T, class Alloc>
+MatrixView<T> Matrix<T, Alloc>::view() { return { a.data(), n, m }; }
+template<class T, class Alloc>
+MatrixView<const T> Matrix<T, Alloc>::view() const { return { a.data(), n, m }; }
+template<class T, class Alloc>
+Matrix<T, Alloc>::operator MatrixView<T>() { return view(); }
+template<class T, class Alloc>
+Matrix<T, Alloc>::operator MatrixView<const T>() const { return view(); }
+
+template<class T, class Alloc>
+VectorView<T> Matrix<T, Alloc>::row(size_t i) { return { a.data() + i * m, m }; }
+template<class T, class Alloc>
+VectorView<const T> Matrix<T, Alloc>::row(size_t i) const { return { a.data() + i * m, m }; }
+template<class T, class Alloc>
+VectorView<T> Matrix<T, Alloc>::col(size_t j) { return view().col(j); }
+template<class T, class Alloc>
+VectorView<const T> Matrix<T, Alloc>::col(size_t j) const { return view().col(j); }
+template<class T, class Alloc>
+MatrixView<T> Matrix<T, Alloc>::block(size_t i, size_t j, size_t rows, size_t cols) { return view().block(i, j, rows, cols); }
+template<class T, class Alloc>
+MatrixView<const T> Matrix<T, Alloc>::block(size_t i, size_t j, size_t rows, size_t cols) const { return view().block(i, j, rows, cols); }
+
 // pro base operations
-template<class T>
-Matrix<T> Matrix<T>::operator|(const Matrix& other) const {
+template<class T, class Alloc>
+Matrix<T, Alloc> Matrix<T, Alloc>::operator|(const Matrix& other) const {
 	auto [n, m] = size();
 	auto [n1, k] = other.size();
 	assertm(n == n1, "Wrong matrix sizes in operator|");
 
 	Matrix res(n, m + k);
-	for (size_t i = 0; i < n; i++)
-		for (size_t j = 0; j < m; j++)
-			res[i][j] = a[i][j];
-	for (size_t i = 0; i < n; i++)
-		for (size_t j = 0; j < k; j++)
-			res[i][j + m] = other[i][j];
-
+	copy_view(view(), res.block(0, 0, n, m));
+	copy_view(other.view(), res.block(0, m, n, k));
 	return res;
 }
 
-template<class T>
-Matrix<T> Matrix<T>::transpose() const {
+template<class T, class Alloc>
+Matrix<T, Alloc> Matrix<T, Alloc>::transpose() const {
 	auto [n, m] = size();
-	Matrix<T> res(m, n);
-	for (size_t i = 0; i < n; i++)
-		for (size_t j = 0; j < m; j++)
-			res[j][i] = a[i][j];
+	Matrix res(m, n);
+	transpose_view(view(), res.view());
 	return res;
 }
 
 // math operations
-template<class T>
-Matrix<T> Matrix<T>::operator+(const Matrix& other) const {
-	auto [n, m] = size();
-	auto [n1, m1] = other.size();
-	assertm(n == n1 && m == m1, "Wrong matrix sizes in operator+");
-
-	Matrix res = a;
-	for (size_t i = 0; i < n; i++)
-		for (size_t j = 0; j < m; j++)
-			res[i][j] += other[i][j];
-	return res;
+template<class T, class Alloc>
+Matrix<T, Alloc> Matrix<T, Alloc>::operator+(const T& coef) const { return Matrix(*this) += coef; }
+template<class T, class Alloc>
+Matrix<T, Alloc> Matrix<T, Alloc>::operator-(const T& coef) const { return Matrix(*this) -= coef; }
+
+template<class T, class Alloc>
+Matrix<T, Alloc> operator+(const T& coef, const Matrix<T, Alloc>& other) { return other + coef; }
+template<class T, class Alloc>
+Matrix<T, Alloc> operator-(const T& coef, const Matrix<T, Alloc>& other) { return Matrix<T, Alloc>(-other) + coef; }
+
+// compound operators work in place
+template<class T, class Alloc>
+template<class E>
+Matrix<T, Alloc>& Matrix<T, Alloc>::operator+=(const MatrixExpr<E>& e) {
+	assertm(size() == e.self().size(), "Wrong matrix sizes in operator+=");
+	if (!detail::expr_elementwise<E> && detail::expr_refers_to(e.self(), this))
+		return *this += Matrix(e);
+	detail::expr_accumulate_to(e.self(), *this, T(1));
+	return *this;
 }
 
-template<class T>
-Matrix<T> Matrix<T>::operator-(const Matrix& other) const {
-	auto [n, m] = size();
-	auto [n1, m1] = other.size();
-	assertm(n == n1 && m == m1, "Wrong matrix sizes in operator-");
-
-	Matrix res = a;
-	for (size_t i = 0; i < n; i++)
-		for (size_t j = 0; j < m; j++)
-			res[i][j] -= other[i][j];
-	return res;
+template<class T, class Alloc>
+template<class E>
+Matrix<T, Alloc>& Matrix<T, Alloc>::operator-=(const MatrixExpr<E>& e) {
+	assertm(size() == e.self().size(), "Wrong matrix sizes in operator-=");
+	if (!detail::expr_elementwise<E> && detail::expr_refers_to(e.self(), this))
+		return *this -= Matrix(e);
+	detail::expr_accumulate_to(e.self(), *this, T(-1));
+	return *this;
 }
 
-template<class T>
-Matrix<T> Matrix<T>::operator*(const Matrix& other) const {
-	auto [n, k] = size();
-	auto [k1, m] = other.size();
-	assertm(k == k1, "Wrong matrix sizes in operaor*");
-
-	Matrix res(n, m);
-	for (size_t i = 0; i < n; i++)
-		for (size_t j = 0; j < m; j++)
-			for (size_t t = 0; t < k; t++)
-				res[i][j] += a[i][t] * other[t][j];
-
-	return res;
+template<class T, class Alloc>
+Matrix<T, Alloc>& Matrix<T, Alloc>::operator*=(const Matrix& other) {
+	auto [n1, k] = other.size();
+	assertm(m == n1, "Wrong matrix sizes in operator*=");
+	// the product is built in a buffer of the same allocator, so an arena matrix stays in
+	// its arena, and trades places with *this; MatrixPowWorkspace reuses two buffers instead
+	std::vector<T, Alloc> res(n * k, T(0), a.get_allocator());
+	gemm<T>(view(), other.view(), MatrixView<T>(res.data(), n, k));
+	a.swap(res);
+	m = k;
+	return *this;
 }
 
-template<class T>
-Matrix<T> Matrix<T>::operator*(const T coef) const {
-	auto [n, m] = size();
-	Matrix res = *this;
-	for (size_t i = 0; i < n; i++)
-		for (size_t j = 0; j < m; j++)
-			res[i] *= coef;
-	return res;
+template<class T, class Alloc>
+Matrix<T, Alloc>& Matrix<T, Alloc>::operator+=(const T& coef) {
+	for (size_t i = 0; i < n && i < m; i++)
+		a[i * m + i] += coef;
+	return *this;
 }
 
-template<class T>
-Matrix<T> Matrix<T>::operator-() {
-	auto [n, m] = size();
-	Matrix res(n, m);
-	for (size_t i = 0; i < n; i++)
-		for (size_t j = 0; j < m; j++)
-			res[i][j] = -a[i][j];
-	return res;
+template<class T, class Alloc>
+Matrix<T, Alloc>& Matrix<T, Alloc>::operator-=(const T& coef) {
+	for (size_t i = 0; i < n && i < m; i++)
+		a[i * m + i] -= coef;
+	return *this;
 }
 
-template<class T>
-Matrix<T> Matrix<T>::operator+(const T& coef) const { return *this + coef * get_e_matrix(size()); }
-template<class T>
-Matrix<T> Matrix<T>::operator-(const T& coef) const { return *this - coef * get_e_matrix(size()); }
-
-template<class T>
-Matrix<T> operator+(const T& coef, const Matrix<T>& other) { return other + coef; }
-template<class T>
-Matrix<T> operator-(const T& coef, const Matrix<T>& other) { return -other + coef; }
-template<class T>
-Matrix<T> operator*(const T& coef, const Matrix<T>& other) { return other * coef; }
-
-template<class T>
-Matrix<T>& Matrix<T>::operator+=(const Matrix& other) { return *this = *this + other; }
-template<class T>
-Matrix<T>& Matrix<T>::operator-=(const Matrix& other) { return *this = *this - other; }
-template<class T>
-Matrix<T>& Matrix<T>::operator*=(const Matrix& other) { return *this = *this * other; }
-template<class T>
-Matrix<T>& Matrix<T>::operator+=(const T& coef) { return *this = *this + coef; }
-template<class T>
-Matrix<T>& Matrix<T>::operator-=(const T& coef) { return *this = *this - coef; }
-template<class T>
-Matrix<T>& Matrix<T>::operator*=(const T& coef) { return *this = *this * coef; }
-
-// equality operations
-template<class T>
-bool Matrix<T>::operator==(const Matrix& other) const { return a == other.a; }
-template<class T>
-bool Matrix<T>::operator!=(const Matrix& other) const { return a != other.a; }
+template<class T, class Alloc>
+Matrix<T, Alloc>& Matrix<T, Alloc>::operator*=(const T& coef) {
+	vec_scale(data(), coef, data(), n * m);
+	return *this;
+}
 
-template<class T>
-Matrix<T> Matrix<T>::to_stepped_view() const {
-	auto [n, m] = size();
+template<class T, class Alloc>
+Matrix<T, Alloc> Matrix<T, Alloc>::to_stepped_view() const {
+	LA_PHASE("Matrix::to_stepped_view");
 	Matrix res = *this;
-	for (size_t i = 0; i < n; i++) {
-		for (size_t j = i; j < n; j++)
-			if (res[j][i] != 0 && (res[i][i] == 0 || abs(res[j][i]) < abs(res[i][i])))
-				res[j].swap(res[i]);
-
-		if (res[i][i] == 0)
-			continue;
-		if (res[i][i] < 0)
-			for (size_t j = i; j < m; j++)
-				res[i][j] *= -1;
-
-		for (size_t j = i + 1; j < n; j++) {
-			T coef = -res[j][i] / res[i][i];
-			for (size_t k = i; k < m; k++)
-				res[j][k] += coef * res[i][k];
-		}
-	}
+	to_stepped_view_inplace(res.view());
 	return res;
 }
 
-template<class T>
-Matrix<T> Matrix<T>::to_improved_stepped_view() const {
-	auto [n, m] = size();
-	Matrix res = this->to_stepped_view();
-	for (int i = (int)n - 1; i >= 0; i--) {
-		T coef = res[i][i];
-		if (coef == 0)
-			continue;
-		for (size_t j = i; j < m; j++)
-			res[i][j] /= coef;
-
-		for (size_t j = 0; j < (size_t)i; j++) {
-			coef = -res[j][i];
-			for (size_t k = i; k < m; k++)
-				res[j][k] += coef * res[i][k];
-		}
-	}
+template<class T, class Alloc>
+Matrix<T, Alloc> Matrix<T, Alloc>::to_improved_stepped_view() const {
+	LA_PHASE("Matrix::to_improved_stepped_view");
+	Matrix res = *this;
+	to_improved_stepped_view_inplace(res.view());
 	return res;
 }
 
-template<class T>
-Matrix<T> Matrix<T>::inverce() const {
+template<class T, class Alloc>
+Matrix<T, Alloc> Matrix<T, Alloc>::inverce() const {
 	auto [n, m] = size();
 	assertm(n == m, "Wrong matrix sizes in inverce");
-	auto tmp = *this | get_e_matrix(n, m);
-	tmp = tmp.to_improved_stepped_view();
-	for (size_t i = 0; i < n; i++)
-		assertm(tmp[i][i] == 1, "Matrix hasn't inverce");
-	Matrix res(n, n);
-	for (size_t i = 0; i < n; i++)
-		for (size_t j = 0; j < n; j++)
-			res[i][j] = tmp[i][j + n];
-	return res;
+	LA_PHASE("Matrix::inverce");
+	return LUDecomposition<T>(*this).inverse();
 }
 
-template <class T>
-T Matrix<T>::det() const {
+template<class T, class Alloc>
+T Matrix<T, Alloc>::det() const {
 	auto [n, m] = size();
 	assertm(n == m, "Wrong matrix sizes in det");
-	Matrix stepped = to_stepped_view();
-	T res = 1;
-	for (size_t i = 0; i < n; i++)
-		res *= stepped[i][i];
-	return res;
+	LA_PHASE("Matrix::det");
+	if constexpr (conc_bareiss<T>)
+		return n < MULTIMOD_DET_CUTOFF ? detail::bareiss_det(*this) : det_multimodular(*this);
+	else
+		return LUDecomposition<T>(*this).det();
 }
 
-template <class T>
-bool Matrix<T>::have_inverce() const {
-	return det() != 0;
+template<class T, class Alloc>
+size_t Matrix<T, Alloc>::rank() const {
+	LA_PHASE("Matrix::rank");
+	if constexpr (conc_bareiss<T>)
+		return detail::bareiss_rank(*this);
+	else
+		return LUDecomposition<T>(*this).rank();
 }
 
-template <class T>
-T Matrix<T>::det_slow() const {
+template<class T, class Alloc>
+bool Matrix<T, Alloc>::have_inverce() const {
+	LA_PHASE("Matrix::have_inverce");
+	auto [n, m] = size();
+	if constexpr (conc_bareiss<T>)
+		return n == m && detail::bareiss_rank(*this) == n;
+	else
+		return LUDecomposition<T>(*this).is_invertible();
+}
+
+template<class T, class Alloc>
+T Matrix<T, Alloc>::det_slow() const {
 	auto [n, m] = size();
 	assertm(n == m, "Wrong matrix sizes in det_slow");
+	LA_PHASE("Matrix::det_slow");
 	T res = T(0);
 	Permutation perm(n);
 	do {
 		T cur = T(perm.sign());
 		for (size_t i = 0; i < n; i++)
-			cur *= a[i][perm[i] - 1];
+			cur *= a[i * m + perm[i] - 1];
 		res += cur;
 	} while (perm.next());
 	return res;
 }
 
-template<class T>
-ContainerMathVectors<T> Matrix<T>::fse() const {
+template<class T, class Alloc>
+ContainerMathVectors<T> Matrix<T, Alloc>::fse() const {
+	LA_PHASE("Matrix::fse");
+	if constexpr (conc_bareiss<T>)
+		return detail::bareiss_kernel(*this);
 	auto sv = this->to_improved_stepped_view();
 	auto [n, m] = size();
 	std::vector<bool> is_main(m, false);
@@ -422,53 +479,65 @@ ContainerMathVectors<T> Matrix<T>::fse() const {
 	return res;
 }
 
-template<class T>
-Polynomial<T> Matrix<T>::char_poly_slow() const {
+template<class T, class Alloc>
+Polynomial<T> Matrix<T, Alloc>::char_poly() const {
+	assertm(n == m, "Wrong matrix sizes in char_poly");
+	LA_PHASE("Matrix::char_poly");
+	if constexpr (char_poly_hessenberg<T>)
+		return detail::char_poly_hessenberg(*this);
+	else if constexpr (conc_bareiss<T>)
+		return detail::char_poly_exact(*this);
+	else
+		return detail::char_poly_berkowitz(*this);
+}
+
+template<class T, class Alloc>
+Polynomial<T> Matrix<T, Alloc>::char_poly_slow() const {
 	auto [n, m] = size();
-	Matrix<Polynomial<Rational<int>>> tmp(n, m);
+	assertm(n == m, "Wrong matrix sizes in char_poly_slow");
+	LA_PHASE("Matrix::char_poly_slow");
+	// det(xE - A) by definition, entries of xE - A are kept in a flat buffer
+	std::vector<Polynomial<T>> tmp(n * m);
 	for (size_t i = 0; i < n; i++) {
-		tmp[i][i] = Polynomial<Rational<int>>({ 0, 1 });
 		for (size_t j = 0; j < m; j++)
-			tmp[i][j] -= -a[i][j];
+			tmp[i * m + j] = Polynomial<T>(-a[i * m + j]);
+		tmp[i * m + i] += Polynomial<T>({ T(0), T(1) });
 	}
-	return tmp.det_slow();
+	Polynomial<T> res(T(0));
+	Permutation perm(n);
+	do {
+		Polynomial<T> cur(T(perm.sign()));
+		for (size_t i = 0; i < n; i++)
+			cur *= tmp[i * m + perm[i] - 1];
+		res += cur;
+	} while (perm.next());
+	return res;
 }
 
 // matrix is a leaner operator
-template<class T>
-ContainerMathVectors<T> Matrix<T>::Im() const {
-	auto [n, m] = size();
-	Matrix add(m, 1);
-	for (size_t i = 0; i < m; i++)
-		add[i][0] = i;
-	auto tr = this->transpose();
-	auto tmp = tr | add;
+template<class T, class Alloc>
+ContainerMathVectors<T> Matrix<T, Alloc>::Im() const {
+	LA_PHASE("Matrix::Im");
+	// columns of the matrix at the pivot columns of its echelon form
+	std::vector<size_t> cols;
+	if constexpr (conc_bareiss<T>)
+		cols = detail::bareiss_pivot_columns(*this);
+	else
+		cols = LUDecomposition<T>(*this).pivot_columns();
 	ContainerMathVectors<T> res;
-	for (size_t i = 0; i < m; i++) {
-		for (size_t j = i; j < m; j++)
-			if (tmp[j][i] != 0 && (tmp[i][i] == 0 || abs(tmp[j][i]) < abs(tmp[i][i])))
-				tmp[j].swap(tmp[i]);
-
-		if (tmp[i][i] == 0)
-			continue;
-		for (size_t j = i + 1; j < m; j++) {
-			T coef = -tmp[j][i] / tmp[i][i];
-			for (size_t k = i; k < n; k++)
-				tmp[j][k] += coef * tmp[i][k];
-		}
-		res.push_back(tr[i]);
-	}
+	for (size_t j : cols)
+		res.push_back(MathVector<T>(col(j).to_vector()));
 	return res;
 }
 
-template<class T>
-ContainerMathVectors<T> Matrix<T>::Ker() const {
+template<class T, class Alloc>
+ContainerMathVectors<T> Matrix<T, Alloc>::Ker() const {
 	return this->fse();
 }
 
 //read and write
-template<class T>
-std::istream& operator>>(std::istream& in, Matrix<T>& a) {
+template<class T, class Alloc>
+std::istream& operator>>(std::istream& in, Matrix<T, Alloc>& a) {
 	auto [n, m] = a.size();
 	for (size_t i = 0; i < n; i++)
 		for (size_t j = 0; j < m; j++)
@@ -476,8 +545,8 @@ std::istream& operator>>(std::istream& in, Matrix<T>& a) {
 	return in;
 }
 
-template<class T>
-std::ostream& operator<<(std::ostream& out, const Matrix<T>& a) {
+template<class T, class Alloc>
+std::ostream& operator<<(std::ostream& out, const Matrix<T, Alloc>& a) {
 	auto [n, m] = a.size();
 	for (size_t i = 0; i < n; i++) {
 		for (size_t j = 0; j < m; j++)
@@ -490,7 +559,7 @@ std::ostream& operator<<(std::ostream& out, const Matrix<T>& a) {
 // E
 template<class T>
 Matrix<T> get_e_matrix(size_t n, size_t m) {
-	Matrix res(n, m);
+	Matrix<T> res(n, m);
 	for (size_t i = 0; i < n && i < m; i++)
 		res[i][i] = 1;
 	return res;
@@ -498,21 +567,7 @@ Matrix<T> get_e_matrix(size_t n, size_t m) {
 
 template<class T>
 Matrix<T> get_e_matrix(std::pair<size_t, size_t> sz) {
-	return Matrix<T>::get_e_matrix(sz.first, sz.second);
-}
-
-template<class T>
-Matrix<T> pow(Matrix<T> a, size_t deg) {
-	auto [n, m] = a.size();
-	assertm(n == m, "Wrong matrix sizes in pow");
-	Matrix res = get_e_matrix(n, m);
-	while (deg) {
-		res *= res;
-		if (deg & 1)
-			res *= a;
-		deg >>= 1;
-	}
-	return res;
+	return get_e_matrix<T>(sz.first, sz.second);
 }
 
 template <class T> 
@@ -0,0 +1,365 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <type_traits>
+#include <utility>
+
+#include "allocator.h"
+#include "gemm.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "instrumentation.h"
+#include "assertm.h"
+
+// Expression templates for Matrix arithmetic.
+// A + B - C * 2 builds a tree of lightweight nodes, and nothing is computed until the tree
+// is assigned to a Matrix. Elementwise parts are evaluated in one fused pass, products
+// go to gemm, which accumulates straight into the destination.
+// Nodes keep references to Matrix operands, so do not store them in auto variables
+// that outlive the operands, assign them to a Matrix instead.
+
+template<class E>
+class MatrixExpr {
+public:
+	const E& self() const { return static_cast<const E&>(*this); }
+};
+
+template<class E> struct is_matrix : std::false_type {};
+template<class T, class A> struct is_matrix<Matrix<T, A>> : std::true_type {};
+
+namespace detail {
+
+// Matrix leaves are held by reference, intermediate nodes by value
+template<class E>
+using expr_operand = std::conditional_t<is_matrix<E>::value, const E&, const E>;
+
+template<class E> constexpr bool expr_elementwise = E::elementwise;
+template<class T, class A> constexpr bool expr_elementwise<Matrix<T, A>> = true;
+
+// makes dst an n x m matrix, reusing its buffer when the shape already matches
+template<class T, class A>
+void expr_reshape(Matrix<T, A>& dst, std::pair<size_t, size_t> sz) {
+	if (dst.size() != sz)
+		dst = Matrix<T, A>(sz);
+}
+
+// leaf operations, the destination may use another allocator than the operands
+template<class T, class A>
+const T& expr_at(const Matrix<T, A>& a, size_t k) { return a.data()[k]; }
+template<class T, class A>
+bool expr_refers_to(const Matrix<T, A>& a, const void* p) { return &a == p; }
+template<class T, class A, class B>
+void expr_eval_to(const Matrix<T, A>& a, Matrix<T, B>& dst) {
+	if constexpr (std::is_same_v<A, B>) {
+		if (&a != &dst)
+			dst = a;
+	} else {
+		expr_reshape(dst, a.size());
+		copy_view(a.view(), dst.view());
+	}
+}
+template<class T, class A, class B>
+void expr_accumulate_to(const Matrix<T, A>& a, Matrix<T, B>& dst, const T& alpha);
+
+// node operations
+template<class E>
+auto expr_at(const MatrixExpr<E>& e, size_t k) { return e.self().at(k); }
+template<class E>
+bool expr_refers_to(const MatrixExpr<E>& e, const void* p) { return e.self().refers_to(p); }
+template<class E, class T, class A>
+void expr_eval_to(const MatrixExpr<E>& e, Matrix<T, A>& dst) { e.self().eval_to(dst); }
+template<class E, class T, class A>
+void expr_accumulate_to(const MatrixExpr<E>& e, Matrix<T, A>& dst, const T& alpha) { e.self().accumulate_to(dst, alpha); }
+
+// f(lo, len) over the elements of an n x m matrix, split across the pool
+template<class F>
+void expr_for(std::pair<size_t, size_t> sz, F&& f) {
+	parallel_for(0, sz.first * sz.second, 1, [&](size_t lo, size_t hi) { f(lo, hi - lo); });
+}
+
+// out[0, n) += alpha * x[0, n) through simd.h, +-1 need no multiplication
+template<class T>
+void expr_axpy(const T& alpha, const T* x, T* out, size_t n) {
+	if (alpha == T(1))
+		vec_add(out, x, out, n);
+	else if (alpha == T(-1))
+		vec_sub(out, x, out, n);
+	else
+		vec_axpy(alpha, x, out, n);
+}
+
+// dst = e in one pass, e must be elementwise
+template<class E, class T, class A>
+void expr_fused_assign(const E& e, Matrix<T, A>& dst) {
+	expr_reshape(dst, e.size());
+	T* out = dst.data();
+	expr_for(dst.size(), [&](size_t lo, size_t len) {
+		for (size_t k = lo; k < lo + len; k++)
+			out[k] = expr_at(e, k);
+	});
+}
+
+// dst += alpha * e in one pass, e must be elementwise
+template<class E, class T, class A>
+void expr_fused_accumulate(const E& e, Matrix<T, A>& dst, const T& alpha) {
+	assertm(dst.size() == e.size(), "Wrong matrix sizes in matrix expression");
+	T* out = dst.data();
+	if (alpha == T(1))
+		expr_for(dst.size(), [&](size_t lo, size_t len) {
+			for (size_t k = lo; k < lo + len; k++)
+				out[k] += expr_at(e, k);
+		});
+	else if (alpha == T(-1))
+		expr_for(dst.size(), [&](size_t lo, size_t len) {
+			for (size_t k = lo; k < lo + len; k++)
+				out[k] -= expr_at(e, k);
+		});
+	else
+		expr_for(dst.size(), [&](size_t lo, size_t len) {
+			for (size_t k = lo; k < lo + len; k++)
+				out[k] += alpha * expr_at(e, k);
+		});
+}
+
+template<class T, class A, class B>
+void expr_accumulate_to(const Matrix<T, A>& a, Matrix<T, B>& dst, const T& alpha) {
+	assertm(dst.size() == a.size(), "Wrong matrix sizes in matrix expression");
+	expr_for(dst.size(), [&](size_t lo, size_t len) { expr_axpy(alpha, a.data() + lo, dst.data() + lo, len); });
+}
+
+// calls f with e as a Matrix, evaluating e first if it is not one
+template<class E, class F>
+void with_matrix(const E& e, F&& f) {
+	if constexpr (is_matrix<E>::value)
+		f(e);
+	else
+		f(e.eval());
+}
+
+} // namespace detail
+
+// common part of all nodes
+template<class E, class T>
+class MatrixExprNode : public MatrixExpr<E> {
+public:
+	using value_type = T;
+
+	Matrix<T> eval() const {
+		Matrix<T> res;
+		this->self().eval_to(res);
+		return res;
+	}
+};
+
+// L + R or L - R
+template<class L, class R, bool Minus>
+class MatrixSum : public MatrixExprNode<MatrixSum<L, R, Minus>, typename L::value_type> {
+public:
+	using T = typename L::value_type;
+	static constexpr bool elementwise = detail::expr_elementwise<L> && detail::expr_elementwise<R>;
+	// Matrix +- Matrix goes straight to the kernels of simd.h
+	static constexpr bool leaves = is_matrix<L>::value && is_matrix<R>::value;
+
+	MatrixSum(const L& l, const R& r) : l(l), r(r) {
+		assertm(l.size() == r.size(), "Wrong matrix sizes in operator+ or operator-");
+	}
+
+	std::pair<size_t, size_t> size() const { return l.size(); }
+	T at(size_t k) const {
+		if constexpr (Minus)
+			return detail::expr_at(l, k) - detail::expr_at(r, k);
+		else
+			return detail::expr_at(l, k) + detail::expr_at(r, k);
+	}
+	bool refers_to(const void* p) const { return detail::expr_refers_to(l, p) || detail::expr_refers_to(r, p); }
+
+	template<class A>
+	void eval_to(Matrix<T, A>& dst) const {
+		if constexpr (leaves) {
+			detail::expr_reshape(dst, size());
+			detail::expr_for(size(), [&](size_t lo, size_t len) {
+				if constexpr (Minus)
+					vec_sub(l.data() + lo, r.data() + lo, dst.data() + lo, len);
+				else
+					vec_add(l.data() + lo, r.data() + lo, dst.data() + lo, len);
+			});
+		} else if constexpr (elementwise) {
+			detail::expr_fused_assign(*this, dst);
+		} else {
+			detail::expr_eval_to(l, dst);
+			detail::expr_accumulate_to(r, dst, Minus ? T(-1) : T(1));
+		}
+	}
+	template<class A>
+	void accumulate_to(Matrix<T, A>& dst, const T& alpha) const {
+		// two kernel passes over dst, unless dst is an operand: the first pass would change
+		// what the second reads, so A += B + A takes the fused per-element pass
+		if constexpr (leaves) {
+			if (!refers_to(&dst)) {
+				assertm(dst.size() == size(), "Wrong matrix sizes in matrix expression");
+				T beta = Minus ? T(-alpha) : alpha;
+				detail::expr_for(size(), [&](size_t lo, size_t len) {
+					detail::expr_axpy(alpha, l.data() + lo, dst.data() + lo, len);
+					detail::expr_axpy(beta, r.data() + lo, dst.data() + lo, len);
+				});
+				return;
+			}
+		}
+		if constexpr (elementwise) {
+			detail::expr_fused_accumulate(*this, dst, alpha);
+		} else {
+			detail::expr_accumulate_to(l, dst, alpha);
+			detail::expr_accumulate_to(r, dst, Minus ? T(-alpha) : alpha);
+		}
+	}
+private:
+	detail::expr_operand<L> l;
+	detail::expr_operand<R> r;
+};
+
+// E * coef
+template<class E>
+class MatrixScaled : public MatrixExprNode<MatrixScaled<E>, typename E::value_type> {
+public:
+	using T = typename E::value_type;
+	static constexpr bool elementwise = detail::expr_elementwise<E>;
+	// Matrix * coef goes straight to the kernels of simd.h
+	static constexpr bool leaf = is_matrix<E>::value;
+
+	MatrixScaled(const E& e, const T& coef) : e(e), coef(coef) {}
+
+	std::pair<size_t, size_t> size() const { return e.size(); }
+	T at(size_t k) const { return detail::expr_at(e, k) * coef; }
+	bool refers_to(const void* p) const { return detail::expr_refers_to(e, p); }
+
+	template<class A>
+	void eval_to(Matrix<T, A>& dst) const {
+		if constexpr (leaf) {
+			detail::expr_reshape(dst, size());
+			detail::expr_for(size(), [&](size_t lo, size_t len) { vec_scale(e.data() + lo, coef, dst.data() + lo, len); });
+		} else if constexpr (elementwise) {
+			detail::expr_fused_assign(*this, dst);
+		} else {
+			detail::expr_eval_to(e, dst);
+			vec_scale(dst.data(), coef, dst.data(), dst.size().first * dst.size().second);
+		}
+	}
+	template<class A>
+	void accumulate_to(Matrix<T, A>& dst, const T& alpha) const {
+		if constexpr (leaf)
+			detail::expr_accumulate_to(e, dst, T(alpha * coef));
+		else if constexpr (elementwise)
+			detail::expr_fused_accumulate(*this, dst, alpha);
+		else
+			detail::expr_accumulate_to(e, dst, T(alpha * coef));
+	}
+private:
+	detail::expr_operand<E> e;
+	T coef;
+};
+
+// -E
+template<class E>
+class MatrixNeg : public MatrixExprNode<MatrixNeg<E>, typename E::value_type> {
+public:
+	using T = typename E::value_type;
+	static constexpr bool elementwise = detail::expr_elementwise<E>;
+
+	explicit MatrixNeg(const E& e) : e(e) {}
+
+	std::pair<size_t, size_t> size() const { return e.size(); }
+	T at(size_t k) const { return -detail::expr_at(e, k); }
+	bool refers_to(const void* p) const { return detail::expr_refers_to(e, p); }
+
+	template<class A>
+	void eval_to(Matrix<T, A>& dst) const {
+		if constexpr (elementwise) {
+			detail::expr_fused_assign(*this, dst);
+		} else {
+			detail::expr_eval_to(e, dst);
+			T* out = dst.data();
+			for (size_t k = 0; k < size().first * size().second; k++)
+				out[k] = -out[k];
+		}
+	}
+	template<class A>
+	void accumulate_to(Matrix<T, A>& dst, const T& alpha) const {
+		// -Matrix is one kernel call with -alpha
+		if constexpr (elementwise && !is_matrix<E>::value)
+			detail::expr_fused_accumulate(*this, dst, alpha);
+		else
+			detail::expr_accumulate_to(e, dst, T(-alpha));
+	}
+private:
+	detail::expr_operand<E> e;
+};
+
+// L * R, never elementwise: evaluated by gemm straight into the destination
+template<class L, class R>
+class MatrixProduct : public MatrixExprNode<MatrixProduct<L, R>, typename L::value_type> {
+public:
+	using T = typename L::value_type;
+	static constexpr bool elementwise = false;
+
+	MatrixProduct(const L& l, const R& r) : l(l), r(r) {
+		assertm(l.size().second == r.size().first, "Wrong matrix sizes in operaor*");
+	}
+
+	std::pair<size_t, size_t> size() const { return { l.size().first, r.size().second }; }
+	bool refers_to(const void* p) const { return detail::expr_refers_to(l, p) || detail::expr_refers_to(r, p); }
+
+	template<class A>
+	void eval_to(Matrix<T, A>& dst) const {
+		if (dst.size() == size())
+			std::fill(dst.data(), dst.data() + size().first * size().second, T(0));
+		else
+			dst = Matrix<T, A>(size());
+		accumulate_to(dst, T(1));
+	}
+	template<class A>
+	void accumulate_to(Matrix<T, A>& dst, const T& alpha) const {
+		assertm(dst.size() == size(), "Wrong matrix sizes in matrix expression");
+		LA_PHASE("Matrix::operator*");
+		detail::with_matrix(l, [&](const auto& lm) {
+			detail::with_matrix(r, [&](const auto& rm) {
+				gemm<T>(lm.view(), rm.view(), dst.view(), alpha);
+			});
+		});
+	}
+private:
+	detail::expr_operand<L> l;
+	detail::expr_operand<R> r;
+};
+
+// operators
+template<class L, class R>
+MatrixSum<L, R, false> operator+(const MatrixExpr<L>& l, const MatrixExpr<R>& r) { return { l.self(), r.self() }; }
+template<class L, class R>
+MatrixSum<L, R, true> operator-(const MatrixExpr<L>& l, const MatrixExpr<R>& r) { return { l.self(), r.self() }; }
+template<class L, class R>
+MatrixProduct<L, R> operator*(const MatrixExpr<L>& l, const MatrixExpr<R>& r) { return { l.self(), r.self() }; }
+template<class E>
+MatrixNeg<E> operator-(const MatrixExpr<E>& e) { return MatrixNeg<E>(e.self()); }
+template<class E>
+MatrixScaled<E> operator*(const MatrixExpr<E>& e, const typename E::value_type& coef) { return { e.self(), coef }; }
+template<class E>
+MatrixScaled<E> operator*(const typename E::value_type& coef, const MatrixExpr<E>& e) { return { e.self(), coef }; }
+
+// comparisons evaluate the operands that are not matrices yet
+template<class L, class R>
+bool operator==(const MatrixExpr<L>& l, const MatrixExpr<R>& r) {
+	bool res = false;
+	detail::with_matrix(l.self(), [&](const auto& lm) {
+		detail::with_matrix(r.self(), [&](const auto& rm) {
+			auto [n, m] = lm.size();
+			res = lm.size() == rm.size() && std::equal(lm.data(), lm.data() + n * m, rm.data());
+		});
+	});
+	return res;
+}
+template<class L, class R>
+bool operator!=(const MatrixExpr<L>& l, const MatrixExpr<R>& r) { return !(l == r); }
+
+template<class E>
+std::ostream& operator<<(std::ostream& out, const MatrixExpr<E>& e) { return out << e.self().eval(); }
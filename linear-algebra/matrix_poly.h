@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "matrix.h"
+#include "polynomial.h"
+#include "gemm.h"
+#include "simd.h"
+#include "instrumentation.h"
+#include "assertm.h"
+
+// Polynomials of a square matrix, p(A) = c_0 E + c_1 A + ... + c_d A^d.
+// Paterson-Stockmeyer splits p into blocks of s ~ sqrt(d + 1) coefficients,
+// p(A) = B_0(A) + B_1(A) A^s + B_2(A) A^2s + ..., each B_j(A) is a combination of the cached
+// powers A, ..., A^(s-1) and the outer sum is Horner's rule in A^s. That is s - 1 products
+// for the powers and d / s for Horner, about 2 sqrt(d) instead of d.
+
+// A, A^2, A^3, ... kept for evaluating several polynomials at the same matrix
+template<class T>
+class MatrixPowerCache {
+public:
+	explicit MatrixPowerCache(const Matrix<T>& a) : pw{ a } {
+		auto [n, m] = a.size();
+		assertm(n == m, "Wrong matrix sizes in MatrixPowerCache");
+	}
+
+	size_t dim() const { return pw[0].size().first; }
+
+	// A^k for k >= 1, the missing powers up to k are computed and kept
+	const Matrix<T>& power(size_t k) {
+		assertm(k >= 1, "MatrixPowerCache stores positive powers");
+		while (pw.size() < k) {
+			size_t n = dim();
+			Matrix<T> next(n, n);
+			gemm<T>(pw.back().view(), pw[0].view(), next.view());
+			pw.push_back(std::move(next));
+		}
+		return pw[k - 1];
+	}
+
+	Matrix<T> evaluate(const Polynomial<T>& p);
+
+private:
+	// dst = sum c[i] A^i for i in [0, len)
+	void combine(const T* c, size_t len, Matrix<T>& dst);
+
+	std::vector<Matrix<T>> pw;
+};
+
+template<class T>
+void MatrixPowerCache<T>::combine(const T* c, size_t len, Matrix<T>& dst) {
+	size_t n = dim();
+	for (size_t i = 1; i < len; i++)
+		if (c[i] != T(0))
+			vec_axpy(c[i], pw[i - 1].data(), dst.data(), n * n);
+	for (size_t i = 0; i < n; i++)
+		dst[i][i] += c[0];
+}
+
+template<class T>
+Matrix<T> MatrixPowerCache<T>::evaluate(const Polynomial<T>& p) {
+	LA_PHASE("MatrixPowerCache::evaluate");
+	size_t n = dim(), len = p.size();
+	std::vector<T> c(p.begin(), p.end());
+	size_t s = std::max<size_t>(1, size_t(std::ceil(std::sqrt(double(len)))));
+	power(s);
+	size_t blocks = (len + s - 1) / s;
+
+	// Horner in A^s: res = res * A^s + B_j, gemm adds the product onto B_j in place
+	Matrix<T> res(n, n), next(n, n);
+	size_t last = (blocks - 1) * s;
+	combine(c.data() + last, len - last, res);
+	for (size_t j = blocks - 1; j-- > 0;) {
+		std::fill(next.data(), next.data() + n * n, T(0));
+		combine(c.data() + j * s, s, next);
+		gemm<T>(res.view(), pw[s - 1].view(), next.view());
+		std::swap(res, next);
+	}
+	return res;
+}
+
+template<class T, class Alloc>
+Matrix<T> Polynomial<T, Alloc>::operator()(const Matrix<T>& a) const {
+	return MatrixPowerCache<T>(a).evaluate(*this);
+}
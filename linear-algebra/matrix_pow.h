@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "matrix.h"
+#include "polynomial.h"
+#include "matrix_poly.h"
+#include "gemm.h"
+#include "assertm.h"
+
+// Matrix powers A^deg for exponents up to 2^64.
+// Binary powering runs left to right on two preallocated buffers: every product is written
+// by gemm into the spare buffer, which then trades places with the result, so the loop
+// never allocates. It costs floor(log2 deg) + popcount(deg) - 1 products.
+// For exact types and large exponents the Cayley-Hamilton path is cheaper: with p the
+// characteristic polynomial, A^deg = r(A) where r = x^deg mod p, so the exponent only costs
+// O(n^2 log deg) polynomial work, plus char_poly() and about 2 sqrt(n) products for r(A)
+// by Paterson-Stockmeyer (matrix_poly.h).
+// Floating types always use binary powering, x^deg mod p is unstable for them.
+
+template<class T>
+class MatrixPowWorkspace {
+public:
+	// A^deg, the result lives in the workspace until the next call
+	Matrix<T>& pow(const Matrix<T>& a, uint64_t deg);
+private:
+	Matrix<T>& pow_binary(const Matrix<T>& a, uint64_t deg);
+	Matrix<T>& pow_cayley_hamilton(const Matrix<T>& a, uint64_t deg);
+	// res = x * y through the spare buffer
+	void mul(const Matrix<T>& x, const Matrix<T>& y);
+	void set_identity(size_t n);
+
+	Matrix<T> res, spare;
+};
+
+namespace detail {
+
+// products spent by binary powering
+inline size_t pow_binary_products(uint64_t deg) {
+	return deg ? std::bit_width(deg) - 1 + std::popcount(deg) - 1 : 0;
+}
+
+// x^deg mod p for monic p of degree n >= 1, coefficients from the lowest power up
+template<class T>
+std::vector<T> pow_x_mod(uint64_t deg, const std::vector<T>& p) {
+	size_t n = p.size() - 1;
+	std::vector<T> r(n, T(0)), sq(2 * n - 1);
+	r[0] = T(1);
+	for (int bit = int(std::bit_width(deg)) - 1; bit >= 0; bit--) {
+		// r = r^2 mod p, terms of degree >= n are folded down with x^n = x^n - p(x)
+		std::fill(sq.begin(), sq.end(), T(0));
+		for (size_t i = 0; i < n; i++) {
+			if (r[i] == T(0))
+				continue;
+			for (size_t j = 0; j < n; j++)
+				sq[i + j] += r[i] * r[j];
+		}
+		for (size_t i = 2 * n - 1; i-- > n;) {
+			if (sq[i] == T(0))
+				continue;
+			for (size_t j = 0; j < n; j++)
+				sq[i - n + j] -= sq[i] * p[j];
+		}
+		std::copy(sq.begin(), sq.begin() + n, r.begin());
+		if ((deg >> bit) & 1) {
+			// r = r * x mod p
+			T top = r[n - 1];
+			for (size_t i = n - 1; i > 0; i--)
+				r[i] = r[i - 1] - top * p[i];
+			r[0] = -top * p[0];
+		}
+	}
+	return r;
+}
+
+} // namespace detail
+
+template<class T>
+void MatrixPowWorkspace<T>::mul(const Matrix<T>& x, const Matrix<T>& y) {
+	auto [n, m] = x.size();
+	if (spare.size() != std::make_pair(n, m))
+		spare = Matrix<T>(n, m);
+	else
+		std::fill(spare.data(), spare.data() + n * m, T(0));
+	gemm<T>(x.view(), y.view(), spare.view());
+	std::swap(res, spare);
+}
+
+template<class T>
+void MatrixPowWorkspace<T>::set_identity(size_t n) {
+	if (res.size() != std::make_pair(n, n))
+		res = Matrix<T>(n, n);
+	else
+		std::fill(res.data(), res.data() + n * n, T(0));
+	for (size_t i = 0; i < n; i++)
+		res[i][i] = T(1);
+}
+
+template<class T>
+Matrix<T>& MatrixPowWorkspace<T>::pow(const Matrix<T>& a, uint64_t deg) {
+	auto [n, m] = a.size();
+	assertm(n == m, "Wrong matrix sizes in pow");
+	if (deg <= 1 || n == 0) {
+		if (deg == 0)
+			set_identity(n);
+		else
+			res = a;
+		return res;
+	}
+	if constexpr (!std::is_floating_point_v<T>) {
+		// char_poly is about n / 4 products, r(A) about 2 sqrt(n)
+		if (n / 4 + 2 * size_t(std::sqrt(double(n))) + 2 < detail::pow_binary_products(deg))
+			return pow_cayley_hamilton(a, deg);
+	}
+	return pow_binary(a, deg);
+}
+
+template<class T>
+Matrix<T>& MatrixPowWorkspace<T>::pow_binary(const Matrix<T>& a, uint64_t deg) {
+	res = a;
+	for (int bit = int(std::bit_width(deg)) - 2; bit >= 0; bit--) {
+		mul(res, res);
+		if ((deg >> bit) & 1)
+			mul(res, a);
+	}
+	return res;
+}
+
+template<class T>
+Matrix<T>& MatrixPowWorkspace<T>::pow_cayley_hamilton(const Matrix<T>& a, uint64_t deg) {
+	size_t n = a.size().first;
+	Polynomial<T> cp = a.char_poly();
+	std::vector<T> p(n + 1);
+	for (size_t i = 0; i <= n; i++)
+		p[i] = cp[i];
+	res = Polynomial<T>(detail::pow_x_mod(deg, p))(a);
+	return res;
+}
+
+template<class T>
+Matrix<T> pow(const Matrix<T>& a, uint64_t deg) {
+	MatrixPowWorkspace<T> w;
+	return std::move(w.pow(a, deg));
+}
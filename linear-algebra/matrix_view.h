@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "assertm.h"
+#include "thread_pool.h"
+
+// Non-owning views over strided storage.
+// VectorView is a row (stride 1) or a column (stride = leading dimension) of a matrix,
+// MatrixView is a submatrix with leading dimension ld (distance between rows).
+
+template<class T>
+class StridedIterator {
+public:
+	using iterator_category = std::random_access_iterator_tag;
+	using value_type = std::remove_const_t<T>;
+	using difference_type = std::ptrdiff_t;
+	using pointer = T*;
+	using reference = T&;
+
+	StridedIterator(T* p = nullptr, difference_type stride = 1) : p(p), stride(stride) {}
+
+	reference operator*() const { return *p; }
+	pointer operator->() const { return p; }
+	reference operator[](difference_type i) const { return p[i * stride]; }
+
+	StridedIterator& operator++() { p += stride; return *this; }
+	StridedIterator& operator--() { p -= stride; return *this; }
+	StridedIterator operator++(int) { auto tmp = *this; p += stride; return tmp; }
+	StridedIterator operator--(int) { auto tmp = *this; p -= stride; return tmp; }
+	StridedIterator& operator+=(difference_type d) { p += d * stride; return *this; }
+	StridedIterator& operator-=(difference_type d) { p -= d * stride; return *this; }
+	StridedIterator operator+(difference_type d) const { return StridedIterator(p + d * stride, stride); }
+	StridedIterator operator-(difference_type d) const { return StridedIterator(p - d * stride, stride); }
+	difference_type operator-(const StridedIterator& other) const { return (p - other.p) / stride; }
+	friend StridedIterator operator+(difference_type d, const StridedIterator& it) { return it + d; }
+
+	bool operator==(const StridedIterator& other) const { return p == other.p; }
+	bool operator!=(const StridedIterator& other) const { return p != other.p; }
+	bool operator<(const StridedIterator& other) const { return (*this - other) < 0; }
+	bool operator>(const StridedIterator& other) const { return (*this - other) > 0; }
+	bool operator<=(const StridedIterator& other) const { return (*this - other) <= 0; }
+	bool operator>=(const StridedIterator& other) const { return (*this - other) >= 0; }
+private:
+	T* p;
+	difference_type stride;
+};
+
+template<class T>
+class VectorView {
+public:
+	using value_type = std::remove_const_t<T>;
+	using iterator = StridedIterator<T>;
+
+	VectorView(T* p, size_t n, size_t stride = 1) : p(p), n(n), st(stride) {}
+	VectorView(const VectorView& other) = default;
+
+	operator VectorView<const T>() const requires (!std::is_const_v<T>) { return { p, n, st }; }
+
+	// assignment copies elements, like assignment of a row of std::vector<std::vector<T>>
+	VectorView& operator=(const VectorView& other) { return assign(other); }
+	template<class U>
+	VectorView& assign(const VectorView<U>& other) {
+		assertm(n == other.size(), "Wrong VectorView sizes in assign");
+		for (size_t i = 0; i < n; i++)
+			p[i * st] = other[i];
+		return *this;
+	}
+
+	size_t size() const { return n; }
+	size_t stride() const { return st; }
+	T* data() const { return p; }
+
+	T& operator[](size_t i) const { return p[i * st]; }
+
+	// swaps elements, not views: res[i].swap(res[j]) swaps two rows of a matrix
+	void swap(const VectorView& other) const {
+		assertm(n == other.n, "Wrong VectorView sizes in swap");
+		if (p == other.p)
+			return;
+		if (st == 1 && other.st == 1)
+			std::swap_ranges(p, p + n, other.p);
+		else
+			for (size_t i = 0; i < n; i++)
+				std::swap(p[i * st], other.p[i * other.st]);
+	}
+
+	std::vector<value_type> to_vector() const { return std::vector<value_type>(begin(), end()); }
+
+	iterator begin() const { return iterator(p, st); }
+	iterator end() const { return iterator(p + n * st, st); }
+
+	template<class U>
+	bool operator==(const VectorView<U>& other) const { return std::equal(begin(), end(), other.begin(), other.end()); }
+	template<class U>
+	bool operator!=(const VectorView<U>& other) const { return !(*this == other); }
+private:
+	T* p;
+	size_t n, st;
+};
+
+template<class T>
+class MatrixView {
+public:
+	using value_type = std::remove_const_t<T>;
+
+	MatrixView() : p(nullptr), n(0), m(0), lda(0) {}
+	MatrixView(T* p, size_t n, size_t m) : p(p), n(n), m(m), lda(m) {}
+	MatrixView(T* p, size_t n, size_t m, size_t ld) : p(p), n(n), m(m), lda(ld) {}
+
+	operator MatrixView<const T>() const requires (!std::is_const_v<T>) { return { p, n, m, lda }; }
+
+	std::pair<size_t, size_t> size() const { return { n, m }; }
+	size_t rows() const { return n; }
+	size_t cols() const { return m; }
+	size_t ld() const { return lda; }
+	T* data() const { return p; }
+	bool is_contiguous() const { return lda == m || n <= 1; }
+
+	T& operator()(size_t i, size_t j) const { return p[i * lda + j]; }
+	VectorView<T> operator[](size_t i) const { return row(i); }
+
+	VectorView<T> row(size_t i) const { return { p + i * lda, m, 1 }; }
+	VectorView<T> col(size_t j) const { return { p + j, n, lda }; }
+	MatrixView block(size_t i, size_t j, size_t rows, size_t cols) const {
+		assertm(i + rows <= n && j + cols <= m, "Wrong block in MatrixView::block");
+		return { p + i * lda + j, rows, cols, lda };
+	}
+private:
+	T* p;
+	size_t n, m, lda;
+};
+
+// view-level algorithms
+template<class T, class U>
+void copy_view(MatrixView<T> src, MatrixView<U> dst) {
+	auto [n, m] = src.size();
+	assertm(dst.rows() == n && dst.cols() == m, "Wrong view sizes in copy_view");
+	parallel_for(0, n, m, [&](size_t lo, size_t hi) {
+		for (size_t i = lo; i < hi; i++)
+			std::copy(src.data() + i * src.ld(), src.data() + i * src.ld() + m, dst.data() + i * dst.ld());
+	});
+}
+
+template<class T, class U>
+void transpose_view(MatrixView<T> src, MatrixView<U> dst) {
+	// tiles keep both the read rows and the written columns in cache
+	const size_t tile = 32;
+	auto [n, m] = src.size();
+	assertm(dst.rows() == m && dst.cols() == n, "Wrong view sizes in transpose_view");
+	parallel_for(0, (n + tile - 1) / tile, tile * m, [&](size_t lo, size_t hi) {
+		for (size_t i0 = lo * tile; i0 < std::min(n, hi * tile); i0 += tile)
+			for (size_t j0 = 0; j0 < m; j0 += tile)
+				for (size_t i = i0; i < std::min(n, i0 + tile); i++)
+					for (size_t j = j0; j < std::min(m, j0 + tile); j++)
+						dst(j, i) = src(i, j);
+	});
+}
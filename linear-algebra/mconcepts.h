@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <concepts>
+#include <type_traits>
 
 template<class T>
 concept conc_read = requires (std::istream& in, T x) {
@@ -41,5 +42,13 @@ concept conc_base_math = requires (T x, T y) {
 	x * y;
 };
 
+// element of MathVector and Matrix, % is not required so floating types fit too
 template<class T>
-concept conc_num = conc_gcd<T> && conc_read<T> && conc_write<T> && conc_comp<T> && conc_base_math<T>;
\ No newline at end of file
+concept conc_scalar = conc_read<T> && conc_write<T> && conc_comp<T> && conc_base_math<T>;
+
+template<class T>
+concept conc_num = conc_gcd<T> && conc_scalar<T>;
+
+// every nonzero element is invertible, so / is exact; integral types are rings
+template<class T>
+struct is_field : std::bool_constant<!std::is_integral_v<T>> {};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <concepts>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+
+#include "assertm.h"
+
+// Residues modulo an odd prime below 2^31 in Montgomery form: x is stored as x * 2^32 mod p,
+// so a product needs one 64-bit multiplication and one reduction instead of a division.
+// ModInt<P> fixes the prime at compile time and satisfies conc_num, so Matrix<ModInt<P>>
+// works with det(), rank() and to_stepped_view(). Montgomery is the same reduction with the
+// prime chosen at run time, the multi-modular engine (multimod.h) runs on it.
+
+namespace detail {
+
+class Montgomery {
+public:
+	constexpr explicit Montgomery(uint32_t p) : p(p) {
+		// p^-1 mod 2^32 by Newton's iteration, each step doubles the number of correct bits
+		uint32_t inv = p;
+		for (int i = 0; i < 5; i++)
+			inv *= 2 - p * inv;
+		neg_inv = 0u - inv;
+		uint64_t r = (uint64_t(1) << 32) % p;
+		r2 = uint32_t(r * r % p);
+	}
+
+	constexpr uint32_t mod() const { return p; }
+
+	// t * 2^-32 mod p for t < p * 2^32
+	constexpr uint32_t reduce(uint64_t t) const {
+		uint32_t k = uint32_t(t) * neg_inv;
+		uint32_t u = uint32_t((t + uint64_t(k) * p) >> 32);
+		return u >= p ? u - p : u;
+	}
+
+	constexpr uint32_t to_mont(uint32_t x) const { return reduce(uint64_t(x) * r2); }
+	constexpr uint32_t from_mont(uint32_t x) const { return reduce(x); }
+
+	// arguments and results are in Montgomery form and below p
+	constexpr uint32_t add(uint32_t a, uint32_t b) const { a += b; return a >= p ? a - p : a; }
+	constexpr uint32_t sub(uint32_t a, uint32_t b) const { return a >= b ? a - b : a + p - b; }
+	constexpr uint32_t mul(uint32_t a, uint32_t b) const { return reduce(uint64_t(a) * b); }
+	constexpr uint32_t pow(uint32_t a, uint64_t e) const {
+		uint32_t res = to_mont(1);
+		for (; e; e >>= 1, a = mul(a, a))
+			if (e & 1)
+				res = mul(res, a);
+		return res;
+	}
+	constexpr uint32_t inv(uint32_t a) const {
+		assertm(a != 0, "Division by 0");
+		return pow(a, p - 2);
+	}
+private:
+	uint32_t p, r2 = 0, neg_inv = 0;
+};
+
+} // namespace detail
+
+template<uint32_t P>
+class ModInt {
+	static_assert(P > 2 && P % 2 == 1 && P < (uint32_t(1) << 31), "ModInt needs an odd prime below 2^31");
+	static constexpr detail::Montgomery mont{ P };
+public:
+	static constexpr uint32_t mod() { return P; }
+
+	constexpr ModInt() {}
+	template<std::integral I>
+	constexpr ModInt(I x) {
+		if constexpr (std::is_signed_v<I>) {
+			long long r = (long long)x % (long long)P;
+			v = mont.to_mont(uint32_t(r < 0 ? r + P : r));
+		} else {
+			v = mont.to_mont(uint32_t((unsigned long long)x % P));
+		}
+	}
+
+	// canonical representative in [0, P)
+	constexpr uint32_t value() const { return mont.from_mont(v); }
+
+	constexpr ModInt pow(uint64_t e) const { return raw(mont.pow(v, e)); }
+	constexpr ModInt inv() const { return raw(mont.inv(v)); }
+
+	constexpr ModInt operator-() const { return raw(mont.sub(0, v)); }
+
+	constexpr ModInt& operator+=(const ModInt& other) { v = mont.add(v, other.v); return *this; }
+	constexpr ModInt& operator-=(const ModInt& other) { v = mont.sub(v, other.v); return *this; }
+	constexpr ModInt& operator*=(const ModInt& other) { v = mont.mul(v, other.v); return *this; }
+	constexpr ModInt& operator/=(const ModInt& other) { v = mont.mul(v, mont.inv(other.v)); return *this; }
+	constexpr ModInt& operator%=(const ModInt& other) { return *this = *this % other; }
+
+	friend constexpr ModInt operator+(ModInt a, const ModInt& b) { return a += b; }
+	friend constexpr ModInt operator-(ModInt a, const ModInt& b) { return a -= b; }
+	friend constexpr ModInt operator*(ModInt a, const ModInt& b) { return a *= b; }
+	friend constexpr ModInt operator/(ModInt a, const ModInt& b) { return a /= b; }
+	// every nonzero element divides every other one in a field, so the remainder is 0
+	friend constexpr ModInt operator%(const ModInt&, const ModInt& b) {
+		assertm(b.v != 0, "Division by 0");
+		return ModInt();
+	}
+
+	// the order is the one of the canonical representatives, it only serves
+	// generic code such as pivot choice and my_gcd
+	friend constexpr bool operator==(const ModInt& a, const ModInt& b) { return a.v == b.v; }
+	friend constexpr bool operator!=(const ModInt& a, const ModInt& b) { return a.v != b.v; }
+	friend constexpr bool operator<(const ModInt& a, const ModInt& b) { return a.value() < b.value(); }
+	friend constexpr bool operator>(const ModInt& a, const ModInt& b) { return a.value() > b.value(); }
+	friend constexpr bool operator<=(const ModInt& a, const ModInt& b) { return a.value() <= b.value(); }
+	friend constexpr bool operator>=(const ModInt& a, const ModInt& b) { return a.value() >= b.value(); }
+
+	friend std::istream& operator>>(std::istream& in, ModInt& a) {
+		long long x;
+		if (in >> x)
+			a = ModInt(x);
+		return in;
+	}
+	friend std::ostream& operator<<(std::ostream& out, const ModInt& a) { return out << a.value(); }
+private:
+	static constexpr ModInt raw(uint32_t x) {
+		ModInt res;
+		res.v = x;
+		return res;
+	}
+
+	uint32_t v = 0;
+};
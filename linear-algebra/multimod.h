@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "matrix.h"
+#include "bigint.h"
+#include "modint.h"
+#include "bareiss.h"
+#include "thread_pool.h"
+#include "instrumentation.h"
+#include "assertm.h"
+
+// Multi-modular determinant and rank of integer matrices.
+// The matrix is reduced modulo word-sized primes and eliminated over each of them in O(n^3)
+// Montgomery operations, the primes are independent and run in parallel. The determinant is
+// rebuilt by CRT from as many primes as Hadamard's bound requires, so it is exact and no
+// big number appears inside the elimination. Rank modulo p never exceeds the true rank and
+// equals it unless p divides every nonzero minor of that order, so the maximum over a few
+// large primes is exact with overwhelming probability. Rational matrices are cleared of
+// denominators row by row first, as in bareiss.h.
+
+// Matrix::det of integer and Rational matrices switches from Bareiss to the multi-modular
+// engine at this order
+constexpr size_t MULTIMOD_DET_CUTOFF = 32;
+constexpr size_t MULTIMOD_RANK_PRIMES = 2;
+
+namespace detail {
+
+// deterministic Miller-Rabin, bases 2, 7 and 61 cover every 32-bit number
+inline bool is_prime_u32(uint32_t n) {
+	if (n < 2)
+		return false;
+	for (uint32_t d : { 2u, 3u, 5u, 7u, 61u })
+		if (n % d == 0)
+			return n == d;
+	uint32_t d = n - 1;
+	int s = 0;
+	for (; d % 2 == 0; d /= 2)
+		++s;
+	for (uint64_t a : { 2u, 7u, 61u }) {
+		uint64_t x = 1, b = a;
+		for (uint32_t e = d; e; e >>= 1, b = b * b % n)
+			if (e & 1)
+				x = x * b % n;
+		if (x == 1 || x == n - 1)
+			continue;
+		bool composite = true;
+		for (int i = 1; i < s && composite; i++) {
+			x = x * x % n;
+			composite = x != n - 1;
+		}
+		if (composite)
+			return false;
+	}
+	return true;
+}
+
+// the k largest primes below 2^31 in decreasing order, each is above 2^30
+inline std::vector<uint32_t> multimod_primes(size_t k) {
+	static std::mutex mutex;
+	static std::vector<uint32_t> primes;
+	std::lock_guard<std::mutex> lock(mutex);
+	for (uint32_t p = primes.empty() ? (uint32_t(1) << 31) - 1 : primes.back() - 2; primes.size() < k; p -= 2)
+		if (is_prime_u32(p))
+			primes.push_back(p);
+	return std::vector<uint32_t>(primes.begin(), primes.begin() + k);
+}
+
+template<class W>
+uint32_t multimod_residue(const W& x, uint32_t p) {
+	if constexpr (std::is_same_v<W, BigInt>) {
+		return x.mod_small(p);
+	} else if constexpr (std::is_signed_v<W>) {
+		long long r = (long long)x % (long long)p;
+		return uint32_t(r < 0 ? r + p : r);
+	} else {
+		return uint32_t((unsigned long long)x % p);
+	}
+}
+
+// upper bound on log2 |x| for x != 0
+template<class W>
+double multimod_log2(const W& x) {
+	if constexpr (std::is_same_v<W, BigInt>)
+		return double(x.bit_length());
+	else
+		return std::log2(std::fabs(double(x)));
+}
+
+// log2 of Hadamard's bound prod |row_i| on |det a|, -inf when a has a zero row
+template<class W>
+double hadamard_log2(const Matrix<W>& a) {
+	auto [n, m] = a.size();
+	double res = 0;
+	std::vector<double> l;
+	for (size_t i = 0; i < n; i++) {
+		l.clear();
+		for (size_t j = 0; j < m; j++)
+			if (a[i][j] != W(0))
+				l.push_back(multimod_log2(a[i][j]));
+		if (l.empty())
+			return -HUGE_VAL;
+		double mx = *std::max_element(l.begin(), l.end()), s = 0;
+		for (double x : l)
+			s += std::exp2(2 * (x - mx));
+		res += mx + std::log2(s) / 2;
+	}
+	return res;
+}
+
+struct ModElimination {
+	size_t rank;
+	// determinant in Montgomery form, meaningful for square matrices
+	uint32_t det;
+};
+
+// Gaussian elimination of the n x m row-major matrix a modulo mt.mod(),
+// entries are in Montgomery form and a is overwritten
+inline ModElimination mod_eliminate(std::vector<uint32_t>& a, size_t n, size_t m, const Montgomery& mt) {
+	size_t r = 0;
+	uint32_t det = mt.to_mont(1);
+	for (size_t c = 0; c < m && r < n; c++) {
+		size_t p = r;
+		while (p < n && a[p * m + c] == 0)
+			++p;
+		if (p == n)
+			continue;
+		if (p != r) {
+			std::swap_ranges(a.begin() + p * m + c, a.begin() + p * m + m, a.begin() + r * m + c);
+			det = mt.sub(0, det);
+		}
+		const uint32_t* piv = a.data() + r * m;
+		det = mt.mul(det, piv[c]);
+		uint32_t inv = mt.inv(piv[c]);
+		for (size_t i = r + 1; i < n; i++) {
+			uint32_t* row = a.data() + i * m;
+			if (row[c] == 0)
+				continue;
+			uint32_t l = mt.mul(row[c], inv);
+			for (size_t j = c + 1; j < m; j++)
+				row[j] = mt.sub(row[j], mt.mul(l, piv[j]));
+			row[c] = 0;
+		}
+		++r;
+	}
+	return { r, r == n ? det : 0 };
+}
+
+// eliminates a modulo every prime in parallel and calls f(t, result, context) for the t-th prime
+template<class W, class F>
+void multimod_run(const Matrix<W>& a, const std::vector<uint32_t>& primes, F&& f) {
+	LA_PHASE("multimod::eliminate");
+	auto [n, m] = a.size();
+	parallel_for(0, primes.size(), n * m * std::min(n, m), [&](size_t lo, size_t hi) {
+		std::vector<uint32_t> buf(n * m);
+		for (size_t t = lo; t < hi; t++) {
+			Montgomery mt(primes[t]);
+			for (size_t k = 0; k < n * m; k++)
+				buf[k] = mt.to_mont(multimod_residue(a.data()[k], primes[t]));
+			f(t, mod_eliminate(buf, n, m, mt), mt);
+		}
+	});
+}
+
+// x with x = r[i] mod p[i] and |x| < prod p[i] / 2, mixed-radix digits by Garner's algorithm
+inline BigInt multimod_crt(const std::vector<uint32_t>& r, const std::vector<uint32_t>& p) {
+	LA_PHASE("multimod::crt");
+	BigInt x = 0, mod = 1;
+	for (size_t i = 0; i < p.size(); i++) {
+		Montgomery mt(p[i]);
+		uint32_t diff = mt.sub(mt.to_mont(r[i]), mt.to_mont(x.mod_small(p[i])));
+		uint32_t t = mt.from_mont(mt.mul(diff, mt.inv(mt.to_mont(mod.mod_small(p[i])))));
+		x += mod * BigInt(t);
+		mod *= BigInt(p[i]);
+	}
+	if (x > mod / BigInt(2))
+		x -= mod;
+	return x;
+}
+
+template<class W>
+BigInt multimod_det(const Matrix<W>& a) {
+	auto [n, m] = a.size();
+	assertm(n == m, "Wrong matrix sizes in det");
+	double bits = hadamard_log2(a);
+	if (std::isinf(bits))
+		return BigInt(0);
+	// every prime is above 2^30 and the residues must fix det in (-2^bits, 2^bits), one more bit of margin
+	auto primes = multimod_primes(size_t(bits + 2) / 30 + 1);
+	std::vector<uint32_t> res(primes.size());
+	multimod_run(a, primes, [&](size_t t, const ModElimination& e, const Montgomery& mt) {
+		res[t] = mt.from_mont(e.det);
+	});
+	return multimod_crt(res, primes);
+}
+
+template<class W>
+size_t multimod_rank(const Matrix<W>& a, size_t primes_count) {
+	auto primes = multimod_primes(std::max<size_t>(primes_count, 1));
+	std::vector<size_t> res(primes.size());
+	multimod_run(a, primes, [&](size_t t, const ModElimination& e, const Montgomery&) {
+		res[t] = e.rank;
+	});
+	return *std::max_element(res.begin(), res.end());
+}
+
+} // namespace detail
+
+template<class T>
+requires conc_bareiss<T>
+T det_multimodular(const Matrix<T>& a) {
+	return detail::bareiss_run<T>([&]<class W>() {
+		std::vector<W> scale;
+		auto b = detail::bareiss_input<W>(a, &scale);
+		BigInt num = detail::multimod_det(b), den = 1;
+		detail::bareiss_unscale(num, den, scale);
+		return detail::bareiss_output<T>(num, den);
+	});
+}
+
+template<class T>
+requires conc_bareiss<T>
+size_t rank_multimodular(const Matrix<T>& a, size_t primes = MULTIMOD_RANK_PRIMES) {
+	return detail::bareiss_run<T>([&]<class W>() { return detail::multimod_rank(detail::bareiss_input<W>(a), primes); });
+}
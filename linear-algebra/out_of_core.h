@@ -0,0 +1,713 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <ios>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "binary_io.h"
+#include "matrix.h"
+#include "gemm.h"
+#include "simd.h"
+#include "assertm.h"
+
+// Out-of-core dense matrices for data larger than RAM.
+// TiledMatrix keeps square tiles of OOC_TILE x OOC_TILE elements in a file (a BinaryHeader
+// with layout tiled, then the tiles row by row, edge tiles padded) and only an LRU cache of
+// tiles in memory, at most OOC_CACHE_BYTES by default. Pinned tiles are never evicted,
+// evicted dirty tiles are written back by a background I/O thread, and the algorithms
+// prefetch the next tiles on the same thread, so I/O overlaps with compute.
+// A failed read or write of the file, on any thread, makes the next tile access and flush
+// throw std::ios_base::failure.
+// operator* multiplies tile by tile through gemm; lu_inplace and to_stepped_view eliminate
+// panels of one tile column, each panel and each column strip of the trailing matrix is
+// read into memory once per panel, so they need (rows x OOC_TILE) elements of RAM.
+// Only fixed-size elements (built-in numbers, ModInt) can be stored.
+
+constexpr size_t OOC_TILE = 256;
+constexpr size_t OOC_CACHE_BYTES = size_t(256) << 20;
+
+namespace detail {
+
+// positional reads and writes, safe from several threads
+class TileFile {
+public:
+	TileFile() {}
+	~TileFile() { close(); }
+	TileFile(const TileFile&) = delete;
+	TileFile& operator=(const TileFile&) = delete;
+
+	// create = true truncates the file to bytes zero bytes
+	bool open(const std::string& path, bool create, uint64_t bytes = 0) {
+		close();
+#if defined(_WIN32)
+		h = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+			create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (h == INVALID_HANDLE_VALUE)
+			return false;
+		if (create) {
+			LARGE_INTEGER size;
+			size.QuadPart = LONGLONG(bytes);
+			if (!SetFilePointerEx(h, size, nullptr, FILE_BEGIN) || !SetEndOfFile(h))
+				return close(), false;
+		}
+#else
+		fd = ::open(path.c_str(), create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+		if (fd < 0)
+			return false;
+		if (create && ftruncate(fd, off_t(bytes)) != 0)
+			return close(), false;
+#endif
+		return true;
+	}
+
+	void close() {
+#if defined(_WIN32)
+		if (h != INVALID_HANDLE_VALUE)
+			CloseHandle(h);
+		h = INVALID_HANDLE_VALUE;
+#else
+		if (fd >= 0)
+			::close(fd);
+		fd = -1;
+#endif
+	}
+
+	bool read_at(uint64_t offset, void* p, size_t len) const {
+		char* dst = static_cast<char*>(p);
+		while (len) {
+			size_t part = std::min<size_t>(len, size_t(1) << 30);
+#if defined(_WIN32)
+			OVERLAPPED o = {};
+			o.Offset = DWORD(offset);
+			o.OffsetHigh = DWORD(offset >> 32);
+			DWORD done = 0;
+			if (!ReadFile(h, dst, DWORD(part), &done, &o) || done == 0)
+				return false;
+#else
+			ssize_t done = pread(fd, dst, part, off_t(offset));
+			if (done <= 0)
+				return false;
+#endif
+			dst += done;
+			offset += done;
+			len -= size_t(done);
+		}
+		return true;
+	}
+
+	bool write_at(uint64_t offset, const void* p, size_t len) const {
+		const char* src = static_cast<const char*>(p);
+		while (len) {
+			size_t part = std::min<size_t>(len, size_t(1) << 30);
+#if defined(_WIN32)
+			OVERLAPPED o = {};
+			o.Offset = DWORD(offset);
+			o.OffsetHigh = DWORD(offset >> 32);
+			DWORD done = 0;
+			if (!WriteFile(h, src, DWORD(part), &done, &o) || done == 0)
+				return false;
+#else
+			ssize_t done = pwrite(fd, src, part, off_t(offset));
+			if (done <= 0)
+				return false;
+#endif
+			src += done;
+			offset += done;
+			len -= size_t(done);
+		}
+		return true;
+	}
+
+private:
+#if defined(_WIN32)
+	HANDLE h = INVALID_HANDLE_VALUE;
+#else
+	int fd = -1;
+#endif
+};
+
+// LRU cache of equally sized tiles of a TileFile, tile id at offset base + id * tile bytes
+template<class T>
+class TileCache {
+public:
+	TileCache(TileFile& file, uint64_t base, size_t tile_elems, size_t capacity)
+		: file(file), base(base), elems(tile_elems), capacity(std::max<size_t>(capacity, 4)), io([this] { io_loop(); }) {}
+
+	~TileCache() {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			write_back(lock);
+			stop = true;
+		}
+		jobs_cv.notify_all();
+		io.join();
+	}
+
+	// false once a read or write of the file has failed, the tiles involved hold garbage then
+	bool good() const { return !failed; }
+
+	// pointer to the tile, valid until the matching release
+	T* acquire(size_t id, bool write) {
+		std::unique_lock<std::mutex> lock(mutex);
+		check();
+		auto it = slots.find(id);
+		if (it == slots.end()) {
+			Slot& s = insert(id, lock);
+			s.pins = 1;
+			if (auto w = writing.find(id); w != writing.end()) {
+				s.data = *w->second;
+				s.ready = true;
+			} else {
+				// loaded here, the slot is pinned and not ready, so nobody else touches it
+				lock.unlock();
+				bool ok = file.read_at(offset(id), s.data.data(), elems * sizeof(T));
+				lock.lock();
+				if (!ok)
+					failed = true;
+				s.ready = true;
+				ready_cv.notify_all();
+			}
+			it = slots.find(id);
+		} else {
+			it->second.pins++;
+			ready_cv.wait(lock, [&] { return it->second.ready; });
+		}
+		Slot& s = it->second;
+		if (failed) {
+			s.pins--;
+			check();
+		}
+		lru.splice(lru.begin(), lru, s.pos);
+		s.dirty = s.dirty || write;
+		return s.data.data();
+	}
+
+	void release(size_t id) {
+		std::lock_guard<std::mutex> lock(mutex);
+		slots.at(id).pins--;
+	}
+
+	// starts loading a tile on the I/O thread unless it is cached or the cache is full of pinned tiles
+	void prefetch(size_t id) {
+		std::unique_lock<std::mutex> lock(mutex);
+		if (slots.count(id) || writing.count(id) || !evict(lock))
+			return;
+		Slot& s = insert(id, lock);
+		s.pins = 1;
+		T* p = s.data.data();
+		enqueue([this, id, p] {
+			bool ok = file.read_at(offset(id), p, elems * sizeof(T));
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!ok)
+				failed = true;
+			Slot& s = slots.at(id);
+			s.ready = true;
+			s.pins--;
+			ready_cv.notify_all();
+		});
+	}
+
+	// writes every dirty tile and waits for the pending write-backs, throws if any I/O has failed
+	void flush() {
+		std::unique_lock<std::mutex> lock(mutex);
+		write_back(lock);
+		check();
+	}
+
+private:
+	struct Slot {
+		std::vector<T> data;
+		bool ready = false, dirty = false;
+		size_t pins = 0;
+		std::list<size_t>::iterator pos;
+	};
+
+	uint64_t offset(size_t id) const { return base + uint64_t(id) * elems * sizeof(T); }
+
+	void check() const {
+		if (failed)
+			throw std::ios_base::failure("I/O error in the file of a TiledMatrix");
+	}
+
+	// flush without throwing, for the destructor too
+	void write_back(std::unique_lock<std::mutex>& lock) {
+		done_cv.wait(lock, [&] { return pending == 0; });
+		for (auto& [id, s] : slots)
+			if (s.ready && s.dirty) {
+				if (!file.write_at(offset(id), s.data.data(), elems * sizeof(T)))
+					failed = true;
+				s.dirty = false;
+			}
+	}
+
+	// makes room for one tile, false if every cached tile is pinned
+	bool evict(std::unique_lock<std::mutex>&) {
+		if (slots.size() < capacity)
+			return true;
+		for (auto it = lru.end(); it != lru.begin();) {
+			--it;
+			Slot& s = slots.at(*it);
+			if (s.pins || !s.ready)
+				continue;
+			size_t id = *it;
+			if (s.dirty) {
+				// write-back on the I/O thread, loads of this tile copy the buffer meanwhile
+				auto buf = std::make_shared<std::vector<T>>(std::move(s.data));
+				writing[id] = buf;
+				enqueue([this, id, buf] {
+					bool ok = file.write_at(offset(id), buf->data(), elems * sizeof(T));
+					std::lock_guard<std::mutex> lock(mutex);
+					if (!ok)
+						failed = true;
+					if (auto w = writing.find(id); w != writing.end() && w->second == buf)
+						writing.erase(w);
+				});
+			}
+			lru.erase(it);
+			slots.erase(id);
+			return true;
+		}
+		return false;
+	}
+
+	// new slot at the front of the LRU list, over capacity if everything is pinned
+	Slot& insert(size_t id, std::unique_lock<std::mutex>& lock) {
+		evict(lock);
+		Slot& s = slots[id];
+		s.data.assign(elems, T(0));
+		lru.push_front(id);
+		s.pos = lru.begin();
+		return s;
+	}
+
+	// called with the mutex held
+	void enqueue(std::function<void()> job) {
+		pending++;
+		jobs.push_back(std::move(job));
+		jobs_cv.notify_one();
+	}
+
+	void io_loop() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			jobs_cv.wait(lock, [&] { return stop || !jobs.empty(); });
+			if (jobs.empty())
+				return;
+			auto job = std::move(jobs.front());
+			jobs.pop_front();
+			lock.unlock();
+			job();
+			lock.lock();
+			pending--;
+			done_cv.notify_all();
+		}
+	}
+
+	TileFile& file;
+	uint64_t base;
+	size_t elems, capacity;
+	std::unordered_map<size_t, Slot> slots;
+	std::list<size_t> lru;
+	std::unordered_map<size_t, std::shared_ptr<std::vector<T>>> writing;
+	std::deque<std::function<void()>> jobs;
+	size_t pending = 0;
+	bool stop = false;
+	std::atomic<bool> failed{ false };
+	std::mutex mutex;
+	std::condition_variable ready_cv, jobs_cv, done_cv;
+	std::thread io;
+};
+
+inline std::string temporary_tile_path() {
+	static std::atomic<uint64_t> counter{ 0 };
+	static const uint64_t salt = std::random_device()();
+	auto name = "la_tiled_" + std::to_string(salt) + "_" + std::to_string(counter++) + ".bin";
+	return (std::filesystem::temp_directory_path() / name).string();
+}
+
+} // namespace detail
+
+template<conc_binary T>
+requires binary_codec<T>::fixed
+class TiledMatrix {
+public:
+	// tile pinned in the cache while the handle lives; U is const T for read-only access
+	template<class U>
+	class TileHandle {
+	public:
+		TileHandle(detail::TileCache<T>* cache, size_t id, MatrixView<U> v) : cache(cache), id(id), v(v) {}
+		TileHandle(TileHandle&& other) noexcept : cache(std::exchange(other.cache, nullptr)), id(other.id), v(other.v) {}
+		TileHandle(const TileHandle&) = delete;
+		TileHandle& operator=(const TileHandle&) = delete;
+		~TileHandle() {
+			if (cache)
+				cache->release(id);
+		}
+		MatrixView<U> view() const { return v; }
+	private:
+		detail::TileCache<T>* cache;
+		size_t id;
+		MatrixView<U> v;
+	};
+
+	// zero n x m matrix in a new file at path
+	TiledMatrix(const std::string& path, size_t n, size_t m, size_t tile = OOC_TILE, size_t cache_bytes = OOC_CACHE_BYTES) {
+		create(path, n, m, tile, cache_bytes);
+	}
+	// zero n x m matrix in a temporary file removed together with the object
+	TiledMatrix(size_t n, size_t m, size_t tile = OOC_TILE, size_t cache_bytes = OOC_CACHE_BYTES) {
+		create(detail::temporary_tile_path(), n, m, tile, cache_bytes);
+		st->temporary = true;
+	}
+	// copy of a matrix in memory
+	TiledMatrix(const std::string& path, const Matrix<T>& a, size_t tile = OOC_TILE, size_t cache_bytes = OOC_CACHE_BYTES)
+		: TiledMatrix(path, a.size().first, a.size().second, tile, cache_bytes) {
+		write_block(0, 0, a.view());
+	}
+	// an existing tiled file, check is_open()
+	explicit TiledMatrix(const std::string& path, size_t cache_bytes = OOC_CACHE_BYTES) {
+		st = std::make_unique<State>();
+		BinaryHeader h;
+		if (!st->file.open(path, false) || !st->file.read_at(0, &h, sizeof(h)) || !h.valid() || h.tile == 0
+			|| h.layout != uint8_t(BinaryLayout::tiled) || h.elem_size != sizeof(T) || h.dtype_name() != binary_codec<T>::name()) {
+			st.reset();
+			return;
+		}
+		init(path, h.rows, h.cols, h.tile, cache_bytes);
+	}
+
+	TiledMatrix(TiledMatrix&&) noexcept = default;
+	TiledMatrix& operator=(TiledMatrix&&) noexcept = default;
+
+	bool is_open() const { return st != nullptr; }
+	const std::string& path() const { return st->path; }
+	std::pair<size_t, size_t> size() const { return { st->n, st->m }; }
+	size_t tile_size() const { return st->b; }
+	size_t tile_rows() const { return (st->n + st->b - 1) / st->b; }
+	size_t tile_cols() const { return (st->m + st->b - 1) / st->b; }
+
+	TileHandle<T> tile(size_t ti, size_t tj) { return handle<T>(ti, tj, true); }
+	TileHandle<const T> tile(size_t ti, size_t tj) const { return handle<const T>(ti, tj, false); }
+	void prefetch(size_t ti, size_t tj) const { st->cache->prefetch(ti * tile_cols() + tj); }
+	// prefetches the tiles covering rows [i, i + rows) and columns [j, j + cols)
+	void prefetch_block(size_t i, size_t j, size_t rows, size_t cols) const {
+		for_tiles(i, j, rows, cols, [&](size_t ti, size_t tj, size_t, size_t, size_t, size_t, size_t, size_t) { prefetch(ti, tj); });
+	}
+
+	void read_block(size_t i, size_t j, MatrixView<T> dst) const {
+		prefetch_block(i, j, dst.rows(), dst.cols());
+		for_tiles(i, j, dst.rows(), dst.cols(), [&](size_t ti, size_t tj, size_t r0, size_t c0, size_t h, size_t w, size_t di, size_t dj) {
+			copy_view(tile(ti, tj).view().block(r0, c0, h, w), dst.block(di, dj, h, w));
+		});
+	}
+	void write_block(size_t i, size_t j, MatrixView<const T> src) {
+		for_tiles(i, j, src.rows(), src.cols(), [&](size_t ti, size_t tj, size_t r0, size_t c0, size_t h, size_t w, size_t di, size_t dj) {
+			copy_view(src.block(di, dj, h, w), tile(ti, tj).view().block(r0, c0, h, w));
+		});
+	}
+
+	T get(size_t i, size_t j) const { return tile(i / st->b, j / st->b).view()(i % st->b, j % st->b); }
+	void set(size_t i, size_t j, const T& x) { tile(i / st->b, j / st->b).view()(i % st->b, j % st->b) = x; }
+
+	Matrix<T> to_matrix() const {
+		Matrix<T> res(st->n, st->m);
+		read_block(0, 0, res.view());
+		return res;
+	}
+
+	// writes the dirty tiles to the file, throws std::ios_base::failure if any I/O has failed
+	void flush() { st->cache->flush(); }
+	// false once a read or write of the file has failed
+	bool good() const { return st->cache->good(); }
+
+	TiledMatrix copy(const std::string& path) const;
+	TiledMatrix transpose(const std::string& path) const;
+	TiledMatrix transpose() const;
+	// row echelon form, U of lu_inplace with zeros below the pivots
+	TiledMatrix to_stepped_view(const std::string& path) const;
+	TiledMatrix to_stepped_view() const;
+
+private:
+	struct State {
+		detail::TileFile file;
+		std::unique_ptr<detail::TileCache<T>> cache;
+		std::string path;
+		size_t n = 0, m = 0, b = 0;
+		bool temporary = false;
+		~State() {
+			// the cache writes back through the file
+			cache.reset();
+			file.close();
+			if (temporary) {
+				std::error_code ec;
+				std::filesystem::remove(path, ec);
+			}
+		}
+	};
+
+	void create(const std::string& path, size_t n, size_t m, size_t b, size_t cache_bytes) {
+		assertm(b > 0, "Wrong tile size in TiledMatrix");
+		st = std::make_unique<State>();
+		size_t tiles = ((n + b - 1) / b) * ((m + b - 1) / b);
+		BinaryHeader h;
+		h.layout = uint8_t(BinaryLayout::tiled);
+		h.elem_size = uint32_t(sizeof(T));
+		h.rows = n;
+		h.cols = m;
+		h.tile = uint32_t(b);
+		std::string name = binary_codec<T>::name();
+		std::copy(name.begin(), name.end(), h.dtype);
+		bool ok = st->file.open(path, true, sizeof(h) + uint64_t(tiles) * b * b * sizeof(T)) && st->file.write_at(0, &h, sizeof(h));
+		assertm(ok, "Cannot create the file of a TiledMatrix");
+		init(path, n, m, b, cache_bytes);
+	}
+
+	void init(const std::string& path, size_t n, size_t m, size_t b, size_t cache_bytes) {
+		st->path = path;
+		st->n = n;
+		st->m = m;
+		st->b = b;
+		st->cache = std::make_unique<detail::TileCache<T>>(st->file, sizeof(BinaryHeader), b * b, cache_bytes / (b * b * sizeof(T)));
+	}
+
+	template<class U>
+	TileHandle<U> handle(size_t ti, size_t tj, bool write) const {
+		assertm(ti < tile_rows() && tj < tile_cols(), "Tile index out of range in TiledMatrix");
+		size_t id = ti * tile_cols() + tj, b = st->b;
+		T* p = st->cache->acquire(id, write);
+		return TileHandle<U>(st->cache.get(), id, MatrixView<U>(p, std::min(b, st->n - ti * b), std::min(b, st->m - tj * b), b));
+	}
+
+	// f(ti, tj, rows and cols inside the tile, size, position in the block) for each tile of the block
+	template<class F>
+	void for_tiles(size_t i, size_t j, size_t rows, size_t cols, F&& f) const {
+		assertm(i + rows <= st->n && j + cols <= st->m, "Wrong block in TiledMatrix");
+		size_t b = st->b;
+		for (size_t r = i; r < i + rows; r = (r / b + 1) * b)
+			for (size_t c = j; c < j + cols; c = (c / b + 1) * b) {
+				size_t h = std::min((r / b + 1) * b, i + rows) - r, w = std::min((c / b + 1) * b, j + cols) - c;
+				f(r / b, c / b, r % b, c % b, h, w, r - i, c - j);
+			}
+	}
+
+	std::unique_ptr<State> st;
+};
+
+// c = a * b tile by tile, the next pair of tiles is prefetched while gemm runs
+template<class T>
+void multiply(const TiledMatrix<T>& a, const TiledMatrix<T>& b, TiledMatrix<T>& c) {
+	assertm(a.size().second == b.size().first && c.size() == std::make_pair(a.size().first, b.size().second)
+		&& a.tile_size() == b.tile_size() && a.tile_size() == c.tile_size(), "Wrong matrix sizes in multiply");
+	size_t tn = a.tile_rows(), tk = a.tile_cols(), tm = b.tile_cols();
+	for (size_t i = 0; i < tn; i++)
+		for (size_t j = 0; j < tm; j++) {
+			auto ct = c.tile(i, j);
+			for (size_t r = 0; r < ct.view().rows(); r++)
+				std::fill(ct.view().row(r).data(), ct.view().row(r).data() + ct.view().cols(), T(0));
+			for (size_t k = 0; k < tk; k++) {
+				if (k + 1 < tk) {
+					a.prefetch(i, k + 1);
+					b.prefetch(k + 1, j);
+				} else if (j + 1 < tm) {
+					a.prefetch(i, 0);
+					b.prefetch(0, j + 1);
+				}
+				auto at = a.tile(i, k);
+				auto bt = b.tile(k, j);
+				gemm<T>(at.view(), bt.view(), ct.view());
+			}
+		}
+}
+
+template<class T>
+TiledMatrix<T> operator*(const TiledMatrix<T>& a, const TiledMatrix<T>& b) {
+	TiledMatrix<T> c(a.size().first, b.size().second, a.tile_size());
+	multiply(a, b, c);
+	return c;
+}
+
+template<conc_binary T> requires binary_codec<T>::fixed
+TiledMatrix<T> TiledMatrix<T>::copy(const std::string& path) const {
+	TiledMatrix res(path, st->n, st->m, st->b);
+	for (size_t i = 0; i < tile_rows(); i++)
+		for (size_t j = 0; j < tile_cols(); j++) {
+			if (j + 1 < tile_cols())
+				prefetch(i, j + 1);
+			copy_view(tile(i, j).view(), res.tile(i, j).view());
+		}
+	return res;
+}
+
+template<conc_binary T> requires binary_codec<T>::fixed
+TiledMatrix<T> TiledMatrix<T>::transpose(const std::string& path) const {
+	TiledMatrix res(path, st->m, st->n, st->b);
+	for (size_t i = 0; i < tile_rows(); i++)
+		for (size_t j = 0; j < tile_cols(); j++) {
+			if (j + 1 < tile_cols())
+				prefetch(i, j + 1);
+			transpose_view(tile(i, j).view(), res.tile(j, i).view());
+		}
+	return res;
+}
+
+template<conc_binary T> requires binary_codec<T>::fixed
+TiledMatrix<T> TiledMatrix<T>::transpose() const {
+	TiledMatrix res = transpose(detail::temporary_tile_path());
+	res.st->temporary = true;
+	return res;
+}
+
+// PA = LU in place as in LUDecomposition: L (unit, below the pivots) and U (pivot rows)
+// packed, columns without a pivot skipped
+struct TiledLUInfo {
+	// row i of PA is row perm[i] of A
+	std::vector<size_t> perm;
+	// column of the i-th pivot
+	std::vector<size_t> cols;
+	bool odd_swaps = false;
+	size_t rank() const { return cols.size(); }
+};
+
+// keep_l = false leaves zeros instead of L, which is the row echelon form
+template<class T>
+TiledLUInfo lu_inplace(TiledMatrix<T>& a, bool keep_l = true) {
+	constexpr bool inexact = std::is_floating_point_v<T>;
+	auto [n, m] = a.size();
+	size_t b = a.tile_size();
+	TiledLUInfo info;
+	info.perm.resize(n);
+	std::iota(info.perm.begin(), info.perm.end(), size_t(0));
+
+	T tolerance = T(0);
+	if constexpr (inexact) {
+		T max_abs = T(0);
+		for (size_t i = 0; i < a.tile_rows(); i++)
+			for (size_t j = 0; j < a.tile_cols(); j++) {
+				auto t = std::as_const(a).tile(i, j);
+				for (size_t r = 0; r < t.view().rows(); r++)
+					for (const T& x : t.view().row(r))
+						max_abs = std::max(max_abs, std::abs(x));
+			}
+		tolerance = max_abs * T(std::max(n, m)) * std::numeric_limits<T>::epsilon();
+	}
+	auto is_zero = [&](const T& x) {
+		if constexpr (inexact)
+			return std::abs(x) <= tolerance;
+		else
+			return x == T(0);
+	};
+
+	for (size_t c0 = 0; c0 < m && info.rank() < n; c0 += b) {
+		size_t c1 = std::min(m, c0 + b), r0 = info.rank(), h = n - r0;
+		Matrix<T> panel(h, c1 - c0);
+		a.read_block(r0, c0, panel.view());
+
+		// unblocked elimination of the panel, pivots chosen as in LUDecomposition
+		std::vector<std::pair<size_t, size_t>> swaps;
+		for (size_t c = 0; c < c1 - c0 && info.rank() < n; c++) {
+			size_t r = info.rank() - r0, p = h;
+			for (size_t i = r; i < h; i++) {
+				if (is_zero(panel[i][c]))
+					continue;
+				if constexpr (inexact) {
+					if (p == h || std::abs(panel[i][c]) > std::abs(panel[p][c]))
+						p = i;
+				} else {
+					p = i;
+					break;
+				}
+			}
+			if (p == h)
+				continue;
+			if (p != r) {
+				panel[p].swap(panel[r]);
+				std::swap(info.perm[r0 + p], info.perm[r0 + r]);
+				info.odd_swaps = !info.odd_swaps;
+				swaps.push_back({ r, p });
+			}
+			info.cols.push_back(c0 + c);
+			const T pivot = panel[r][c];
+			for (size_t i = r + 1; i < h; i++) {
+				if (panel[i][c] == T(0))
+					continue;
+				T l = panel[i][c] / pivot;
+				panel[i][c] = l;
+				vec_axpy(T(-l), panel[r].data() + c + 1, panel[i].data() + c + 1, c1 - c0 - c - 1);
+			}
+		}
+		size_t k = info.rank() - r0;
+
+		// L21 gathered as in LUDecomposition::update_trailing
+		Matrix<T> l21(h - k, k);
+		for (size_t i = k; i < h; i++)
+			for (size_t s = 0; s < k; s++)
+				l21[i - k][s] = panel[i][info.cols[r0 + s] - c0];
+
+		// column strips: row swaps everywhere, U12 = L11^-1 A12 and A22 -= L21 U12 on the right;
+		// left of the panel only L has to be permuted
+		size_t first = keep_l ? 0 : c1;
+		if (!swaps.empty() || k > 0)
+			for (size_t s0 = first; s0 < m; s0 += b) {
+				if (s0 == c0)
+					continue;
+				size_t s1 = std::min(m, s0 + b), w = s1 - s0;
+				size_t next = s0 + b == c0 ? c1 : s0 + b;
+				if (next < m)
+					a.prefetch_block(r0, next, h, std::min(m, next + b) - next);
+				Matrix<T> strip(h, w);
+				a.read_block(r0, s0, strip.view());
+				for (auto [r, p] : swaps)
+					strip[r].swap(strip[p]);
+				if (s0 >= c1 && k > 0) {
+					for (size_t t = 1; t < k; t++)
+						for (size_t s = 0; s < t; s++) {
+							const T& l = panel[t][info.cols[r0 + s] - c0];
+							if (l != T(0))
+								vec_axpy(T(-l), strip[s].data(), strip[t].data(), w);
+						}
+					if (h > k)
+						gemm<T>(l21.view(), strip.block(0, 0, k, w), strip.block(k, 0, h - k, w), T(-1));
+				}
+				a.write_block(r0, s0, strip.view());
+			}
+
+		if (!keep_l)
+			for (size_t s = 0; s < k; s++)
+				for (size_t i = s + 1; i < h; i++)
+					panel[i][info.cols[r0 + s] - c0] = T(0);
+		a.write_block(r0, c0, panel.view());
+	}
+	return info;
+}
+
+template<conc_binary T> requires binary_codec<T>::fixed
+TiledMatrix<T> TiledMatrix<T>::to_stepped_view(const std::string& path) const {
+	TiledMatrix res = copy(path);
+	lu_inplace(res, false);
+	return res;
+}
+
+template<conc_binary T> requires binary_codec<T>::fixed
+TiledMatrix<T> TiledMatrix<T>::to_stepped_view() const {
+	TiledMatrix res = to_stepped_view(detail::temporary_tile_path());
+	res.st->temporary = true;
+	return res;
+}
@@ -1,27 +1,384 @@
 #pragma once
 
 #include <algorithm>
+#include <bit>
+#include <complex>
+#include <cstdint>
 #include <iostream>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <initializer_list>
+#include "allocator.h"
 #include "assertm.h"
+#include "instrumentation.h"
+#include "mconcepts.h"
+#include "modint.h"
+#include "simd.h"
+#include "thread_pool.h"
 
-template <typename T>
+// Fast arithmetic on coefficient vectors, lowest power first.
+// Products are schoolbook below POLY_KARATSUBA, Karatsuba above it, and a transform above
+// POLY_FFT when the type has one: NTT for ModInt<P> with a large power of two dividing P - 1,
+// complex FFT for floating types. Over fields, division with a quotient of at least
+// POLY_NEWTON terms multiplies by a power series inverse found by Newton's iteration,
+// and gcd of exact polynomials uses the half-GCD above POLY_HALF_GCD, so all of them cost
+// O(M(n) log n) or less.
+// Evaluation at many points and interpolation go through a subproduct tree in O(M(n) log n):
+// remainders modulo the node products are passed down until a node has at most
+// POLY_MULTIPOINT_LEAF points, which are finished by Horner's rule. Floating types always use
+// the vectorized Horner loop, remainders by products of (x - x_i) lose all precision for them.
+
+constexpr size_t POLY_KARATSUBA = 32;
+constexpr size_t POLY_FFT = 64;
+constexpr size_t POLY_NEWTON = 64;
+constexpr size_t POLY_HALF_GCD = 64;
+constexpr size_t POLY_MULTIPOINT = 64;
+constexpr size_t POLY_MULTIPOINT_LEAF = 16;
+
+namespace detail {
+
+// out[0, n + m - 1) += a * b
+template<class T>
+void poly_mul_school(const T* a, size_t n, const T* b, size_t m, T* out) {
+	for (size_t i = 0; i < n; i++) {
+		if (a[i] == T(0))
+			continue;
+		for (size_t j = 0; j < m; j++)
+			out[i + j] += a[i] * b[j];
+	}
+}
+
+// out[0, 2n - 1) += a * b for two operands of n coefficients
+template<class T>
+void poly_karatsuba(const T* a, const T* b, size_t n, T* out) {
+	if (n < POLY_KARATSUBA)
+		return poly_mul_school(a, n, b, n, out);
+	// a = a0 + x^h a1, b = b0 + x^h b1, a0 b1 + a1 b0 = (a0 + a1)(b0 + b1) - a0 b0 - a1 b1
+	size_t h = n / 2, h1 = n - h;
+	std::vector<T, ResourceAllocator<T>> z0(2 * h - 1, T(0)), z2(2 * h1 - 1, T(0)), sa(h1), sb(h1), z1(2 * h1 - 1, T(0));
+	poly_karatsuba(a, b, h, z0.data());
+	poly_karatsuba(a + h, b + h, h1, z2.data());
+	for (size_t i = 0; i < h1; i++) {
+		sa[i] = a[h + i] + (i < h ? a[i] : T(0));
+		sb[i] = b[h + i] + (i < h ? b[i] : T(0));
+	}
+	poly_karatsuba(sa.data(), sb.data(), h1, z1.data());
+	for (size_t i = 0; i < z0.size(); i++) {
+		out[i] += z0[i];
+		z1[i] -= z0[i];
+	}
+	for (size_t i = 0; i < z2.size(); i++) {
+		out[2 * h + i] += z2[i];
+		z1[i] -= z2[i];
+	}
+	for (size_t i = 0; i < z1.size(); i++)
+		out[h + i] += z1[i];
+}
+
+template<class T>
+struct poly_fft {
+	static constexpr bool enabled = false;
+};
+
+inline void fft(std::vector<std::complex<double>>& a, bool invert) {
+	size_t n = a.size();
+	for (size_t i = 1, j = 0; i < n; i++) {
+		size_t bit = n >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j)
+			std::swap(a[i], a[j]);
+	}
+	const double pi = 3.14159265358979323846;
+	std::vector<std::complex<double>> w;
+	for (size_t len = 2; len <= n; len <<= 1) {
+		// roots are computed directly, not by repeated multiplication, to keep the error low
+		w.resize(len / 2);
+		for (size_t k = 0; k < len / 2; k++)
+			w[k] = std::polar(1.0, (invert ? -2 : 2) * pi * double(k) / double(len));
+		for (size_t i = 0; i < n; i += len)
+			for (size_t k = 0; k < len / 2; k++) {
+				auto u = a[i + k], v = a[i + k + len / 2] * w[k];
+				a[i + k] = u + v;
+				a[i + k + len / 2] = u - v;
+			}
+	}
+	if (invert)
+		for (auto& x : a)
+			x /= double(n);
+}
+
+template<std::floating_point T>
+struct poly_fft<T> {
+	static constexpr bool enabled = true;
+	static bool fits(size_t) { return true; }
+	template<class A>
+	static std::vector<T, A> mul(const std::vector<T, A>& a, const std::vector<T, A>& b) {
+		size_t need = a.size() + b.size() - 1, n = std::bit_ceil(need);
+		// a in the real part and b in the imaginary part, then (a + ib)^2 = a^2 - b^2 + 2iab
+		std::vector<std::complex<double>> f(n);
+		for (size_t i = 0; i < a.size(); i++)
+			f[i].real(double(a[i]));
+		for (size_t i = 0; i < b.size(); i++)
+			f[i].imag(double(b[i]));
+		fft(f, false);
+		for (auto& x : f)
+			x *= x;
+		fft(f, true);
+		std::vector<T, A> res(need);
+		for (size_t i = 0; i < need; i++)
+			res[i] = T(f[i].imag() / 2);
+		return res;
+	}
+};
+
+// smallest generator of the multiplicative group modulo the prime P
+template<uint32_t P>
+ModInt<P> ntt_generator() {
+	static const ModInt<P> g = [] {
+		std::vector<uint32_t> factors;
+		uint32_t x = P - 1;
+		for (uint32_t d = 2; d * d <= x; d++)
+			if (x % d == 0) {
+				factors.push_back(d);
+				while (x % d == 0)
+					x /= d;
+			}
+		if (x > 1)
+			factors.push_back(x);
+		for (uint32_t c = 2;; c++) {
+			bool ok = true;
+			for (uint32_t q : factors)
+				ok = ok && ModInt<P>(c).pow((P - 1) / q) != ModInt<P>(1);
+			if (ok)
+				return ModInt<P>(c);
+		}
+	}();
+	return g;
+}
+
+template<uint32_t P, class A>
+void ntt(std::vector<ModInt<P>, A>& a, bool invert) {
+	using M = ModInt<P>;
+	size_t n = a.size();
+	for (size_t i = 1, j = 0; i < n; i++) {
+		size_t bit = n >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j)
+			std::swap(a[i], a[j]);
+	}
+	std::vector<M> w;
+	for (size_t len = 2; len <= n; len <<= 1) {
+		M root = ntt_generator<P>().pow((P - 1) / len);
+		if (invert)
+			root = root.inv();
+		w.assign(len / 2, M(1));
+		for (size_t k = 1; k < len / 2; k++)
+			w[k] = w[k - 1] * root;
+		for (size_t i = 0; i < n; i += len)
+			for (size_t k = 0; k < len / 2; k++) {
+				M u = a[i + k], v = a[i + k + len / 2] * w[k];
+				a[i + k] = u + v;
+				a[i + k + len / 2] = u - v;
+			}
+	}
+	if (invert) {
+		M inv = M(n).inv();
+		for (auto& x : a)
+			x *= inv;
+	}
+}
+
+template<uint32_t P>
+struct poly_fft<ModInt<P>> {
+	// transforms of length 2^s need 2^s | P - 1
+	static constexpr bool enabled = std::countr_zero(P - 1) >= 10;
+	static bool fits(size_t need) { return std::bit_ceil(need) <= (size_t(1) << std::countr_zero(P - 1)); }
+	template<class A>
+	static std::vector<ModInt<P>, A> mul(std::vector<ModInt<P>, A> a, std::vector<ModInt<P>, A> b) {
+		size_t need = a.size() + b.size() - 1, n = std::bit_ceil(need);
+		a.resize(n);
+		b.resize(n);
+		ntt(a, false);
+		ntt(b, false);
+		for (size_t i = 0; i < n; i++)
+			a[i] *= b[i];
+		ntt(a, true);
+		a.resize(need);
+		return a;
+	}
+};
+
+// the result is allocated by a default-constructed A, the scratch from the current resource
+template<class T, class A>
+std::vector<T, A> poly_mul(const std::vector<T, A>& a, const std::vector<T, A>& b) {
+	if (a.empty() || b.empty())
+		return {};
+	size_t n = a.size(), m = b.size();
+	if (std::min(n, m) < POLY_KARATSUBA) {
+		std::vector<T, A> res(n + m - 1, T(0));
+		poly_mul_school(a.data(), n, b.data(), m, res.data());
+		return res;
+	}
+	if constexpr (poly_fft<T>::enabled)
+		if (std::min(n, m) >= POLY_FFT && poly_fft<T>::fits(n + m - 1))
+			return poly_fft<T>::mul(a, b);
+	// Karatsuba on slices of the longer operand as long as the shorter one
+	const std::vector<T, A>& x = n >= m ? a : b;
+	const std::vector<T, A>& y = n >= m ? b : a;
+	size_t k = y.size();
+	std::vector<T, A> res(n + m - 1, T(0));
+	std::vector<T, ResourceAllocator<T>> slice(k);
+	for (size_t s = 0; s < x.size(); s += k) {
+		size_t len = std::min(k, x.size() - s);
+		std::fill(slice.begin(), slice.end(), T(0));
+		std::copy(x.begin() + s, x.begin() + s + len, slice.begin());
+		std::vector<T, ResourceAllocator<T>> part(2 * k - 1, T(0));
+		poly_karatsuba(slice.data(), y.data(), k, part.data());
+		for (size_t i = 0; i < part.size() && s + i < res.size(); i++)
+			res[s + i] += part[i];
+	}
+	return res;
+}
+
+// first k coefficients of 1 / f, f[0] must be invertible:
+// g_{2l} = g_l (2 - f g_l) mod x^{2l}
+template<class T, class A>
+std::vector<T, A> poly_inverse(const std::vector<T, A>& f, size_t k) {
+	std::vector<T, A> g{ T(1) / f[0] };
+	for (size_t l = 1; l < k; l *= 2) {
+		std::vector<T, A> fl(f.begin(), f.begin() + std::min(f.size(), 2 * l));
+		std::vector<T, A> e = poly_mul(fl, g);
+		e.resize(2 * l, T(0));
+		for (auto& x : e)
+			x = -x;
+		e[0] += T(2);
+		g = poly_mul(g, e);
+		g.resize(2 * l, T(0));
+	}
+	g.resize(k, T(0));
+	return g;
+}
+
+} // namespace detail
+
+// coefficients come from Alloc, see allocator.h
+template<class T, class Alloc>
 class Polynomial {
 private:
-	std::vector<T> poly;
+	using storage = std::vector<T, Alloc>;
+
+	storage poly;
 	void normalize() {
 		while (poly.size() > 1 && poly.back() == T(0))
 			poly.pop_back();
+		if (poly.empty())
+			poly.push_back(T(0));
+	}
+
+	// quotient and remainder, the quotient coefficients are lead(a) / lead(b) at every step
+	static std::pair<Polynomial, Polynomial> divmod(const Polynomial& a, const Polynomial& b) {
+		assertm(b.Degree() != -1, "Division by 0-polynomial");
+		int n = a.Degree(), m = b.Degree();
+		if (n < m)
+			return { Polynomial(T(0)), a };
+		size_t k = size_t(n - m + 1);
+		if constexpr (is_field<T>::value) {
+			if (k >= POLY_NEWTON && m > 0) {
+				// rev(q) = rev(a) / rev(b) mod x^k, then r = a - q b
+				storage ra(a.poly.rbegin(), a.poly.rbegin() + k), rb(b.poly.rbegin(), b.poly.rend());
+				storage rq = detail::poly_mul(ra, detail::poly_inverse(rb, k));
+				rq.resize(k);
+				storage q(rq.rbegin(), rq.rend());
+				storage qb = detail::poly_mul(q, b.poly);
+				storage r(m);
+				for (int i = 0; i < m; i++)
+					r[i] = a.poly[i] - qb[i];
+				return { Polynomial(std::move(q)), Polynomial(std::move(r)) };
+			}
+		}
+		storage r = a.poly, q(k, T(0));
+		const T& lead = b.poly.back();
+		for (size_t i = k; i-- > 0;) {
+			T c = r[i + m] / lead;
+			q[i] = c;
+			if (c == T(0))
+				continue;
+			for (int j = 0; j <= m; j++)
+				r[i + j] -= c * b.poly[j];
+		}
+		r.resize(std::max(m, 1));
+		return { Polynomial(std::move(q)), Polynomial(std::move(r)) };
+	}
+
+	// coefficients of x^k and higher, divided by x^k
+	Polynomial div_xk(size_t k) const {
+		if (k >= poly.size())
+			return Polynomial(T(0));
+		return Polynomial(poly.begin() + k, poly.end());
+	}
+
+	// 2 x 2 matrix of polynomials acting on pairs (a, b)
+	struct Transform {
+		Polynomial a = T(1), b = T(0), c = T(0), d = T(1);
+		Transform operator*(const Transform& o) const {
+			return { a * o.a + b * o.c, a * o.b + b * o.d, c * o.a + d * o.c, c * o.b + d * o.d };
+		}
+		void apply(Polynomial& x, Polynomial& y) const {
+			Polynomial nx = a * x + b * y;
+			y = c * x + d * y;
+			x = std::move(nx);
+		}
+	};
+
+	// M with M (a, b) = (a', b'), where a', b' are consecutive remainders of the Euclidean
+	// algorithm and deg b' < ceil(deg a / 2) <= deg a', deg a > deg b
+	static Transform half_gcd(Polynomial a, Polynomial b) {
+		int m = (a.Degree() + 1) / 2;
+		if (b.Degree() < m)
+			return {};
+		Transform r = half_gcd(a.div_xk(m), b.div_xk(m));
+		r.apply(a, b);
+		if (b.Degree() < m)
+			return r;
+		auto [q, rem] = divmod(a, b);
+		Transform step{ T(0), T(1), T(1), -q };
+		a = std::move(b);
+		b = std::move(rem);
+		int k = 2 * m - a.Degree();
+		return half_gcd(a.div_xk(k), b.div_xk(k)) * step * r;
+	}
+
+	// p(q) on coefficients [l, l + len) of p, qp[i] = q^(2^i); the low half has a power of two terms
+	Polynomial compose(size_t l, size_t len, const std::vector<Polynomial>& qp) const {
+		if (len == 1)
+			return Polynomial((*this)[l]);
+		size_t h = std::bit_floor(len - 1);
+		return compose(l, h, qp) + compose(l + h, len - h, qp) * qp[std::countr_zero(h)];
 	}
 
 public:
-	Polynomial(const std::vector<T>& a): poly(a) { normalize(); }
+	Polynomial(storage&& a): poly(std::move(a)) { normalize(); }
+	template<class A>
+	Polynomial(const std::vector<T, A>& a): poly(a.begin(), a.end()) { normalize(); }
 	template <typename N>
 	Polynomial(N beg, N end): poly(beg, end) { normalize();	}
 	Polynomial(const T& a = 0): poly({ a }) {}
 	Polynomial(const Polynomial& p): poly(p.poly) {}
+	Polynomial(Polynomial&& p) noexcept : poly(std::move(p.poly)) {}
 	Polynomial(std::initializer_list<T> l) : poly(l) { normalize(); }
+	// between allocators the coefficients are copied
+	template<class A>
+	requires (!std::is_same_v<A, Alloc>)
+	Polynomial(const Polynomial<T, A>& p): poly(p.begin(), p.end()) {}
+
+	Polynomial& operator=(const Polynomial& p) { poly = p.poly; return *this; }
+	// steals the buffer when both use the same memory, copies otherwise
+	Polynomial& operator=(Polynomial&& p) noexcept { poly = std::move(p.poly); return *this; }
 
 	size_t size() const { return poly.size(); };
 	int Degree() const {
@@ -43,25 +400,23 @@ public:
 	bool operator!=(const Polynomial& other) const { return !(*this == other); }
 
 	Polynomial operator+(const Polynomial& other) const {
-		std::vector<T> p(std::max(size(), other.size()));
+		storage p(std::max(size(), other.size()));
 		for (size_t i = 0; i < poly.size() || i < other.size(); ++i)
 			p[i] = this->operator[](i) + other[i];
 		return p;
 	}
 
 	Polynomial operator-() const {
-		std::vector<T> a;
+		storage a;
+		a.reserve(poly.size());
 		for (size_t i = 0; i < poly.size(); ++i)
 			a.push_back(-poly[i]);
 		return a;
 	}
 
 	Polynomial operator*(const Polynomial& other) const {
-		std::vector<T> p(poly.size() + other.poly.size() - 1);
-		for (size_t i = 0; i < poly.size(); ++i)
-			for (size_t j = 0; j < other.poly.size(); ++j)
-				p[i + j] += poly[i] * other.poly[j];
-		return p;
+		LA_PHASE("Polynomial::operator*");
+		return detail::poly_mul(poly, other.poly);
 	}
 
 	Polynomial operator-(const Polynomial& other) const { return *this + (-other); }
@@ -75,71 +430,89 @@ public:
 		return poly[i];
 	}
 
-	typename std::vector<T>::iterator begin() { return poly.begin(); }
-	typename std::vector<T>::iterator end() { return poly.end(); }
-	typename std::vector<T>::const_iterator begin() const { return poly.begin(); }
-	typename std::vector<T>::const_iterator end() const { return poly.end(); }
+	typename storage::iterator begin() { return poly.begin(); }
+	typename storage::iterator end() { return poly.end(); }
+	typename storage::const_iterator begin() const { return poly.begin(); }
+	typename storage::const_iterator end() const { return poly.end(); }
 
-	friend bool operator==(const T& a, const Polynomial& b) { return b == a; }
-	friend bool operator!=(const T& a, const Polynomial& b) { return !(b == a);	}
+	friend bool operator==(const T& a, const Polynomial& b) { return b == Polynomial(a); }
+	friend bool operator!=(const T& a, const Polynomial& b) { return !(b == Polynomial(a)); }
 	friend Polynomial operator+(const T& a, const Polynomial& b) { return b + a; };
 	friend Polynomial operator-(const T& a, const Polynomial& b) { return -b + a; }
 	friend Polynomial operator*(const T& a, const Polynomial& b) { return b * a; }
 
 	T operator()(const T& a) const {
-		T result = poly[0];
-		T deg = a;
-		for (size_t i = 1; i < poly.size(); ++i) {
-			result += poly[i] * deg;
-			deg *= a;
-		}
+		T result = poly.back();
+		for (size_t i = poly.size() - 1; i-- > 0;)
+			result = result * a + poly[i];
 		return result;
 	}
 
+	// p(A) for a square matrix by Paterson-Stockmeyer, see matrix_poly.h
+	Matrix<T> operator()(const Matrix<T>& a) const;
+
+	// values at all points
+	std::vector<T> evaluate(const std::vector<T>& points) const;
+	// the polynomial of degree < n through (x[i], y[i]) for distinct x[i], needs a field
+	static Polynomial interpolate(const std::vector<T>& x, const std::vector<T>& y);
+
+	Polynomial derivative() const {
+		if (poly.size() == 1)
+			return Polynomial(T(0));
+		storage d(poly.size() - 1);
+		for (size_t i = 1; i < poly.size(); ++i)
+			d[i - 1] = poly[i] * T(int(i));
+		return d;
+	}
+
+	// composition p(q): halves of p are composed recursively and joined with q^(2^i),
+	// O(M(N) log N) for N = deg p * deg q
 	Polynomial operator&(const Polynomial& other) const {
-		Polynomial p(other), result(poly[0]);
-		for (size_t i = 1; i < poly.size(); ++i) {
-			result += poly[i] * p;
-			p *= other;
-		}
-		return result;
+		LA_PHASE("Polynomial::operator&");
+		size_t len = std::bit_ceil(poly.size());
+		std::vector<Polynomial> qp{ other };
+		while ((size_t(1) << qp.size()) < len)
+			qp.push_back(qp.back() * qp.back());
+		return compose(0, poly.size(), qp);
 	}
 
 	Polynomial operator/(const Polynomial& other) const {
-		assertm(other != 0, "Division by 0-polynomial");
-		Polynomial a(*this);
-		std::vector<T> result(poly.size() + 1 - other.poly.size()), monomial = result;
-		monomial.back() = T(1);
-		while (a.Degree() >= other.Degree()) {
-			result[a.Degree() - other.Degree()] = a.poly.back() / other.poly.back();
-			Polynomial q(monomial);
-			a -= q * other * result[a.Degree() - other.Degree()];
-			monomial.pop_back();
-			if (!monomial.empty())
-				monomial.back() = T(1);
-		}
-		return result;
+		LA_PHASE("Polynomial::operator/");
+		return divmod(*this, other).first;
 	}
-
 	Polynomial operator%(const Polynomial& other) const {
-		return *this - (*this / other) * other;
+		LA_PHASE("Polynomial::operator%");
+		return divmod(*this, other).second;
 	}
 
+	// monic gcd, needs a field
 	Polynomial operator,(const Polynomial& other) const {
+		static_assert(is_field<T>::value, "Polynomial gcd needs a field");
+		LA_PHASE("Polynomial::gcd");
 		Polynomial a(*this), b(other);
-		while (a.Degree() != -1 && b.Degree() != -1) {
-			if (a.Degree() > b.Degree() ||
-				(a.Degree() == b.Degree() && a.poly > b.poly))
-				a = a % b;
-			else
-				b = b % a;
+		if (a.Degree() < b.Degree())
+			std::swap(a, b);
+		while (b.Degree() != -1) {
+			// half_gcd needs deg a > deg b and leading coefficients that cancel exactly,
+			// so equal degrees take one Euclid step first and floating types never use it
+			if (!std::is_floating_point_v<T> && a.Degree() > b.Degree()
+				&& b.Degree() >= int(POLY_HALF_GCD) && 2 * b.Degree() > a.Degree()) {
+				half_gcd(a, b).apply(a, b);
+			} else {
+				Polynomial r = a % b;
+				a = std::move(b);
+				b = std::move(r);
+			}
 		}
-		auto result = a + b;
-		result = result / result.polynomial.back();
-		return result;
+		if (a.Degree() == -1)
+			return a;
+		T lead = a.poly.back();
+		for (auto& x : a.poly)
+			x = x / lead;
+		return a;
 	}
 
-	friend std::ostream& operator<<(std::ostream& out, const Polynomial<T>& p) {
+	friend std::ostream& operator<<(std::ostream& out, const Polynomial& p) {
 		if (p.Degree() == -1) {
 			out << 0;
 		}
@@ -167,6 +540,94 @@ public:
 		return out;
 	}
 
-	friend Polynomial<T> gcd(const Polynomial<T>& a, const Polynomial<T>& b) { return (a, b); }
-	friend Polynomial<T> lcm(const Polynomial<T>& a, const Polynomial<T>& b) { return a * b / gcd(a, b); }
+	friend Polynomial gcd(const Polynomial& a, const Polynomial& b) { return (a, b); }
+	friend Polynomial lcm(const Polynomial& a, const Polynomial& b) { return a * b / gcd(a, b); }
 };
+
+// products of (x - x_i) over the segments of a binary split of the points, reusable for
+// evaluating several polynomials at the same points
+template<class T>
+class SubproductTree {
+public:
+	explicit SubproductTree(const std::vector<T>& points) : x(points), tree(4 * std::max<size_t>(points.size(), 1)) {
+		if (!x.empty())
+			build(1, 0, x.size());
+	}
+
+	// (x - x_0) ... (x - x_{n-1})
+	const Polynomial<T>& product() const { return tree[1]; }
+
+	std::vector<T> evaluate(const Polynomial<T>& p) const {
+		std::vector<T> res(x.size());
+		if (!x.empty())
+			evaluate(1, 0, x.size(), p, res);
+		return res;
+	}
+
+	// sum y_i M / ((x - x_i) M'(x_i)) for M = product()
+	Polynomial<T> interpolate(const std::vector<T>& y) const {
+		assertm(y.size() == x.size(), "Wrong number of values in interpolate");
+		if (x.empty())
+			return Polynomial<T>(T(0));
+		std::vector<T> w = evaluate(product().derivative());
+		for (size_t i = 0; i < w.size(); i++) {
+			assertm(w[i] != T(0), "Repeated points in interpolate");
+			w[i] = y[i] / w[i];
+		}
+		return combine(1, 0, x.size(), w);
+	}
+
+private:
+	void build(size_t v, size_t l, size_t r) {
+		if (r - l == 1) {
+			tree[v] = Polynomial<T>({ -x[l], T(1) });
+			return;
+		}
+		size_t mid = (l + r) / 2;
+		build(2 * v, l, mid);
+		build(2 * v + 1, mid, r);
+		tree[v] = tree[2 * v] * tree[2 * v + 1];
+	}
+
+	void evaluate(size_t v, size_t l, size_t r, Polynomial<T> rem, std::vector<T>& out) const {
+		if (rem.Degree() >= tree[v].Degree())
+			rem = rem % tree[v];
+		if (r - l <= POLY_MULTIPOINT_LEAF) {
+			std::vector<T> c(rem.begin(), rem.end());
+			vec_horner(c.data(), c.size(), x.data() + l, out.data() + l, r - l);
+			return;
+		}
+		size_t mid = (l + r) / 2;
+		evaluate(2 * v, l, mid, rem, out);
+		evaluate(2 * v + 1, mid, r, std::move(rem), out);
+	}
+
+	Polynomial<T> combine(size_t v, size_t l, size_t r, const std::vector<T>& w) const {
+		if (r - l == 1)
+			return Polynomial<T>(w[l]);
+		size_t mid = (l + r) / 2;
+		return combine(2 * v, l, mid, w) * tree[2 * v + 1] + combine(2 * v + 1, mid, r, w) * tree[2 * v];
+	}
+
+	std::vector<T> x;
+	std::vector<Polynomial<T>> tree;
+};
+
+template<class T, class Alloc>
+std::vector<T> Polynomial<T, Alloc>::evaluate(const std::vector<T>& points) const {
+	LA_PHASE("Polynomial::evaluate");
+	if (!std::is_floating_point_v<T> && points.size() >= POLY_MULTIPOINT && poly.size() >= POLY_MULTIPOINT)
+		return SubproductTree<T>(points).evaluate(*this);
+	std::vector<T> res(points.size());
+	parallel_for(0, points.size(), poly.size(), [&](size_t lo, size_t hi) {
+		vec_horner(poly.data(), poly.size(), points.data() + lo, res.data() + lo, hi - lo);
+	});
+	return res;
+}
+
+template<class T, class Alloc>
+Polynomial<T, Alloc> Polynomial<T, Alloc>::interpolate(const std::vector<T>& x, const std::vector<T>& y) {
+	static_assert(is_field<T>::value, "Polynomial interpolation needs a field");
+	LA_PHASE("Polynomial::interpolate");
+	return SubproductTree<T>(x).interpolate(y);
+}
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <iostream>
+#include <concepts>
 #include <initializer_list>
 #include <numeric>
 #include "assertm.h"
+#include "instrumentation.h"
 #include "mconcepts.h"
 
 template <conc_gcd T>
@@ -25,13 +27,19 @@ class Rational {
 public:
 	T n, m;
 
-	Rational(int n = 0, int m = 1) : n(n), m(m) { normalize(); }
+	Rational(const T& n = T(0), const T& m = T(1)) : n(n), m(m) { normalize(); }
+	template<std::integral I>
+	Rational(I n) : Rational(T(n)) {}
 
 	Rational operator+(const Rational& other) const { return { n * other.m + other.n * m, m * other.m }; }
 	Rational operator-(const Rational& other) const { return { n * other.m - other.n * m, m * other.m }; }
-	Rational operator*(const Rational& other) const { return { n * other.n, m * other.m }; }
+	Rational operator*(const Rational& other) const {
+		LA_COUNT_MUL(Rational, 1);
+		return { n * other.n, m * other.m };
+	}
 	Rational operator/(const Rational& other) const { 
 		assertm(other != 0, "Division by 0");
+		LA_COUNT_DIV(Rational, 1);
 		return { n * other.m, m * other.n };
 	}
 
@@ -51,11 +59,12 @@ public:
 
 	friend std::istream& operator>>(std::istream& in, Rational& a) {
 		in >> a.n;
-		char delim = getchar();
-		if (delim == '/')
+		if (in && in.peek() == '/') {
+			in.get();
 			in >> a.m;
-		else
+		} else {
 			a.m = T(1);
+		}
 		a.normalize();
 		return in;
 	}
@@ -69,11 +78,15 @@ public:
 private:
 	void normalize() {
 		if (m < T(0))
-			n = m * T(-1), m = m * T(-1);
-		T g = my_gcd(n, m);
+			n = n * T(-1), m = m * T(-1);
+		LA_COUNT_GCD(Rational, 1);
+		T g = my_gcd(n < T(0) ? -n : n, m);
 		if (g != T(0)) {
 			n = n / g;
 			m = m / g;
 		}
 	}
 };
+
+template<class T>
+struct instrument_counts_ops<Rational<T>> : std::true_type {};
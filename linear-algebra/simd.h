@@ -0,0 +1,357 @@
+#pragma once
+
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <type_traits>
+
+// Elementwise and reduction kernels over contiguous arrays:
+// add, sub, scale, axpy, dot, norm, and Horner evaluation of a polynomial at many points.
+// float and double use AVX-512 or AVX2 chosen at runtime by cpuid,
+// everything else (and non-x86 targets) uses plain loops.
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LA_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LA_TARGET(isa) __attribute__((target(isa)))
+#else
+#define LA_TARGET(isa)
+#endif
+
+enum class SimdLevel { scalar, avx2, avx512 };
+
+inline SimdLevel detect_simd_level() {
+#if defined(LA_SIMD_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return SimdLevel::scalar;
+	__cpuid(info, 1);
+	bool osxsave = info[2] & (1 << 27), avx = info[2] & (1 << 28), fma = info[2] & (1 << 12);
+	if (!osxsave || !avx || !fma)
+		return SimdLevel::scalar;
+	unsigned long long xcr0 = _xgetbv(0);
+	if ((xcr0 & 0x6) != 0x6)
+		return SimdLevel::scalar;
+	__cpuidex(info, 7, 0);
+	if ((info[1] & (1 << 16)) && (xcr0 & 0xe6) == 0xe6)
+		return SimdLevel::avx512;
+	if (info[1] & (1 << 5))
+		return SimdLevel::avx2;
+	return SimdLevel::scalar;
+#elif defined(LA_SIMD_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return SimdLevel::avx512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return SimdLevel::avx2;
+	return SimdLevel::scalar;
+#else
+	return SimdLevel::scalar;
+#endif
+}
+
+namespace detail {
+inline SimdLevel& current_simd_level() {
+	static SimdLevel level = detect_simd_level();
+	return level;
+}
+}
+
+inline SimdLevel simd_level() { return detail::current_simd_level(); }
+
+// lowers (never raises) the instruction set used by the kernels, e.g. to compare with the scalar path
+inline void set_simd_level(SimdLevel level) {
+	if (level <= detect_simd_level())
+		detail::current_simd_level() = level;
+}
+
+namespace detail {
+
+#ifdef LA_SIMD_X86
+struct SimdAvx2Double {
+	using scalar = double;
+	using reg = __m256d;
+	static constexpr size_t width = 4;
+	LA_TARGET("avx2,fma") static reg zero() { return _mm256_setzero_pd(); }
+	LA_TARGET("avx2,fma") static reg set1(double x) { return _mm256_set1_pd(x); }
+	LA_TARGET("avx2,fma") static reg load(const double* p) { return _mm256_loadu_pd(p); }
+	LA_TARGET("avx2,fma") static void store(double* p, reg x) { _mm256_storeu_pd(p, x); }
+	LA_TARGET("avx2,fma") static reg add(reg x, reg y) { return _mm256_add_pd(x, y); }
+	LA_TARGET("avx2,fma") static reg sub(reg x, reg y) { return _mm256_sub_pd(x, y); }
+	LA_TARGET("avx2,fma") static reg mul(reg x, reg y) { return _mm256_mul_pd(x, y); }
+	LA_TARGET("avx2,fma") static reg fmadd(reg x, reg y, reg z) { return _mm256_fmadd_pd(x, y, z); }
+	LA_TARGET("avx2,fma") static double hsum(reg x) {
+		__m128d s = _mm_add_pd(_mm256_castpd256_pd128(x), _mm256_extractf128_pd(x, 1));
+		return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+	}
+};
+
+struct SimdAvx2Float {
+	using scalar = float;
+	using reg = __m256;
+	static constexpr size_t width = 8;
+	LA_TARGET("avx2,fma") static reg zero() { return _mm256_setzero_ps(); }
+	LA_TARGET("avx2,fma") static reg set1(float x) { return _mm256_set1_ps(x); }
+	LA_TARGET("avx2,fma") static reg load(const float* p) { return _mm256_loadu_ps(p); }
+	LA_TARGET("avx2,fma") static void store(float* p, reg x) { _mm256_storeu_ps(p, x); }
+	LA_TARGET("avx2,fma") static reg add(reg x, reg y) { return _mm256_add_ps(x, y); }
+	LA_TARGET("avx2,fma") static reg sub(reg x, reg y) { return _mm256_sub_ps(x, y); }
+	LA_TARGET("avx2,fma") static reg mul(reg x, reg y) { return _mm256_mul_ps(x, y); }
+	LA_TARGET("avx2,fma") static reg fmadd(reg x, reg y, reg z) { return _mm256_fmadd_ps(x, y, z); }
+	LA_TARGET("avx2,fma") static float hsum(reg x) {
+		__m128 s = _mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+		s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+		return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+	}
+};
+
+struct SimdAvx512Double {
+	using scalar = double;
+	using reg = __m512d;
+	static constexpr size_t width = 8;
+	LA_TARGET("avx512f") static reg zero() { return _mm512_setzero_pd(); }
+	LA_TARGET("avx512f") static reg set1(double x) { return _mm512_set1_pd(x); }
+	LA_TARGET("avx512f") static reg load(const double* p) { return _mm512_loadu_pd(p); }
+	LA_TARGET("avx512f") static void store(double* p, reg x) { _mm512_storeu_pd(p, x); }
+	LA_TARGET("avx512f") static reg add(reg x, reg y) { return _mm512_add_pd(x, y); }
+	LA_TARGET("avx512f") static reg sub(reg x, reg y) { return _mm512_sub_pd(x, y); }
+	LA_TARGET("avx512f") static reg mul(reg x, reg y) { return _mm512_mul_pd(x, y); }
+	LA_TARGET("avx512f") static reg fmadd(reg x, reg y, reg z) { return _mm512_fmadd_pd(x, y, z); }
+	LA_TARGET("avx512f") static double hsum(reg x) { return _mm512_reduce_add_pd(x); }
+};
+
+struct SimdAvx512Float {
+	using scalar = float;
+	using reg = __m512;
+	static constexpr size_t width = 16;
+	LA_TARGET("avx512f") static reg zero() { return _mm512_setzero_ps(); }
+	LA_TARGET("avx512f") static reg set1(float x) { return _mm512_set1_ps(x); }
+	LA_TARGET("avx512f") static reg load(const float* p) { return _mm512_loadu_ps(p); }
+	LA_TARGET("avx512f") static void store(float* p, reg x) { _mm512_storeu_ps(p, x); }
+	LA_TARGET("avx512f") static reg add(reg x, reg y) { return _mm512_add_ps(x, y); }
+	LA_TARGET("avx512f") static reg sub(reg x, reg y) { return _mm512_sub_ps(x, y); }
+	LA_TARGET("avx512f") static reg mul(reg x, reg y) { return _mm512_mul_ps(x, y); }
+	LA_TARGET("avx512f") static reg fmadd(reg x, reg y, reg z) { return _mm512_fmadd_ps(x, y, z); }
+	LA_TARGET("avx512f") static float hsum(reg x) { return _mm512_reduce_add_ps(x); }
+};
+
+// The same kernels are stamped out once per instruction set, because the target
+// attribute cannot depend on a template parameter.
+#define LA_SIMD_KERNELS(ISA, TARGET) \
+template<class V> LA_TARGET(TARGET) \
+void simd_add_##ISA(const typename V::scalar* x, const typename V::scalar* y, typename V::scalar* out, size_t n) { \
+	size_t i = 0; \
+	for (; i + V::width <= n; i += V::width) \
+		V::store(out + i, V::add(V::load(x + i), V::load(y + i))); \
+	for (; i < n; i++) \
+		out[i] = x[i] + y[i]; \
+} \
+template<class V> LA_TARGET(TARGET) \
+void simd_sub_##ISA(const typename V::scalar* x, const typename V::scalar* y, typename V::scalar* out, size_t n) { \
+	size_t i = 0; \
+	for (; i + V::width <= n; i += V::width) \
+		V::store(out + i, V::sub(V::load(x + i), V::load(y + i))); \
+	for (; i < n; i++) \
+		out[i] = x[i] - y[i]; \
+} \
+template<class V> LA_TARGET(TARGET) \
+void simd_scale_##ISA(const typename V::scalar* x, typename V::scalar alpha, typename V::scalar* out, size_t n) { \
+	auto a = V::set1(alpha); \
+	size_t i = 0; \
+	for (; i + V::width <= n; i += V::width) \
+		V::store(out + i, V::mul(V::load(x + i), a)); \
+	for (; i < n; i++) \
+		out[i] = x[i] * alpha; \
+} \
+template<class V> LA_TARGET(TARGET) \
+void simd_axpy_##ISA(typename V::scalar alpha, const typename V::scalar* x, typename V::scalar* y, size_t n) { \
+	auto a = V::set1(alpha); \
+	size_t i = 0; \
+	for (; i + V::width <= n; i += V::width) \
+		V::store(y + i, V::fmadd(a, V::load(x + i), V::load(y + i))); \
+	for (; i < n; i++) \
+		y[i] += alpha * x[i]; \
+} \
+template<class V> LA_TARGET(TARGET) \
+typename V::scalar simd_dot_##ISA(const typename V::scalar* x, const typename V::scalar* y, size_t n) { \
+	/* four independent accumulators hide the fma latency */ \
+	auto s0 = V::zero(), s1 = V::zero(), s2 = V::zero(), s3 = V::zero(); \
+	size_t i = 0; \
+	for (; i + 4 * V::width <= n; i += 4 * V::width) { \
+		s0 = V::fmadd(V::load(x + i), V::load(y + i), s0); \
+		s1 = V::fmadd(V::load(x + i + V::width), V::load(y + i + V::width), s1); \
+		s2 = V::fmadd(V::load(x + i + 2 * V::width), V::load(y + i + 2 * V::width), s2); \
+		s3 = V::fmadd(V::load(x + i + 3 * V::width), V::load(y + i + 3 * V::width), s3); \
+	} \
+	for (; i + V::width <= n; i += V::width) \
+		s0 = V::fmadd(V::load(x + i), V::load(y + i), s0); \
+	typename V::scalar res = V::hsum(V::add(V::add(s0, s1), V::add(s2, s3))); \
+	for (; i < n; i++) \
+		res += x[i] * y[i]; \
+	return res; \
+} \
+template<class V> LA_TARGET(TARGET) \
+void simd_horner_##ISA(const typename V::scalar* c, size_t n, const typename V::scalar* x, typename V::scalar* out, size_t k) { \
+	/* one lane per point, four registers of points at once to hide the fma latency */ \
+	size_t j = 0; \
+	for (; j + 4 * V::width <= k; j += 4 * V::width) { \
+		auto x0 = V::load(x + j), x1 = V::load(x + j + V::width); \
+		auto x2 = V::load(x + j + 2 * V::width), x3 = V::load(x + j + 3 * V::width); \
+		auto r0 = V::set1(c[n - 1]), r1 = r0, r2 = r0, r3 = r0; \
+		for (size_t i = n - 1; i-- > 0;) { \
+			auto ci = V::set1(c[i]); \
+			r0 = V::fmadd(r0, x0, ci); \
+			r1 = V::fmadd(r1, x1, ci); \
+			r2 = V::fmadd(r2, x2, ci); \
+			r3 = V::fmadd(r3, x3, ci); \
+		} \
+		V::store(out + j, r0); \
+		V::store(out + j + V::width, r1); \
+		V::store(out + j + 2 * V::width, r2); \
+		V::store(out + j + 3 * V::width, r3); \
+	} \
+	for (; j + V::width <= k; j += V::width) { \
+		auto xj = V::load(x + j), r = V::set1(c[n - 1]); \
+		for (size_t i = n - 1; i-- > 0;) \
+			r = V::fmadd(r, xj, V::set1(c[i])); \
+		V::store(out + j, r); \
+	} \
+	for (; j < k; j++) { \
+		typename V::scalar r = c[n - 1]; \
+		for (size_t i = n - 1; i-- > 0;) \
+			r = r * x[j] + c[i]; \
+		out[j] = r; \
+	} \
+}
+
+LA_SIMD_KERNELS(avx2, "avx2,fma")
+LA_SIMD_KERNELS(avx512, "avx512f")
+
+#undef LA_SIMD_KERNELS
+
+template<class T> struct SimdIsa {};
+template<> struct SimdIsa<double> { using avx2 = SimdAvx2Double; using avx512 = SimdAvx512Double; };
+template<> struct SimdIsa<float> { using avx2 = SimdAvx2Float; using avx512 = SimdAvx512Float; };
+#endif
+
+template<class T>
+constexpr bool simd_supported = std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+} // namespace detail
+
+// out = x + y
+template<class T>
+void vec_add(const T* x, const T* y, T* out, size_t n) {
+#ifdef LA_SIMD_X86
+	if constexpr (detail::simd_supported<T>) {
+		using Isa = detail::SimdIsa<T>;
+		switch (simd_level()) {
+		case SimdLevel::avx512: return detail::simd_add_avx512<typename Isa::avx512>(x, y, out, n);
+		case SimdLevel::avx2: return detail::simd_add_avx2<typename Isa::avx2>(x, y, out, n);
+		default: break;
+		}
+	}
+#endif
+	for (size_t i = 0; i < n; i++)
+		out[i] = x[i] + y[i];
+}
+
+// out = x - y
+template<class T>
+void vec_sub(const T* x, const T* y, T* out, size_t n) {
+#ifdef LA_SIMD_X86
+	if constexpr (detail::simd_supported<T>) {
+		using Isa = detail::SimdIsa<T>;
+		switch (simd_level()) {
+		case SimdLevel::avx512: return detail::simd_sub_avx512<typename Isa::avx512>(x, y, out, n);
+		case SimdLevel::avx2: return detail::simd_sub_avx2<typename Isa::avx2>(x, y, out, n);
+		default: break;
+		}
+	}
+#endif
+	for (size_t i = 0; i < n; i++)
+		out[i] = x[i] - y[i];
+}
+
+// out = x * alpha
+template<class T>
+void vec_scale(const T* x, const T& alpha, T* out, size_t n) {
+#ifdef LA_SIMD_X86
+	if constexpr (detail::simd_supported<T>) {
+		using Isa = detail::SimdIsa<T>;
+		switch (simd_level()) {
+		case SimdLevel::avx512: return detail::simd_scale_avx512<typename Isa::avx512>(x, alpha, out, n);
+		case SimdLevel::avx2: return detail::simd_scale_avx2<typename Isa::avx2>(x, alpha, out, n);
+		default: break;
+		}
+	}
+#endif
+	for (size_t i = 0; i < n; i++)
+		out[i] = x[i] * alpha;
+}
+
+// y += alpha * x
+template<class T>
+void vec_axpy(const T& alpha, const T* x, T* y, size_t n) {
+#ifdef LA_SIMD_X86
+	if constexpr (detail::simd_supported<T>) {
+		using Isa = detail::SimdIsa<T>;
+		switch (simd_level()) {
+		case SimdLevel::avx512: return detail::simd_axpy_avx512<typename Isa::avx512>(alpha, x, y, n);
+		case SimdLevel::avx2: return detail::simd_axpy_avx2<typename Isa::avx2>(alpha, x, y, n);
+		default: break;
+		}
+	}
+#endif
+	for (size_t i = 0; i < n; i++)
+		y[i] += alpha * x[i];
+}
+
+template<class T>
+T vec_dot(const T* x, const T* y, size_t n) {
+#ifdef LA_SIMD_X86
+	if constexpr (detail::simd_supported<T>) {
+		using Isa = detail::SimdIsa<T>;
+		switch (simd_level()) {
+		case SimdLevel::avx512: return detail::simd_dot_avx512<typename Isa::avx512>(x, y, n);
+		case SimdLevel::avx2: return detail::simd_dot_avx2<typename Isa::avx2>(x, y, n);
+		default: break;
+		}
+	}
+#endif
+	T res = T(0);
+	for (size_t i = 0; i < n; i++)
+		res = res + x[i] * y[i];
+	return res;
+}
+
+template<std::floating_point T>
+T vec_norm(const T* x, size_t n) { return std::sqrt(vec_dot(x, x, n)); }
+
+// out[j] = c[0] + c[1] x[j] + ... + c[n-1] x[j]^(n-1) by Horner's rule, n >= 1
+template<class T>
+void vec_horner(const T* c, size_t n, const T* x, T* out, size_t k) {
+#ifdef LA_SIMD_X86
+	if constexpr (detail::simd_supported<T>) {
+		using Isa = detail::SimdIsa<T>;
+		switch (simd_level()) {
+		case SimdLevel::avx512: return detail::simd_horner_avx512<typename Isa::avx512>(c, n, x, out, k);
+		case SimdLevel::avx2: return detail::simd_horner_avx2<typename Isa::avx2>(c, n, x, out, k);
+		default: break;
+		}
+	}
+#endif
+	for (size_t j = 0; j < k; j++) {
+		T r = c[n - 1];
+		for (size_t i = n - 1; i-- > 0;)
+			r = r * x[j] + c[i];
+		out[j] = r;
+	}
+}
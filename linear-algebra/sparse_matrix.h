@@ -0,0 +1,618 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <set>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "matrix.h"
+#include "math_vector.h"
+#include "container_math_vectors.h"
+#include "bareiss.h"
+#include "rational.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "assertm.h"
+
+// Sparse matrices, memory and time are linear in the number of nonzeros.
+// SparseMatrix is compressed sparse row (CSR): the nonzeros of row i are
+// values()[row_ptr()[i] .. row_ptr()[i + 1]) in columns col_idx()[...], increasing.
+// CscMatrix keeps the same data by columns, CooMatrix is a list of (i, j, value)
+// for assembly, duplicates are summed when it is compressed.
+// rank(), Im() and Ker() eliminate on sparse rows with a Markowitz-style pivot choice:
+// the shortest remaining row and, in it, the column with the fewest nonzeros,
+// so fill-in stays low. Integer matrices are eliminated over fractions.
+
+template<class T> class SparseMatrix;
+
+template<class T>
+struct Triplet {
+	size_t i, j;
+	T value;
+};
+
+template<class T = Rational<int>>
+class CooMatrix {
+public:
+	CooMatrix(size_t n = 0, size_t m = 0) : n(n), m(m) {}
+
+	std::pair<size_t, size_t> size() const { return { n, m }; }
+	size_t nonzeros() const { return t.size(); }
+	const std::vector<Triplet<T>>& triplets() const { return t; }
+
+	void reserve(size_t k) { t.reserve(k); }
+	// adds value to element (i, j), several values at one position are summed
+	void add(size_t i, size_t j, const T& value) {
+		assertm(i < n && j < m, "Index out of range in CooMatrix::add");
+		t.push_back({ i, j, value });
+	}
+private:
+	size_t n, m;
+	std::vector<Triplet<T>> t;
+};
+
+template<class T = Rational<int>>
+class SparseMatrix {
+public:
+	using value_type = T;
+
+	// constructions
+	SparseMatrix();
+	SparseMatrix(size_t n, size_t m);
+	SparseMatrix(std::pair<size_t, size_t> sz);
+	SparseMatrix(size_t n, size_t m, std::vector<size_t> row_ptr, std::vector<size_t> col_idx, std::vector<T> values);
+	SparseMatrix(const CooMatrix<T>& coo);
+	explicit SparseMatrix(const Matrix<T>& a);
+
+	std::pair<size_t, size_t> size() const;
+	size_t nonzeros() const;
+
+	const std::vector<size_t>& row_ptr() const;
+	const std::vector<size_t>& col_idx() const;
+	const std::vector<T>& values() const;
+
+	// element (i, j), zero when it is not stored
+	T operator()(size_t i, size_t j) const;
+
+	Matrix<T> to_dense() const;
+	CooMatrix<T> to_coo() const;
+	SparseMatrix transpose() const;
+
+	// math operations
+	MathVector<T> operator*(const MathVector<T>& x) const;
+	SparseMatrix operator*(const SparseMatrix& other) const;
+	Matrix<T> operator*(const Matrix<T>& other) const;
+
+	// pro-math operations
+	size_t rank() const;
+
+	// matrix is a leaner operator
+	ContainerMathVectors<T> Ker() const;
+	ContainerMathVectors<T> Im() const;
+private:
+	size_t n = 0, m = 0;
+	std::vector<size_t> ptr, idx;
+	std::vector<T> val;
+};
+
+// compressed sparse column, stored as the CSR form of the transpose
+template<class T = Rational<int>>
+class CscMatrix {
+public:
+	CscMatrix() {}
+	CscMatrix(const SparseMatrix<T>& a) : t(a.transpose()) {}
+	explicit CscMatrix(const Matrix<T>& a) : CscMatrix(SparseMatrix<T>(a)) {}
+
+	std::pair<size_t, size_t> size() const { return { t.size().second, t.size().first }; }
+	size_t nonzeros() const { return t.nonzeros(); }
+
+	// the nonzeros of column j are values()[col_ptr()[j] .. col_ptr()[j + 1]) in rows row_idx()[...]
+	const std::vector<size_t>& col_ptr() const { return t.row_ptr(); }
+	const std::vector<size_t>& row_idx() const { return t.col_idx(); }
+	const std::vector<T>& values() const { return t.values(); }
+
+	T operator()(size_t i, size_t j) const { return t(j, i); }
+
+	SparseMatrix<T> to_csr() const { return t.transpose(); }
+	Matrix<T> to_dense() const { return t.to_dense().transpose(); }
+
+	// y = A x scatters column by column
+	MathVector<T> operator*(const MathVector<T>& x) const;
+private:
+	SparseMatrix<T> t;
+};
+
+namespace detail {
+
+template<class F>
+using sparse_row = std::vector<std::pair<size_t, F>>;
+
+// field the elimination runs in, integers are eliminated as fractions
+template<class T>
+struct sparse_field {
+	using type = T;
+};
+
+template<class T>
+requires (bareiss_traits<T>::enabled && !bareiss_traits<T>::rational)
+struct sparse_field<T> {
+	using type = Rational<typename bareiss_traits<T>::W>;
+};
+
+// Gaussian elimination on sparse rows. Every step takes the shortest active row as the pivot row,
+// and its column with the fewest nonzeros among the active rows as the pivot column
+// (for floating types only among entries at least SPARSE_PIVOT_THRESHOLD of the row maximum).
+// The k-th pivot row holds no earlier pivot column, so the rows form a triangular system.
+template<class F>
+class SparseElimination {
+public:
+	static constexpr double SPARSE_PIVOT_THRESHOLD = 0.1;
+
+	SparseElimination(std::vector<sparse_row<F>> rows, size_t m);
+
+	size_t rank() const { return cols.size(); }
+	// column of the k-th pivot, in pivot order
+	const std::vector<size_t>& pivot_columns() const { return cols; }
+	// solution of the homogeneous system with x[f] = 1 and zeros at the other free columns
+	std::vector<F> kernel_vector(size_t f) const;
+private:
+	static constexpr bool inexact = std::is_floating_point_v<F>;
+
+	bool is_zero(const F& x) const;
+	size_t choose_pivot(const sparse_row<F>& row) const;
+
+	size_t m;
+	std::vector<sparse_row<F>> piv_rows;
+	std::vector<size_t> cols;
+	std::vector<size_t> col_count;
+	F tolerance = F(0);
+};
+
+template<class F>
+bool SparseElimination<F>::is_zero(const F& x) const {
+	if constexpr (inexact)
+		return std::abs(x) <= tolerance;
+	else
+		return x == F(0);
+}
+
+template<class F>
+size_t SparseElimination<F>::choose_pivot(const sparse_row<F>& row) const {
+	F limit = F(0);
+	if constexpr (inexact) {
+		for (auto& [j, v] : row)
+			limit = std::max(limit, std::abs(v));
+		limit *= F(SPARSE_PIVOT_THRESHOLD);
+	}
+	size_t best = row.size();
+	for (size_t k = 0; k < row.size(); k++) {
+		if constexpr (inexact)
+			if (std::abs(row[k].second) < limit)
+				continue;
+		if (best == row.size() || col_count[row[k].first] < col_count[row[best].first])
+			best = k;
+	}
+	return best;
+}
+
+template<class F>
+SparseElimination<F>::SparseElimination(std::vector<sparse_row<F>> rows, size_t m) : m(m), col_count(m, 0) {
+	size_t n = rows.size();
+	if constexpr (inexact) {
+		F max_abs = F(0);
+		for (auto& row : rows)
+			for (auto& [j, v] : row)
+				max_abs = std::max(max_abs, std::abs(v));
+		tolerance = max_abs * F(std::max(n, m)) * std::numeric_limits<F>::epsilon();
+	}
+
+	// rows that may hold a column, checked on use since eliminated entries are not removed
+	std::vector<std::vector<size_t>> col_rows(m);
+	std::set<std::pair<size_t, size_t>> active;
+	for (size_t i = 0; i < n; i++) {
+		auto& row = rows[i];
+		row.erase(std::remove_if(row.begin(), row.end(), [&](const auto& e) { return is_zero(e.second); }), row.end());
+		for (auto& [j, v] : row) {
+			++col_count[j];
+			col_rows[j].push_back(i);
+		}
+		if (!row.empty())
+			active.insert({ row.size(), i });
+	}
+
+	sparse_row<F> merged;
+	while (!active.empty()) {
+		size_t r = active.begin()->second;
+		active.erase(active.begin());
+		auto& prow = rows[r];
+		size_t k = choose_pivot(prow);
+		const size_t c = prow[k].first;
+		const F piv = prow[k].second;
+		for (auto& [j, v] : prow)
+			--col_count[j];
+
+		for (size_t i : col_rows[c]) {
+			auto& row = rows[i];
+			if (i == r || !active.count({ row.size(), i }))
+				continue;
+			auto it = std::lower_bound(row.begin(), row.end(), c, [](const auto& e, size_t j) { return e.first < j; });
+			if (it == row.end() || it->first != c)
+				continue;
+			F coef = -it->second / piv;
+			active.erase({ row.size(), i });
+			for (auto& [j, v] : row)
+				--col_count[j];
+
+			// row += coef * prow, column c cancels
+			merged.clear();
+			size_t a = 0, b = 0;
+			while (a < row.size() || b < prow.size()) {
+				size_t ja = a < row.size() ? row[a].first : m, jb = b < prow.size() ? prow[b].first : m;
+				if (ja == c && jb == c) {
+					++a, ++b;
+					continue;
+				}
+				F x;
+				size_t j;
+				if (ja < jb) {
+					j = ja, x = row[a++].second;
+				} else if (jb < ja) {
+					j = jb, x = coef * prow[b++].second;
+					col_rows[j].push_back(i);
+				} else {
+					j = ja, x = row[a++].second + coef * prow[b++].second;
+				}
+				if (!is_zero(x))
+					merged.emplace_back(j, x);
+			}
+			row.swap(merged);
+
+			for (auto& [j, v] : row)
+				++col_count[j];
+			if (!row.empty())
+				active.insert({ row.size(), i });
+		}
+		col_rows[c].clear();
+		col_rows[c].shrink_to_fit();
+		cols.push_back(c);
+		piv_rows.push_back(std::move(prow));
+	}
+}
+
+template<class F>
+std::vector<F> SparseElimination<F>::kernel_vector(size_t f) const {
+	std::vector<F> x(m, F(0));
+	x[f] = F(1);
+	for (size_t k = rank(); k-- > 0;) {
+		F s = F(0), piv = F(0);
+		for (auto& [j, v] : piv_rows[k]) {
+			if (j == cols[k])
+				piv = v;
+			else if (x[j] != F(0))
+				s += v * x[j];
+		}
+		x[cols[k]] = -s / piv;
+	}
+	return x;
+}
+
+template<class T>
+SparseElimination<typename sparse_field<T>::type> sparse_eliminate(const SparseMatrix<T>& a) {
+	using F = typename sparse_field<T>::type;
+	auto [n, m] = a.size();
+	std::vector<sparse_row<F>> rows(n);
+	for (size_t i = 0; i < n; i++) {
+		rows[i].reserve(a.row_ptr()[i + 1] - a.row_ptr()[i]);
+		for (size_t k = a.row_ptr()[i]; k < a.row_ptr()[i + 1]; k++)
+			rows[i].emplace_back(a.col_idx()[k], F(a.values()[k]));
+	}
+	return SparseElimination<F>(std::move(rows), m);
+}
+
+} // namespace detail
+
+//constructions
+template<class T>
+SparseMatrix<T>::SparseMatrix() : ptr(1, 0) {}
+
+template<class T>
+SparseMatrix<T>::SparseMatrix(size_t n, size_t m) : n(n), m(m), ptr(n + 1, 0) {}
+
+template<class T>
+SparseMatrix<T>::SparseMatrix(std::pair<size_t, size_t> sz) : SparseMatrix(sz.first, sz.second) {}
+
+template<class T>
+SparseMatrix<T>::SparseMatrix(size_t n, size_t m, std::vector<size_t> row_ptr, std::vector<size_t> col_idx, std::vector<T> values) :
+	n(n), m(m), ptr(std::move(row_ptr)), idx(std::move(col_idx)), val(std::move(values)) {
+	assertm(ptr.size() == n + 1 && ptr[0] == 0 && ptr[n] == idx.size() && idx.size() == val.size(), "Wrong CSR arrays in SparseMatrix constructor");
+}
+
+template<class T>
+SparseMatrix<T>::SparseMatrix(const CooMatrix<T>& coo) : SparseMatrix(coo.size()) {
+	// counting sort by row, then every row is sorted by column and duplicates are summed
+	const auto& t = coo.triplets();
+	std::vector<size_t> start(n + 1, 0);
+	for (auto& e : t)
+		++start[e.i + 1];
+	for (size_t i = 0; i < n; i++)
+		start[i + 1] += start[i];
+	std::vector<std::pair<size_t, T>> sorted(t.size());
+	{
+		std::vector<size_t> pos(start.begin(), start.end() - 1);
+		for (auto& e : t)
+			sorted[pos[e.i]++] = { e.j, e.value };
+	}
+	idx.reserve(t.size());
+	val.reserve(t.size());
+	for (size_t i = 0; i < n; i++) {
+		auto first = sorted.begin() + start[i], last = sorted.begin() + start[i + 1];
+		std::sort(first, last, [](const auto& x, const auto& y) { return x.first < y.first; });
+		for (auto it = first; it != last;) {
+			size_t j = it->first;
+			T s = it->second;
+			for (++it; it != last && it->first == j; ++it)
+				s += it->second;
+			if (s != T(0)) {
+				idx.push_back(j);
+				val.push_back(s);
+			}
+		}
+		ptr[i + 1] = idx.size();
+	}
+}
+
+template<class T>
+SparseMatrix<T>::SparseMatrix(const Matrix<T>& a) : SparseMatrix(a.size()) {
+	for (size_t i = 0; i < n; i++) {
+		auto row = a[i];
+		for (size_t j = 0; j < m; j++)
+			if (row[j] != T(0)) {
+				idx.push_back(j);
+				val.push_back(row[j]);
+			}
+		ptr[i + 1] = idx.size();
+	}
+}
+
+template<class T>
+std::pair<size_t, size_t> SparseMatrix<T>::size() const { return { n, m }; }
+template<class T>
+size_t SparseMatrix<T>::nonzeros() const { return val.size(); }
+
+template<class T>
+const std::vector<size_t>& SparseMatrix<T>::row_ptr() const { return ptr; }
+template<class T>
+const std::vector<size_t>& SparseMatrix<T>::col_idx() const { return idx; }
+template<class T>
+const std::vector<T>& SparseMatrix<T>::values() const { return val; }
+
+template<class T>
+T SparseMatrix<T>::operator()(size_t i, size_t j) const {
+	assertm(i < n && j < m, "Index out of range in SparseMatrix");
+	auto first = idx.begin() + ptr[i], last = idx.begin() + ptr[i + 1];
+	auto it = std::lower_bound(first, last, j);
+	return it != last && *it == j ? val[it - idx.begin()] : T(0);
+}
+
+template<class T>
+Matrix<T> SparseMatrix<T>::to_dense() const {
+	Matrix<T> res(n, m);
+	for (size_t i = 0; i < n; i++)
+		for (size_t k = ptr[i]; k < ptr[i + 1]; k++)
+			res[i][idx[k]] = val[k];
+	return res;
+}
+
+template<class T>
+CooMatrix<T> SparseMatrix<T>::to_coo() const {
+	CooMatrix<T> res(n, m);
+	res.reserve(nonzeros());
+	for (size_t i = 0; i < n; i++)
+		for (size_t k = ptr[i]; k < ptr[i + 1]; k++)
+			res.add(i, idx[k], val[k]);
+	return res;
+}
+
+template<class T>
+SparseMatrix<T> SparseMatrix<T>::transpose() const {
+	// counting sort by column, rows come in increasing order so columns of the result stay sorted
+	std::vector<size_t> tptr(m + 1, 0);
+	for (size_t j : idx)
+		++tptr[j + 1];
+	for (size_t j = 0; j < m; j++)
+		tptr[j + 1] += tptr[j];
+	std::vector<size_t> tidx(nonzeros()), pos(tptr.begin(), tptr.end() - 1);
+	std::vector<T> tval(nonzeros());
+	for (size_t i = 0; i < n; i++)
+		for (size_t k = ptr[i]; k < ptr[i + 1]; k++) {
+			size_t p = pos[idx[k]]++;
+			tidx[p] = i;
+			tval[p] = val[k];
+		}
+	return SparseMatrix(m, n, std::move(tptr), std::move(tidx), std::move(tval));
+}
+
+// math operations
+template<class T>
+MathVector<T> SparseMatrix<T>::operator*(const MathVector<T>& x) const {
+	assertm(m == x.size(), "Wrong sizes in SparseMatrix * MathVector");
+	MathVector<T> res(n);
+	parallel_for(0, n, std::max<size_t>(nonzeros() / std::max<size_t>(n, 1), 1), [&](size_t lo, size_t hi) {
+		for (size_t i = lo; i < hi; i++) {
+			T s = T(0);
+			for (size_t k = ptr[i]; k < ptr[i + 1]; k++)
+				s += val[k] * x[idx[k]];
+			res[i] = s;
+		}
+	});
+	return res;
+}
+
+template<class T>
+SparseMatrix<T> SparseMatrix<T>::operator*(const SparseMatrix& other) const {
+	auto [n1, k] = other.size();
+	assertm(m == n1, "Wrong matrix sizes in SparseMatrix * SparseMatrix");
+	// Gustavson: row i of the product is the sum of the rows of other picked by row i of *this,
+	// gathered in a dense accumulator of the touched columns
+	std::vector<std::vector<size_t>> ridx(n);
+	std::vector<std::vector<T>> rval(n);
+	size_t cost = std::max<size_t>(nonzeros() / std::max<size_t>(n, 1), 1) * std::max<size_t>(other.nonzeros() / std::max<size_t>(n1, 1), 1);
+	parallel_for(0, n, cost, [&](size_t lo, size_t hi) {
+		std::vector<T> acc(k, T(0));
+		std::vector<bool> used(k, false);
+		std::vector<size_t> touched;
+		for (size_t i = lo; i < hi; i++) {
+			touched.clear();
+			for (size_t p = ptr[i]; p < ptr[i + 1]; p++) {
+				const T& a = val[p];
+				size_t r = idx[p];
+				for (size_t q = other.ptr[r]; q < other.ptr[r + 1]; q++) {
+					size_t j = other.idx[q];
+					if (!used[j]) {
+						used[j] = true;
+						touched.push_back(j);
+					}
+					acc[j] += a * other.val[q];
+				}
+			}
+			std::sort(touched.begin(), touched.end());
+			for (size_t j : touched) {
+				if (acc[j] != T(0)) {
+					ridx[i].push_back(j);
+					rval[i].push_back(acc[j]);
+				}
+				acc[j] = T(0);
+				used[j] = false;
+			}
+		}
+	});
+
+	std::vector<size_t> rptr(n + 1, 0);
+	for (size_t i = 0; i < n; i++)
+		rptr[i + 1] = rptr[i] + ridx[i].size();
+	std::vector<size_t> cidx;
+	std::vector<T> cval;
+	cidx.reserve(rptr[n]);
+	cval.reserve(rptr[n]);
+	for (size_t i = 0; i < n; i++) {
+		cidx.insert(cidx.end(), ridx[i].begin(), ridx[i].end());
+		cval.insert(cval.end(), rval[i].begin(), rval[i].end());
+	}
+	return SparseMatrix(n, k, std::move(rptr), std::move(cidx), std::move(cval));
+}
+
+template<class T>
+Matrix<T> SparseMatrix<T>::operator*(const Matrix<T>& other) const {
+	auto [n1, k] = other.size();
+	assertm(m == n1, "Wrong matrix sizes in SparseMatrix * Matrix");
+	// row i of the product is a combination of the rows of other
+	Matrix<T> res(n, k);
+	parallel_for(0, n, std::max<size_t>(nonzeros() / std::max<size_t>(n, 1), 1) * k, [&](size_t lo, size_t hi) {
+		for (size_t i = lo; i < hi; i++)
+			for (size_t p = ptr[i]; p < ptr[i + 1]; p++)
+				vec_axpy(val[p], other[idx[p]].data(), res[i].data(), k);
+	});
+	return res;
+}
+
+template<class T>
+Matrix<T> operator*(const Matrix<T>& a, const SparseMatrix<T>& b) {
+	auto [n, m] = a.size();
+	auto [m1, k] = b.size();
+	assertm(m == m1, "Wrong matrix sizes in Matrix * SparseMatrix");
+	// row i of the product is a combination of the rows of b with the coefficients of row i of a
+	const auto& ptr = b.row_ptr();
+	const auto& idx = b.col_idx();
+	const auto& val = b.values();
+	Matrix<T> res(n, k);
+	parallel_for(0, n, b.nonzeros(), [&](size_t lo, size_t hi) {
+		for (size_t i = lo; i < hi; i++) {
+			auto out = res[i];
+			for (size_t j = 0; j < m; j++) {
+				const T& x = a[i][j];
+				if (x == T(0))
+					continue;
+				for (size_t p = ptr[j]; p < ptr[j + 1]; p++)
+					out[idx[p]] += x * val[p];
+			}
+		}
+	});
+	return res;
+}
+
+template<class T>
+MathVector<T> CscMatrix<T>::operator*(const MathVector<T>& x) const {
+	auto [n, m] = size();
+	assertm(m == x.size(), "Wrong sizes in CscMatrix * MathVector");
+	MathVector<T> res(n);
+	for (size_t j = 0; j < m; j++) {
+		if (x[j] == T(0))
+			continue;
+		for (size_t k = col_ptr()[j]; k < col_ptr()[j + 1]; k++)
+			res[row_idx()[k]] += values()[k] * x[j];
+	}
+	return res;
+}
+
+// pro-math operations
+template<class T>
+size_t SparseMatrix<T>::rank() const {
+	return detail::sparse_eliminate(*this).rank();
+}
+
+// matrix is a leaner operator
+template<class T>
+ContainerMathVectors<T> SparseMatrix<T>::Im() const {
+	auto cols = detail::sparse_eliminate(*this).pivot_columns();
+	std::sort(cols.begin(), cols.end());
+	auto t = transpose();
+	ContainerMathVectors<T> res;
+	for (size_t j : cols) {
+		MathVector<T> cur(n);
+		for (size_t k = t.ptr[j]; k < t.ptr[j + 1]; k++)
+			cur[t.idx[k]] = t.val[k];
+		res.push_back(cur);
+	}
+	return res;
+}
+
+template<class T>
+ContainerMathVectors<T> SparseMatrix<T>::Ker() const {
+	using F = typename detail::sparse_field<T>::type;
+	auto e = detail::sparse_eliminate(*this);
+	std::vector<bool> is_main(m, false);
+	for (size_t c : e.pivot_columns())
+		is_main[c] = true;
+
+	ContainerMathVectors<T> res;
+	for (size_t f = 0; f < m; f++) {
+		if (is_main[f])
+			continue;
+		std::vector<F> x = e.kernel_vector(f);
+		MathVector<T> cur(m);
+		if constexpr (std::is_same_v<F, T>) {
+			for (size_t j = 0; j < m; j++)
+				cur[j] = x[j];
+		} else {
+			// integer vector: clear the denominators, then divide by the gcd of the entries
+			using W = typename detail::bareiss_traits<T>::W;
+			W l = W(1), g = W(0);
+			for (auto& v : x)
+				l = l / my_gcd(l, v.m) * v.m;
+			for (auto& v : x)
+				g = my_gcd(g, detail::bareiss_abs(W(v.n * (l / v.m))));
+			for (size_t j = 0; j < m; j++)
+				cur[j] = T(x[j].n * (l / x[j].m) / g);
+		}
+		res.push_back(cur);
+	}
+	return res;
+}
+
+template<class T>
+std::ostream& operator<<(std::ostream& out, const SparseMatrix<T>& a) {
+	return out << a.to_dense();
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "gemm.h"
+#include "matrix_view.h"
+#include "simd.h"
+#include "assertm.h"
+
+// Strassen-Winograd multiplication C += alpha * A * B, 7 half-size products and 15 additions
+// per level instead of 8 products. It recurses while all three dimensions are at least
+// GemmTraits<T>::STRASSEN and then calls the base kernel. Odd dimensions are peeled:
+// the even part is multiplied recursively and the last row, column or inner index is added
+// by thin base-kernel products. Floating results differ from the classic product by
+// rounding only, with a slightly weaker error bound.
+
+namespace detail {
+
+// dense n x m scratch matrix for the operands and products of one level
+template<class T>
+struct StrassenBuffer {
+	std::vector<T> a;
+	size_t n, m;
+	StrassenBuffer(size_t n, size_t m) : a(n * m, T(0)), n(n), m(m) {}
+	MatrixView<T> view() { return { a.data(), n, m }; }
+	void clear() { std::fill(a.begin(), a.end(), T(0)); }
+};
+
+// dst = x + y or dst = x - y
+template<class T>
+void strassen_combine(MatrixView<const T> x, MatrixView<const T> y, MatrixView<T> dst, bool minus) {
+	for (size_t i = 0; i < dst.rows(); i++) {
+		if (minus)
+			vec_sub(x.row(i).data(), y.row(i).data(), dst.row(i).data(), dst.cols());
+		else
+			vec_add(x.row(i).data(), y.row(i).data(), dst.row(i).data(), dst.cols());
+	}
+}
+
+// dst += alpha * x, without products for alpha = 1 and -1
+template<class T>
+void strassen_accumulate(MatrixView<const T> x, MatrixView<T> dst, const T& alpha) {
+	bool plus = alpha == T(1), minus = alpha == T(-1);
+	for (size_t i = 0; i < dst.rows(); i++) {
+		T* out = dst.row(i).data();
+		if (plus)
+			vec_add(out, x.row(i).data(), out, dst.cols());
+		else if (minus)
+			vec_sub(out, x.row(i).data(), out, dst.cols());
+		else
+			vec_axpy(alpha, x.row(i).data(), out, dst.cols());
+	}
+}
+
+template<class T>
+void gemm_strassen(MatrixView<const T> a, MatrixView<const T> b, MatrixView<T> c, const T& alpha) {
+	auto [n, k] = a.size();
+	size_t m = b.cols();
+	if (std::min({ n, k, m }) < GemmTraits<T>::STRASSEN)
+		return gemm_base(a, b, c, alpha);
+
+	size_t hn = n / 2, hk = k / 2, hm = m / 2;
+	auto a11 = a.block(0, 0, hn, hk), a12 = a.block(0, hk, hn, hk);
+	auto a21 = a.block(hn, 0, hn, hk), a22 = a.block(hn, hk, hn, hk);
+	auto b11 = b.block(0, 0, hk, hm), b12 = b.block(0, hm, hk, hm);
+	auto b21 = b.block(hk, 0, hk, hm), b22 = b.block(hk, hm, hk, hm);
+	auto c11 = c.block(0, 0, hn, hm), c12 = c.block(0, hm, hn, hm);
+	auto c21 = c.block(hn, 0, hn, hm), c22 = c.block(hn, hm, hn, hm);
+
+	StrassenBuffer<T> s1(hn, hk), s2(hn, hk), s3(hn, hk), s4(hn, hk);
+	StrassenBuffer<T> t1(hk, hm), t2(hk, hm), t3(hk, hm), t4(hk, hm);
+	StrassenBuffer<T> u(hn, hm), v(hn, hm);
+	strassen_combine<T>(a21, a22, s1.view(), false);
+	strassen_combine<T>(s1.view(), a11, s2.view(), true);
+	strassen_combine<T>(a11, a21, s3.view(), true);
+	strassen_combine<T>(a12, s2.view(), s4.view(), true);
+	strassen_combine<T>(b12, b11, t1.view(), true);
+	strassen_combine<T>(b22, t1.view(), t2.view(), true);
+	strassen_combine<T>(b22, b12, t3.view(), true);
+	strassen_combine<T>(t2.view(), b21, t4.view(), true);
+
+	// C11 = P1 + P2, C12 = U2 + P5 + P3, C21 = U2 + P7 - P4, C22 = U2 + P7 + P5, U2 = P1 + P6
+	gemm_strassen<T>(a11, b11, u.view(), T(1));
+	strassen_accumulate<T>(u.view(), c11, alpha);
+	gemm_strassen<T>(a12, b21, c11, alpha);
+	gemm_strassen<T>(s2.view(), t2.view(), u.view(), T(1));
+	strassen_accumulate<T>(u.view(), c12, alpha);
+	strassen_accumulate<T>(u.view(), c21, alpha);
+	strassen_accumulate<T>(u.view(), c22, alpha);
+	gemm_strassen<T>(s1.view(), t1.view(), v.view(), T(1));
+	strassen_accumulate<T>(v.view(), c12, alpha);
+	strassen_accumulate<T>(v.view(), c22, alpha);
+	gemm_strassen<T>(s4.view(), b22, c12, alpha);
+	v.clear();
+	gemm_strassen<T>(s3.view(), t3.view(), v.view(), T(1));
+	strassen_accumulate<T>(v.view(), c21, alpha);
+	strassen_accumulate<T>(v.view(), c22, alpha);
+	gemm_strassen<T>(a22, t4.view(), c21, T(-alpha));
+
+	// peeling of odd dimensions
+	if (k % 2)
+		gemm_base(a.block(0, k - 1, 2 * hn, 1), b.block(k - 1, 0, 1, 2 * hm), c.block(0, 0, 2 * hn, 2 * hm), alpha);
+	if (m % 2)
+		gemm_base(a, b.block(0, m - 1, k, 1), c.block(0, m - 1, n, 1), alpha);
+	if (n % 2)
+		gemm_base(a.block(n - 1, 0, 1, k), b.block(0, 0, k, 2 * hm), c.block(n - 1, 0, 1, 2 * hm), alpha);
+}
+
+} // namespace detail
@@ -0,0 +1,598 @@
+// Behaviour tests of the exact engines, each checked against an independent path:
+// the same computation in BigInt, a different algorithm, or a known answer.
+// Build on Linux:  g++ -std=c++20 -O2 -pthread tests.cpp -o tests
+// Run:             ./tests
+// Every failed check is printed to stderr, the exit code is nonzero if any check failed.
+
+#include <cmath>
+#include <cstring>
+#include <ios>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "matrix.h"
+#include "bigint.h"
+#include "rational.h"
+#include "polynomial.h"
+#include "modint.h"
+#include "binary_io.h"
+#include "elimination.h"
+#include "lu.h"
+#include "out_of_core.h"
+#include "fixed_matrix.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+	if (!ok) {
+		++failures;
+		std::cerr << "FAILED: " << what << '\n';
+	}
+}
+
+using BigRational = Rational<BigInt>;
+
+BigRational to_big(const Rational<int>& x) { return BigRational(BigInt(x.n), BigInt(x.m)); }
+
+template<class T>
+Matrix<BigInt> to_big(const Matrix<T>& a) {
+	auto [n, m] = a.size();
+	Matrix<BigInt> res(n, m);
+	for (size_t k = 0; k < n * m; k++)
+		res.data()[k] = BigInt(a.data()[k]);
+	return res;
+}
+
+Matrix<BigRational> to_big_rational(const Matrix<Rational<int>>& a) {
+	auto [n, m] = a.size();
+	Matrix<BigRational> res(n, m);
+	for (size_t k = 0; k < n * m; k++)
+		res.data()[k] = to_big(a.data()[k]);
+	return res;
+}
+
+bool fits_int(const BigInt& x) { return x.bit_length() < 31; }
+
+// sparse matrix with small numerators and denominators, the row lcms and the minors of
+// the scaled matrix leave long long quickly
+Matrix<Rational<int>> random_rational(size_t n, std::mt19937& rng) {
+	std::uniform_int_distribution<int> num(-9, 9), den(1, 29), keep(0, 2);
+	Matrix<Rational<int>> a(n, n);
+	for (size_t k = 0; k < n * n; k++)
+		if (keep(rng) == 0 || k % (n + 1) == 0)
+			a.data()[k] = Rational<int>(num(rng), den(rng));
+	return a;
+}
+
+Matrix<int> random_int(size_t n, size_t m, int bound, std::mt19937& rng) {
+	std::uniform_int_distribution<int> d(-bound, bound);
+	Matrix<int> a(n, m);
+	for (size_t k = 0; k < n * m; k++)
+		a.data()[k] = d(rng);
+	return a;
+}
+
+// a * v == 0 for every vector v of the basis
+bool is_kernel(const Matrix<BigInt>& a, const ContainerMathVectors<BigInt>& basis) {
+	auto [n, m] = a.size();
+	for (size_t t = 0; t < basis.size().first; t++)
+		for (size_t i = 0; i < n; i++) {
+			BigInt s = 0;
+			for (size_t j = 0; j < m; j++)
+				s += a[i][j] * basis[t][j];
+			if (s != BigInt(0))
+				return false;
+		}
+	return true;
+}
+
+void test_bareiss() {
+	std::mt19937 rng(7);
+	// determinants of rational matrices that fit Rational<int> must match the BigInt engine
+	size_t compared = 0;
+	for (size_t n : { 6, 8, 10 })
+		for (int it = 0; it < 40; it++) {
+			auto a = random_rational(n, rng);
+			BigRational ref = to_big_rational(a).det();
+			if (!fits_int(ref.n) || !fits_int(ref.m))
+				continue;
+			++compared;
+			Rational<int> d = a.det();
+			check(d.m > 0, "Bareiss det of Rational<int> has a positive denominator");
+			check(to_big(d) == ref, "Bareiss det of a " + std::to_string(n) + "x" + std::to_string(n) + " Rational<int> matrix");
+			check(a.rank() == to_big_rational(a).rank(), "Bareiss rank of Rational<int> matches BigInt");
+			check(det_multimodular(a) == d, "multi-modular det of Rational<int> matches Bareiss");
+			check(rank_multimodular(a) == a.rank(), "multi-modular rank of Rational<int> matches Bareiss");
+		}
+	check(compared > 20, "enough rational determinants fit Rational<int>");
+
+	// rank and kernel dimension of a 9x10 int matrix with entries in +-1000, whose minors
+	// of order 9 are far beyond long long
+	for (int it = 0; it < 5; it++) {
+		auto a = random_int(9, 10, 1000, rng);
+		auto b = to_big(a);
+		check(a.rank() == 9 && b.rank() == 9, "Bareiss rank of a random 9x10 int matrix");
+		check(a.fse().size().first == 1, "Bareiss fse of a random 9x10 int matrix is one vector");
+		auto k = b.fse();
+		check(k.size().first == 1 && is_kernel(b, k), "Bareiss fse of a random 9x10 BigInt matrix is its kernel");
+		check(a.Im().size().first == 9, "Bareiss Im of a random 9x10 int matrix");
+	}
+
+	// have_inverce of integer matrices goes through Bareiss, not a truncating LU
+	check(!Matrix<int>({ { 2, 4 }, { 1, 2 } }).have_inverce(), "have_inverce of a singular 2x2 int matrix");
+	check(Matrix<int>({ { 2, 4 }, { 1, 3 } }).have_inverce(), "have_inverce of a regular 2x2 int matrix");
+	check(!Matrix<int>(2, 3).have_inverce(), "have_inverce of a rectangular int matrix");
+
+	// a dependent row: the rank drops even though the minors overflow long long
+	auto a = random_int(8, 8, 1000, rng);
+	for (size_t j = 0; j < 8; j++)
+		a[7][j] = a[0][j] - a[3][j];
+	check(a.rank() == 7 && a.det() == 0, "Bareiss rank and det of a singular 8x8 int matrix");
+	auto b = to_big(a);
+	auto k = b.fse();
+	check(k.size().first == 1 && is_kernel(b, k), "Bareiss fse of a singular 8x8 BigInt matrix");
+}
+
+template<class T>
+std::vector<BigRational> coefficients(const Polynomial<T>& p) {
+	std::vector<BigRational> res;
+	for (auto it = p.begin(); it != p.end(); ++it) {
+		if constexpr (std::is_same_v<T, BigRational>)
+			res.push_back(*it);
+		else if constexpr (std::is_same_v<T, Rational<int>>)
+			res.push_back(to_big(*it));
+		else
+			res.push_back(BigRational(BigInt(*it)));
+	}
+	return res;
+}
+
+void test_char_poly() {
+	std::mt19937 rng(11);
+	// the common denominator of the whole matrix overflows long long inside Berkowitz
+	size_t compared = 0;
+	for (size_t n : { 3, 5, 6 })
+		for (int it = 0; it < 20; it++) {
+			auto a = random_rational(n, rng);
+			auto ref = coefficients(to_big_rational(a).char_poly());
+			bool fits = true;
+			for (auto& c : ref)
+				fits = fits && fits_int(c.n) && fits_int(c.m);
+			if (!fits)
+				continue;
+			++compared;
+			check(coefficients(a.char_poly()) == ref, "char_poly of a " + std::to_string(n) + "x" + std::to_string(n) + " Rational<int> matrix matches BigInt");
+		}
+	check(compared > 10, "enough characteristic polynomials fit Rational<int>");
+
+	// integer matrices against the O(n!) definition
+	for (int it = 0; it < 5; it++) {
+		auto a = random_int(5, 5, 50, rng);
+		check(a.char_poly() == a.char_poly_slow(), "char_poly of a 5x5 int matrix matches char_poly_slow");
+	}
+	// long long entries of 2^40: every product in Berkowitz overflows, the coefficients do not
+	Matrix<long long> a(2, 2);
+	a[0][0] = a[1][1] = 1LL << 40;
+	a[0][1] = a[1][0] = (1LL << 40) - 1;
+	auto p = coefficients(a.char_poly());
+	auto ref = coefficients(to_big(a).char_poly());
+	check(p == ref, "char_poly of a long long matrix with 2^40 entries matches BigInt");
+}
+
+// read_binary of the bytes must set failbit without throwing
+template<class A>
+bool rejects(const std::string& bytes) {
+	std::istringstream in(bytes);
+	A a;
+	try {
+		read_binary(in, a);
+	} catch (...) {
+		return false;
+	}
+	return in.fail();
+}
+
+void test_binary_io() {
+	std::mt19937 rng(13);
+	// raw elements
+	Matrix<double> d(37, 53);
+	std::uniform_real_distribution<double> u(-1, 1);
+	for (size_t k = 0; k < 37 * 53; k++)
+		d.data()[k] = u(rng);
+	std::stringstream s1;
+	write_binary(s1, d);
+	Matrix<double> d2;
+	check(bool(read_binary(s1, d2)) && d2 == d, "binary round trip of Matrix<double>");
+
+	// framed elements over several frames of BINARY_IO_CHUNK bytes
+	Matrix<BigRational> r(300, 300);
+	BigInt big = 1;
+	for (int i = 0; i < 6; i++)
+		big *= BigInt(1000000007);
+	for (size_t k = 0; k < 300 * 300; k++)
+		r.data()[k] = BigRational(big + BigInt(int(k)) - BigInt(45000), BigInt(int(k % 97) + 1));
+	std::stringstream s2;
+	write_binary(s2, r);
+	check(s2.str().size() > 2 * BINARY_IO_CHUNK, "Matrix<Rational<BigInt>> spans several frames");
+	Matrix<BigRational> r2;
+	check(bool(read_binary(s2, r2)) && r2 == r, "binary round trip of Matrix<Rational<BigInt>>");
+
+	Polynomial<Rational<int>> p(std::vector<Rational<int>>{ Rational<int>(1, 2), Rational<int>(-3), Rational<int>(5, 7) });
+	std::stringstream s3;
+	write_binary(s3, p);
+	Polynomial<Rational<int>> p2;
+	check(bool(read_binary(s3, p2)) && p2 == p, "binary round trip of Polynomial<Rational<int>>");
+
+	// damaged input
+	std::string junk(4096, char(0xFF));
+	check(rejects<Polynomial<int>>(junk) && rejects<Matrix<int>>(junk) && rejects<Matrix<BigInt>>(junk), "binary read of 0xFF bytes fails");
+
+	std::string good = s2.str(), bad = good;
+	BinaryHeader h;
+	std::memcpy(&h, good.data(), sizeof(h));
+	h.rows = h.cols = uint64_t(1) << 40;
+	std::memcpy(bad.data(), &h, sizeof(h));
+	check(rejects<Matrix<BigRational>>(bad), "binary read of a too large shape fails");
+
+	bad = good;
+	uint64_t len = uint64_t(1) << 60;
+	std::memcpy(bad.data() + sizeof(h), &len, sizeof(len));
+	check(rejects<Matrix<BigRational>>(bad), "binary read of a too long frame fails");
+
+	check(rejects<Matrix<BigRational>>(good.substr(0, good.size() / 2)), "binary read of a truncated file fails");
+	std::string raw = s1.str();
+	check(rejects<Matrix<double>>(raw.substr(0, raw.size() - 1)), "binary read of a truncated raw file fails");
+}
+
+// random matrix of rank at most r with zero columns in between, so pivots leave the diagonal
+Matrix<Rational<int>> random_shifted(size_t n, size_t m, size_t r, std::mt19937& rng) {
+	std::uniform_int_distribution<int> d(-3, 3), zero(0, 2);
+	Matrix<Rational<int>> x(n, r), y(r, m);
+	for (size_t k = 0; k < n * r; k++)
+		x.data()[k] = d(rng);
+	for (size_t j = 0; j < m; j++)
+		if (zero(rng))
+			for (size_t i = 0; i < r; i++)
+				y[i][j] = d(rng);
+	return x * y;
+}
+
+void test_elimination() {
+	Matrix<Rational<int>> a(2, 3);
+	a[0][1] = a[1][2] = 1;
+	Elimination info;
+	Matrix<Rational<int>> b = a;
+	to_stepped_view_inplace(b.view(), info);
+	check(info.rank() == 2 && info.pivot_cols == std::vector<size_t>{ 1, 2 }, "Elimination of [[0,1,0],[0,0,1]] has pivots in columns 1 and 2");
+
+	Matrix<double> c(2, 2);
+	c[0][1] = c[1][1] = 1;
+	auto k = c.fse();
+	check(k.size().first == 1 && k[0][0] == 1 && k[0][1] == 0, "fse of [[0,1],[0,1]] is (1, 0)");
+
+	// the pivot columns of any echelon form are the same: compare with lu_inplace and Bareiss
+	std::mt19937 rng(17);
+	for (int it = 0; it < 50; it++) {
+		size_t n = 2 + rng() % 7, m = 2 + rng() % 7, r = 1 + rng() % std::min(n, m);
+		// Gaussian elimination overflows Rational<int>, so it runs in Rational<BigInt>
+		auto x = to_big_rational(random_shifted(n, m, r, rng));
+		auto s = x, lu = x;
+		Elimination e1, e2;
+		to_improved_stepped_view_inplace(s.view(), e1);
+		lu_inplace(lu.view(), e2);
+		check(e1.rank() == x.rank() && e1.rank() == LUDecomposition<BigRational>(x).rank(), "Elimination rank matches Bareiss and LUDecomposition");
+		check(e1.pivot_cols == e2.pivot_cols, "Elimination pivot columns match lu_inplace");
+		// reduced form: the pivot of row i is 1, everything else in its column is 0
+		bool reduced = true;
+		for (size_t i = 0; i < e1.rank(); i++)
+			for (size_t t = 0; t < n; t++)
+				reduced = reduced && s[t][e1.pivot_cols[i]] == BigRational(t == i ? 1 : 0);
+		for (size_t t = e1.rank(); t < n; t++)
+			for (size_t j = 0; j < m; j++)
+				reduced = reduced && s[t][j] == BigRational(0);
+		check(reduced, "to_improved_stepped_view_inplace gives the reduced row echelon form");
+	}
+}
+
+// every expression shape against an elementwise loop, for the SIMD and the generic paths
+template<class T>
+void test_expressions(std::mt19937& rng) {
+	size_t n = 33, m = 29;
+	std::uniform_int_distribution<int> d(-50, 50);
+	Matrix<T> a(n, m), b(n, m), c(n, m);
+	for (size_t k = 0; k < n * m; k++) {
+		a.data()[k] = T(d(rng));
+		b.data()[k] = T(d(rng));
+		c.data()[k] = T(d(rng));
+	}
+	T coef = T(3);
+	auto expect = [&](auto f) {
+		Matrix<T> res(n, m);
+		for (size_t k = 0; k < n * m; k++)
+			res.data()[k] = f(k);
+		return res;
+	};
+	auto at = [](const Matrix<T>& x, size_t k) { return x.data()[k]; };
+	Matrix<T> r = a + b;
+	check(r == expect([&](size_t k) { return at(a, k) + at(b, k); }), "A + B");
+	r = a - b;
+	check(r == expect([&](size_t k) { return at(a, k) - at(b, k); }), "A - B");
+	r = coef * a;
+	check(r == expect([&](size_t k) { return at(a, k) * coef; }), "coef * A");
+	r = a + b - c * coef;
+	check(r == expect([&](size_t k) { return at(a, k) + at(b, k) - at(c, k) * coef; }), "A + B - C * coef");
+	r = c;
+	r += a - b;
+	check(r == expect([&](size_t k) { return at(c, k) + at(a, k) - at(b, k); }), "C += A - B");
+	r = c;
+	r -= a * coef;
+	check(r == expect([&](size_t k) { return at(c, k) - at(a, k) * coef; }), "C -= A * coef");
+	r = c;
+	r += -a;
+	check(r == expect([&](size_t k) { return at(c, k) - at(a, k); }), "C += -A");
+	r = c + (a - b) * coef;
+	check(r == expect([&](size_t k) { return at(c, k) + (at(a, k) - at(b, k)) * coef; }), "C + (A - B) * coef");
+	r = a;
+	r = r + b;
+	check(r == expect([&](size_t k) { return at(a, k) + at(b, k); }), "R = R + B");
+	// the destination is an operand of the compound assignment
+	r = a;
+	r += b + r;
+	check(r == expect([&](size_t k) { return at(a, k) + at(b, k) + at(a, k); }), "R += B + R");
+	r = a;
+	r -= b - r;
+	check(r == expect([&](size_t k) { return at(a, k) - (at(b, k) - at(a, k)); }), "R -= B - R");
+	r = a;
+	r += r + r;
+	check(r == expect([&](size_t k) { return at(a, k) * T(3); }), "R += R + R");
+	r = a;
+	r -= r - b;
+	check(r == expect([&](size_t k) { return at(b, k); }), "R -= R - B");
+	r = a;
+	r += r * coef;
+	check(r == expect([&](size_t k) { return at(a, k) + at(a, k) * coef; }), "R += R * coef");
+}
+
+// *= builds the product with the allocator of the matrix: an arena matrix stays in its arena
+void test_product_assign() {
+	std::mt19937 rng(37);
+	auto x = random_int(7, 5, 9, rng), y = random_int(5, 4, 9, rng), z = random_int(4, 4, 9, rng);
+	Matrix<int> xy = x * y, zz = z * z;
+	BumpArena arena;
+	ScopedMemoryResource scope(arena);
+	Matrix<int> a = x, b = z;
+	size_t used = arena.used();
+	a *= y;
+	check(a == xy, "A *= B");
+	check(arena.used() > used, "A *= B allocates the product in the arena of A");
+	b *= b;
+	check(b == zz, "A *= A");
+}
+
+void test_multimod() {
+	std::mt19937 rng(29);
+	// orders from MULTIMOD_DET_CUTOFF up take the multi-modular path in Matrix::det
+	for (size_t n : { MULTIMOD_DET_CUTOFF, MULTIMOD_DET_CUTOFF + 9 }) {
+		auto a = to_big(random_int(n, n, 1000000, rng));
+		check(a.det() == detail::bareiss_det(a), "multi-modular det of a " + std::to_string(n) + "x" + std::to_string(n) + " BigInt matrix matches Bareiss");
+		for (size_t j = 0; j < n; j++)
+			a[n - 1][j] = a[0][j] * BigInt(3) - a[1][j];
+		check(a.det() == BigInt(0) && rank_multimodular(a) == n - 1 && detail::bareiss_rank(a) == n - 1, "multi-modular det and rank of a singular BigInt matrix");
+	}
+	auto r = random_shifted(40, 36, 23, rng);
+	check(rank_multimodular(r) == 23 && r.rank() == 23, "multi-modular rank of a 40x36 Rational<int> matrix of rank 23");
+
+	// the floating LUDecomposition against the exact engine on integer-valued matrices
+	for (int it = 0; it < 5; it++) {
+		auto x = random_int(12, 12, 20, rng);
+		Matrix<double> y(12, 12);
+		for (size_t k = 0; k < 144; k++)
+			y.data()[k] = x.data()[k];
+		double exact = std::stod(to_big(x).det().to_string());
+		double lu = LUDecomposition<double>(y).det();
+		check(std::fabs(lu - exact) <= 1e-9 * std::fabs(exact), "LUDecomposition det of an integer-valued matrix matches Bareiss");
+		check(LUDecomposition<double>(y).rank() == x.rank(), "LUDecomposition rank matches Bareiss");
+	}
+}
+
+template<class T>
+Polynomial<T> random_poly(int deg, std::mt19937& rng) {
+	std::uniform_int_distribution<int> d(-9, 9);
+	std::vector<T> c(deg + 1);
+	for (auto& x : c)
+		x = T(d(rng));
+	c.back() = T(1);
+	return Polynomial<T>(c);
+}
+
+// gcd(g p, g q) is g for a monic g of degree gdeg and random p, q, which are coprime with
+// overwhelming probability
+template<class T>
+void test_poly_gcd(const std::string& name, std::vector<std::tuple<int, int, int>> degrees, std::mt19937& rng) {
+	for (auto [da, db, gdeg] : degrees) {
+		auto g = random_poly<T>(gdeg, rng);
+		auto a = g * random_poly<T>(da - gdeg, rng), b = g * random_poly<T>(db - gdeg, rng);
+		std::string what = "gcd of " + name + " of degrees " + std::to_string(da) + " and " + std::to_string(db);
+		check((a, b) == g && (b, a) == g, what);
+	}
+}
+
+void test_polynomial() {
+	std::mt19937 rng(31);
+	int h = int(POLY_HALF_GCD);
+	// degrees below, at and above POLY_HALF_GCD, equal and unequal
+	test_poly_gcd<ModInt<998244353>>("ModInt", { { 10, 10, 7 }, { h, h, 7 }, { h + 16, h + 16, 7 },
+		{ h + 17, h + 16, 7 }, { 3 * h, 2 * h + 5, 7 }, { 3 * h, 3 * h, 7 } }, rng);
+	// the coefficients of a long remainder sequence explode over the rationals, so p and q
+	// are short there
+	test_poly_gcd<BigRational>("Rational<BigInt>", { { 10, 8, 5 }, { h, h, h - 2 }, { h + 16, h + 16, h + 12 },
+		{ h + 17, h + 16, h + 13 }, { 2 * h, h + 36, h + 32 } }, rng);
+
+	// floating types stay on the Euclid loop, equal degrees above POLY_HALF_GCD must end
+	auto a = random_poly<double>(h + 16, rng), b = random_poly<double>(h + 16, rng);
+	check((a, b).Degree() <= h + 16, "gcd of Polynomial<double> of equal degree ends");
+}
+
+template<class F>
+bool throws_io(F&& f) {
+	try {
+		f();
+	} catch (const std::ios_base::failure&) {
+		return true;
+	}
+	return false;
+}
+
+void test_out_of_core() {
+	std::mt19937 rng(23);
+	Matrix<double> a(70, 45);
+	std::uniform_real_distribution<double> u(-1, 1);
+	for (size_t k = 0; k < 70 * 45; k++)
+		a.data()[k] = u(rng);
+	{
+		// tiles of 16 and room for 4 of them: most tiles are written back and read again
+		TiledMatrix<double> t(a.size().first, a.size().second, 16, 4 * 16 * 16 * sizeof(double));
+		t.write_block(0, 0, a.view());
+		check(t.to_matrix() == a && t.good(), "TiledMatrix round trip through the file");
+	}
+
+	// a file that is not open fails every read
+	detail::TileFile closed;
+	{
+		detail::TileCache<double> cache(closed, 0, 16, 4);
+		cache.prefetch(1);
+		check(throws_io([&] { cache.acquire(0, false); }) && !cache.good(), "TileCache::acquire throws after a failed read");
+		check(throws_io([&] { cache.acquire(1, false); }), "TileCache::acquire throws after a failed prefetch");
+		check(throws_io([&] { cache.flush(); }), "TileCache::flush throws after a failed read");
+	}
+#ifdef __linux__
+	// /dev/full reads zeros and fails every write
+	detail::TileFile full;
+	if (full.open("/dev/full", false)) {
+		detail::TileCache<double> cache(full, 0, 16, 4);
+		for (size_t id = 0; id < 4; id++) {
+			cache.acquire(id, true)[0] = 1;
+			cache.release(id);
+		}
+		check(throws_io([&] { cache.flush(); }) && !cache.good(), "TileCache::flush throws after failed writes");
+		check(throws_io([&] { cache.acquire(0, false); }), "TileCache::acquire throws after failed writes");
+	}
+#endif
+}
+
+double max_abs_diff(const Matrix<double>& a, const Matrix<double>& b) {
+	double res = 0;
+	for (size_t k = 0; k < a.size().first * a.size().second; k++)
+		res = std::max(res, std::abs(a.data()[k] - b.data()[k]));
+	return res;
+}
+
+// FixedMatrix and the batch kernels against Matrix, at every instruction set of the machine.
+// Every fourth double matrix has two equal rows: elimination leaves a pivot of rounding
+// error in it, not an exact zero.
+template<size_t N>
+void test_fixed(std::mt19937& rng) {
+	std::string name = std::to_string(N) + "x" + std::to_string(N);
+	// not a whole number of blocks, the last block has padding lanes
+	size_t count = 3 * detail::fixed_batch_lanes<double> + 5;
+	std::uniform_real_distribution<double> d(-1, 1);
+	std::vector<FixedMatrix<double, N>> v(count);
+	std::vector<Matrix<double>> ref(count);
+	std::vector<bool> invertible(count);
+	for (size_t b = 0; b < count; b++) {
+		for (size_t e = 0; e < N * N; e++)
+			v[b].data()[e] = d(rng);
+		if (N > 1 && b % 4 == 1)
+			std::copy(v[b][0], v[b][0] + N, v[b][N - 1]);
+		ref[b] = v[b].to_matrix();
+		invertible[b] = ref[b].have_inverce();
+		check(invertible[b] == !(N > 1 && b % 4 == 1), "Matrix::have_inverce of a " + name + " double matrix");
+		check(v[b].have_inverce() == invertible[b], "FixedMatrix::have_inverce of a " + name + " double matrix matches Matrix");
+		check(std::abs(v[b].det() - ref[b].det()) < 1e-12, "FixedMatrix::det of a " + name + " double matrix matches Matrix");
+		if (invertible[b])
+			check(max_abs_diff(v[b].inverce().to_matrix(), ref[b].inverce()) < 1e-9, "FixedMatrix::inverce of a " + name + " double matrix matches Matrix");
+	}
+
+	std::uniform_int_distribution<int> di(-5, 5);
+	std::vector<FixedMatrix<long long, N>> w(count);
+	for (size_t b = 0; b < count; b++) {
+		for (size_t e = 0; e < N * N; e++)
+			w[b].data()[e] = di(rng);
+		if (N > 1 && b % 4 == 1)
+			std::copy(w[b][0], w[b][0] + N, w[b][N - 1]);
+		auto a = w[b].to_matrix();
+		check(w[b].det() == a.det(), "FixedMatrix::det of a " + name + " long long matrix matches Matrix");
+		check(w[b].char_poly() == a.char_poly(), "FixedMatrix::char_poly of a " + name + " long long matrix matches Matrix");
+	}
+
+	FixedMatrixBatch<double, N> batch(count), regular(count);
+	FixedMatrixBatch<long long, N> batch_ll(count);
+	for (size_t b = 0; b < count; b++) {
+		batch.set(b, v[b]);
+		regular.set(b, invertible[b] ? v[b] : FixedMatrix<double, N>::identity());
+		batch_ll.set(b, w[b]);
+	}
+	for (SimdLevel level : { SimdLevel::scalar, SimdLevel::avx2, SimdLevel::avx512 }) {
+		if (level > detect_simd_level())
+			continue;
+		set_simd_level(level);
+		std::string at = " at SIMD level " + std::to_string(int(level));
+		std::vector<double> dets(count);
+		batch_det(batch, dets.data());
+		FixedMatrixBatch<double, N> inv;
+		bool all = batch_inverce(batch, inv);
+		check(all == (N == 1), "batch_inverce of " + name + " double matrices reports the singular ones" + at);
+		for (size_t b = 0; b < count; b++) {
+			check(std::abs(dets[b] - ref[b].det()) < 1e-12, "batch_det of " + name + " double matrices matches Matrix" + at);
+			if (invertible[b])
+				check(max_abs_diff(inv.get(b).to_matrix(), ref[b].inverce()) < 1e-9, "batch_inverce of " + name + " double matrices matches Matrix" + at);
+		}
+		check(batch_inverce(regular, inv), "batch_inverce of invertible " + name + " double matrices" + at);
+
+		std::vector<long long> dets_ll(count);
+		batch_det(batch_ll, dets_ll.data());
+		FixedMatrixBatch<long long, 1, N + 1> cp;
+		batch_char_poly(batch_ll, cp);
+		for (size_t b = 0; b < count; b++) {
+			auto a = w[b].to_matrix();
+			check(dets_ll[b] == a.det(), "batch_det of " + name + " long long matrices matches Matrix" + at);
+			auto c = cp.get(b);
+			check(Polynomial<long long>(std::vector<long long>(c[0], c[0] + N + 1)) == a.char_poly(), "batch_char_poly of " + name + " long long matrices matches Matrix" + at);
+		}
+	}
+	set_simd_level(detect_simd_level());
+}
+
+} // namespace
+
+int main() {
+	test_bareiss();
+	test_char_poly();
+	test_binary_io();
+	test_elimination();
+	std::mt19937 rng(19);
+	test_expressions<double>(rng);
+	test_expressions<int>(rng);
+	test_expressions<Rational<int>>(rng);
+	test_product_assign();
+	test_multimod();
+	test_polynomial();
+	test_out_of_core();
+	test_fixed<1>(rng);
+	test_fixed<2>(rng);
+	test_fixed<3>(rng);
+	test_fixed<4>(rng);
+	test_fixed<5>(rng);
+	if (failures)
+		std::cerr << failures << " check(s) failed\n";
+	else
+		std::cerr << "all checks passed\n";
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "matrix.h"
+#include "math_vector.h"
+#include "bigint.h"
+#include "modint.h"
+#include "rational.h"
+#include "thread_pool.h"
+#include "assertm.h"
+
+// Bulk text input, much faster than operator>> element by element.
+// The whole text is scanned in memory with std::from_chars: numbers are separated by
+// spaces or tabs, Rational is "n" or "n/d" without spaces around '/'.
+// A matrix has one row per line, empty lines are skipped and every row must have as many
+// values as the first one. Texts longer than TEXT_PARSE_CHUNK bytes are cut at line
+// breaks into pieces parsed in parallel. Errors are reported with line and column
+// in TextParseStatus, the target is left unchanged then.
+
+constexpr size_t TEXT_PARSE_CHUNK = size_t(1) << 20;
+
+struct TextParseStatus {
+	bool ok = true;
+	// 1-based position of the error
+	size_t line = 0, column = 0;
+	std::string message;
+
+	explicit operator bool() const { return ok; }
+	friend std::ostream& operator<<(std::ostream& out, const TextParseStatus& s) {
+		if (s.ok)
+			return out << "ok";
+		return out << "line " << s.line << ", column " << s.column << ": " << s.message;
+	}
+};
+
+// parse(p, end, x, error) reads one value starting at p and returns the position after it,
+// or nullptr with a static error message
+template<class T>
+struct text_codec {
+	static constexpr bool enabled = false;
+};
+
+template<class T>
+requires std::is_arithmetic_v<T> && (!std::is_same_v<T, bool>)
+struct text_codec<T> {
+	static constexpr bool enabled = true;
+	static const char* parse(const char* p, const char* end, T& x, const char*& error) {
+		// from_chars takes no leading '+'
+		if (p != end && *p == '+' && p + 1 != end && *(p + 1) != '-')
+			++p;
+		auto [q, ec] = std::from_chars(p, end, x);
+		if (ec == std::errc::result_out_of_range)
+			return error = "number out of range", nullptr;
+		if (ec != std::errc())
+			return error = "expected a number", nullptr;
+		return q;
+	}
+};
+
+template<>
+struct text_codec<BigInt> {
+	static constexpr bool enabled = true;
+	static const char* parse(const char* p, const char* end, BigInt& x, const char*& error) {
+		const char* q = p;
+		if (q != end && (*q == '-' || *q == '+'))
+			++q;
+		const char* digits = q;
+		while (q != end && *q >= '0' && *q <= '9')
+			++q;
+		if (q == digits)
+			return error = "expected a number", nullptr;
+		x = BigInt(std::string_view(p, q - p));
+		return q;
+	}
+};
+
+template<uint32_t P>
+struct text_codec<ModInt<P>> {
+	static constexpr bool enabled = true;
+	static const char* parse(const char* p, const char* end, ModInt<P>& x, const char*& error) {
+		long long v;
+		const char* q = text_codec<long long>::parse(p, end, v, error);
+		if (q)
+			x = ModInt<P>(v);
+		return q;
+	}
+};
+
+template<class U>
+requires text_codec<U>::enabled
+struct text_codec<Rational<U>> {
+	static constexpr bool enabled = true;
+	static const char* parse(const char* p, const char* end, Rational<U>& x, const char*& error) {
+		U n, d = U(1);
+		if (p = text_codec<U>::parse(p, end, n, error); !p)
+			return nullptr;
+		if (p != end && *p == '/') {
+			if (p = text_codec<U>::parse(p + 1, end, d, error); !p)
+				return nullptr;
+			if (d == U(0))
+				return error = "zero denominator", nullptr;
+		}
+		x = Rational<U>(n, d);
+		return p;
+	}
+};
+
+template<class T>
+concept conc_text = text_codec<T>::enabled;
+
+namespace detail {
+
+inline bool text_blank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; }
+
+// values of the non-empty lines of one piece of text
+template<class T>
+struct TextRows {
+	std::vector<T> values;
+	size_t rows = 0, cols = 0;
+	TextParseStatus status;
+};
+
+// cols == 0 takes the width from the first row, first_line numbers the lines of the piece
+template<class T>
+TextRows<T> parse_text_rows(std::string_view text, size_t cols, size_t first_line) {
+	TextRows<T> res;
+	res.cols = cols;
+	const char* p = text.data(), * end = p + text.size();
+	size_t line = first_line;
+	while (p != end) {
+		const char* eol = std::find(p, end, '\n');
+		const char* start = p;
+		size_t count = 0;
+		while (true) {
+			while (p != eol && text_blank(*p))
+				++p;
+			if (p == eol)
+				break;
+			const char* error = nullptr;
+			const char* q = text_codec<T>::parse(p, eol, res.values.emplace_back(), error);
+			if (q && q != eol && !text_blank(*q)) {
+				res.status = { false, line, size_t(q - start) + 1, "unexpected character" };
+				return res;
+			}
+			if (!q) {
+				res.status = { false, line, size_t(p - start) + 1, error };
+				return res;
+			}
+			p = q;
+			count++;
+		}
+		if (count) {
+			if (!res.cols)
+				res.cols = count;
+			if (count != res.cols) {
+				res.status = { false, line, 1, "row has " + std::to_string(count) + " values, expected " + std::to_string(res.cols) };
+				return res;
+			}
+			res.rows++;
+		}
+		p = eol == end ? end : eol + 1;
+		line++;
+	}
+	return res;
+}
+
+} // namespace detail
+
+// rows as lines of text, the size of a is taken from the text
+template<conc_text T>
+TextParseStatus parse_matrix(std::string_view text, Matrix<T>& a, bool parallel = true) {
+	// pieces of about TEXT_PARSE_CHUNK bytes ending at line breaks
+	std::vector<size_t> cuts{ 0 };
+	while (parallel && cuts.back() + TEXT_PARSE_CHUNK < text.size()) {
+		size_t eol = text.find('\n', cuts.back() + TEXT_PARSE_CHUNK);
+		if (eol == std::string_view::npos)
+			break;
+		cuts.push_back(eol + 1);
+	}
+	cuts.push_back(text.size());
+
+	size_t k = cuts.size() - 1;
+	std::vector<size_t> lines(k + 1, 1);
+	for (size_t i = 0; i < k; i++)
+		lines[i + 1] = lines[i] + std::count(text.begin() + cuts[i], text.begin() + cuts[i + 1], '\n');
+
+	// width from the first non-empty line
+	size_t cols = 0;
+	for (size_t p = 0, line = 1; p < text.size() && !cols; line++) {
+		size_t eol = std::min(text.find('\n', p), text.size());
+		auto head = detail::parse_text_rows<T>(text.substr(p, eol - p), 0, line);
+		if (!head.status)
+			return head.status;
+		cols = head.cols;
+		p = eol + 1;
+	}
+
+	std::vector<detail::TextRows<T>> parts(k);
+	parallel_for(0, k, TEXT_PARSE_CHUNK, [&](size_t lo, size_t hi) {
+		for (size_t i = lo; i < hi; i++)
+			parts[i] = detail::parse_text_rows<T>(text.substr(cuts[i], cuts[i + 1] - cuts[i]), cols, lines[i]);
+	});
+	size_t rows = 0;
+	for (auto& part : parts) {
+		if (!part.status)
+			return part.status;
+		rows += part.rows;
+	}
+	Matrix<T> res(rows, cols);
+	T* out = res.data();
+	for (auto& part : parts)
+		out = std::move(part.values.begin(), part.values.begin() + part.rows * cols, out);
+	a = std::move(res);
+	return {};
+}
+
+// all values of the text, in any layout
+template<conc_text T>
+TextParseStatus parse_vector(std::string_view text, MathVector<T>& v) {
+	std::vector<T> values;
+	size_t line = 1;
+	for (size_t p = 0; p < text.size(); line++) {
+		size_t eol = std::min(text.find('\n', p), text.size());
+		auto part = detail::parse_text_rows<T>(text.substr(p, eol - p), 0, line);
+		if (!part.status)
+			return part.status;
+		values.insert(values.end(), std::make_move_iterator(part.values.begin()), std::make_move_iterator(part.values.end()));
+		p = eol + 1;
+	}
+	v = MathVector<T>(std::move(values));
+	return {};
+}
+
+// the rest of the stream, read in one go
+inline std::string read_text(std::istream& in) {
+	return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+template<conc_text T>
+TextParseStatus read_matrix(std::istream& in, Matrix<T>& a, bool parallel = true) {
+	return parse_matrix(read_text(in), a, parallel);
+}
+
+template<conc_text T>
+TextParseStatus load_matrix(const std::string& path, Matrix<T>& a, bool parallel = true) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		return { false, 0, 0, "cannot open " + path };
+	return read_matrix(in, a, parallel);
+}
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Parallel execution of Matrix operations.
+// Work is split by parallel_for, which runs on the current Executor: by default an internal
+// work-stealing ThreadPool, or any executor installed by the caller (ScopedExecutor or
+// set_default_executor), so the library can share a pool with the rest of an application.
+// Loops whose estimated work is below parallel_cutoff() scalar operations stay serial.
+
+class Executor {
+public:
+	virtual ~Executor() = default;
+	// threads that may run tasks at once, including the thread calling parallel_for
+	virtual size_t concurrency() const = 0;
+	virtual void submit(std::function<void()> task) = 0;
+};
+
+// runs every task immediately on the calling thread
+class SerialExecutor : public Executor {
+public:
+	size_t concurrency() const override { return 1; }
+	void submit(std::function<void()> task) override { task(); }
+};
+
+// Every worker owns a deque: it pushes and pops its own tasks at the back
+// and steals from the front of the other deques when it runs out of work.
+class ThreadPool : public Executor {
+public:
+	explicit ThreadPool(size_t threads = std::max<size_t>(std::thread::hardware_concurrency(), 1)) {
+		// the thread calling parallel_for works too, so one worker less is enough
+		size_t workers_count = threads > 1 ? threads - 1 : 0;
+		for (size_t i = 0; i < workers_count; i++)
+			queues.push_back(std::make_unique<Queue>());
+		for (size_t i = 0; i < workers_count; i++)
+			workers.emplace_back([this, i] { worker_loop(i); });
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+			stop = true;
+		}
+		wake.notify_all();
+		for (auto& t : workers)
+			t.join();
+	}
+
+	size_t concurrency() const override { return workers.size() + 1; }
+
+	void submit(std::function<void()> task) override {
+		if (workers.empty()) {
+			task();
+			return;
+		}
+		size_t i = local_owner == this ? local_index : next_queue++ % queues.size();
+		{
+			std::lock_guard<std::mutex> lock(queues[i]->mutex);
+			queues[i]->tasks.push_back(std::move(task));
+		}
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+			++pending;
+		}
+		wake.notify_one();
+	}
+
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	bool pop_or_steal(size_t i, std::function<void()>& task) {
+		{
+			std::lock_guard<std::mutex> lock(queues[i]->mutex);
+			if (!queues[i]->tasks.empty()) {
+				task = std::move(queues[i]->tasks.back());
+				queues[i]->tasks.pop_back();
+				return true;
+			}
+		}
+		for (size_t d = 1; d < queues.size(); d++) {
+			auto& q = *queues[(i + d) % queues.size()];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			if (!q.tasks.empty()) {
+				task = std::move(q.tasks.front());
+				q.tasks.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void worker_loop(size_t i) {
+		local_owner = this;
+		local_index = i;
+		while (true) {
+			std::function<void()> task;
+			if (pop_or_steal(i, task)) {
+				--pending;
+				task();
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(sleep_mutex);
+			wake.wait(lock, [this] { return stop || pending > 0; });
+			if (stop && pending == 0)
+				return;
+		}
+	}
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	std::atomic<size_t> pending{ 0 };
+	std::atomic<size_t> next_queue{ 0 };
+	bool stop = false;
+
+	inline static thread_local ThreadPool* local_owner = nullptr;
+	inline static thread_local size_t local_index = 0;
+};
+
+namespace detail {
+
+struct ParallelConfig {
+	std::mutex mutex;
+	std::unique_ptr<ThreadPool> pool;
+	Executor* default_executor = nullptr;
+	std::atomic<size_t> cutoff{ 1 << 15 };
+};
+
+inline ParallelConfig& parallel_config() {
+	static ParallelConfig config;
+	return config;
+}
+
+inline thread_local Executor* scoped_executor = nullptr;
+
+} // namespace detail
+
+// internal pool used unless the caller installed an executor
+inline ThreadPool& default_thread_pool() {
+	auto& config = detail::parallel_config();
+	std::lock_guard<std::mutex> lock(config.mutex);
+	if (!config.pool)
+		config.pool = std::make_unique<ThreadPool>();
+	return *config.pool;
+}
+
+// recreates the internal pool, must not be called while a computation is running
+inline void set_num_threads(size_t threads) {
+	auto& config = detail::parallel_config();
+	std::lock_guard<std::mutex> lock(config.mutex);
+	config.pool = std::make_unique<ThreadPool>(std::max<size_t>(threads, 1));
+}
+
+inline size_t num_threads() { return default_thread_pool().concurrency(); }
+
+// loops with less work (in scalar operations) than the cutoff run serially
+inline void set_parallel_cutoff(size_t ops) { detail::parallel_config().cutoff = ops; }
+inline size_t parallel_cutoff() { return detail::parallel_config().cutoff; }
+
+// executor used by all threads, nullptr restores the internal pool
+inline void set_default_executor(Executor* executor) {
+	auto& config = detail::parallel_config();
+	std::lock_guard<std::mutex> lock(config.mutex);
+	config.default_executor = executor;
+}
+
+inline Executor& current_executor() {
+	if (detail::scoped_executor)
+		return *detail::scoped_executor;
+	{
+		auto& config = detail::parallel_config();
+		std::lock_guard<std::mutex> lock(config.mutex);
+		if (config.default_executor)
+			return *config.default_executor;
+	}
+	return default_thread_pool();
+}
+
+// executor for the operations started by this thread while the guard is alive
+class ScopedExecutor {
+public:
+	explicit ScopedExecutor(Executor& executor) : prev(detail::scoped_executor) { detail::scoped_executor = &executor; }
+	~ScopedExecutor() { detail::scoped_executor = prev; }
+	ScopedExecutor(const ScopedExecutor&) = delete;
+	ScopedExecutor& operator=(const ScopedExecutor&) = delete;
+private:
+	Executor* prev;
+};
+
+// Calls f(lo, hi) on disjoint chunks covering [begin, end), cost is the work per index.
+// The calling thread takes chunks too, so nested calls from inside a task cannot deadlock.
+template<class F>
+void parallel_for(size_t begin, size_t end, size_t cost, F&& f) {
+	if (begin >= end)
+		return;
+	size_t n = end - begin;
+	if (n < 2 || n * std::max<size_t>(cost, 1) < parallel_cutoff()) {
+		f(begin, end);
+		return;
+	}
+	Executor& executor = current_executor();
+	size_t threads = executor.concurrency();
+	if (threads <= 1) {
+		f(begin, end);
+		return;
+	}
+
+	struct State {
+		std::atomic<size_t> next{ 0 }, done{ 0 };
+		std::mutex mutex;
+		std::condition_variable finished;
+		std::exception_ptr error;
+	};
+	auto state = std::make_shared<State>();
+	size_t chunks = std::min(n, threads * 4);
+	// tasks that start after every chunk is taken return without touching f
+	auto work = [state, begin, n, chunks, &f] {
+		size_t c;
+		while ((c = state->next++) < chunks) {
+			try {
+				f(begin + n * c / chunks, begin + n * (c + 1) / chunks);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(state->mutex);
+				if (!state->error)
+					state->error = std::current_exception();
+			}
+			if (++state->done == chunks) {
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->finished.notify_all();
+			}
+		}
+	};
+	for (size_t i = 1; i < std::min(threads, chunks); i++)
+		executor.submit(work);
+	work();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished.wait(lock, [&] { return state->done == chunks; });
+	if (state->error)
+		std::rethrow_exception(state->error);
+}